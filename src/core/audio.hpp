@@ -7,6 +7,7 @@
 #include <cstring>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <cmath>
@@ -18,6 +19,24 @@
 #include <algorithm>
 #include <sndfile.hh>
 
+#include "decoded_audio.hpp"
+#include "oscillator.hpp"
+#include "parameter.hpp"
+#include "peaks.hpp"
+#include "loudness.hpp"
+#include "levels.hpp"
+#include "pitch.hpp"
+#include "summary_tree.hpp"
+#include "statistics.hpp"
+#include "piece_table.hpp"
+#include "history.hpp"
+#include "project.hpp"
+#include "paged_store.hpp"
+#include "wav_reader.hpp"
+#include "mp3_index.hpp"
+#include "fingerprint.hpp"
+#include "io.hpp"
+
 // File-level metadata
 struct FileInfo{
   std::string filePath;
@@ -40,18 +59,16 @@ struct CodecInfo{
   std::map<std::string,std::string>extra; // flexible metadata (frame size, profile, etc.)
 };
 
-// Optional decoded audio (if loaded/decoded to PCM)
-struct DecodedAudio{
-  std::vector<float>samples; // normalized [-1,1], interleaved
-  uint64_t totalFrames{};    // samples per channel
-};
-
 // Signal analysis
 struct Analysis{
   float minAmplitude{};      
   float maxAmplitude{};
   float rmsAmplitude{};      // Root Mean Square loudness
   bool clippingDetected{false};
+  LoudnessStats loudness;    // EBU R128 integrated/range/true peak
+  float roughFrequency{};    // median pitch of the voiced frames in Hz, 0 if unpitched
+  std::vector<ChannelStats>channelStats; // per channel detail (DC, windowed RMS, crest, deltas)
+  Fingerprint fingerprint;   // for FingerprintLibrary duplicate lookups
 };
 
 // Metadata tags (ID3, Vorbis, OpusTags, etc.)
@@ -101,9 +118,10 @@ class Audio{
   public:
   AudioFile audioFile;
 
-  int SINE_WAVE=0;
-  int SQUARE_WAVE=1;
-  int SAWTOOTH_WAVE=2;
+  using Wave=Oscillator::Wave;
+  static constexpr Wave SINE_WAVE=Oscillator::SINE_WAVE;
+  static constexpr Wave SQUARE_WAVE=Oscillator::SQUARE_WAVE;
+  static constexpr Wave SAWTOOTH_WAVE=Oscillator::SAWTOOTH_WAVE;
 
   enum PlaybackState:int{
     Stopped=0,
@@ -122,12 +140,38 @@ class Audio{
   std::atomic<uint32_t>loopCount{0};    // 0 => infinite, >0 => that many plays
   std::atomic<uint32_t>playedLoops{0};  // how many full plays completed
 
+  // Automatable output controls, written by the UI and ramped by the callback
+  Parameter gain{"gain",1.0f,0.0f,2.0f};
+  Parameter pan{"pan",0.0f,-1.0f,1.0f}; // -1=left, 1=right (stereo only)
+
+  // Min/max/RMS overview for waveform drawing, kept in step with decoded.samples
+  PeakPyramid peaks;
+  SummaryTree summary;
+
+  // Output peak/RMS for the UI, filled by the callback
+  LevelMeter levels;
+
+  // Optional live loudness meter on the output (configured by the owner)
+  std::atomic<LoudnessMeter*>outputMeter{nullptr};
+  std::atomic<Tuner*>outputTuner{nullptr};
+
+  // Optional edit in progress played instead of decoded.samples
+  std::atomic<PieceTable*>editTable{nullptr};
+  std::atomic<Project*>playProject{nullptr};
+  std::atomic<PagedStore*>pagedStore{nullptr};
+
+  // Files that would decode to more than this are opened through a PagedStore
+  uint64_t pagedLoadBytes=PAGED_LOAD_BYTES;
+  std::unique_ptr<PagedStore>ownedStore;
+
   // Static ref count for Pa_Initialize / Pa_Terminate
   static std::atomic<int> paInstanceCount;
   static std::once_flag paInitFlag;
   static std::mutex streamOpenMutex;
 
   public:
+  static constexpr uint64_t PAGED_LOAD_BYTES=1ull<<30;
+
   Audio(){incrementPaRef();}
   Audio(const std::string& path){reload(path);}
   Audio(const std::vector<float>& samples,int channels,int sampleRate){reload(samples,channels,sampleRate);}
@@ -155,11 +199,20 @@ class Audio{
     loopCount.store(0);
     loopEnabled.store(false);
     state.store(PlaybackState::Stopped);
+    setSmoothing();
+    peaks.build(audioFile.decoded.samples,channels);
+    summary.build(audioFile.decoded.samples,channels);
+    applySummary();
+  }
+
+  // Replace the buffer with a generated tone
+  void generate(Wave wave,float frequency,float amplitude,double seconds,int channels,int sampleRate){
+    reload(Oscillator::render(wave,frequency,amplitude,seconds,sampleRate,channels),channels,sampleRate);
   }
 
   bool play(){
     if(state.load()==PlaybackState::Stopped)setPositionInSeconds(0);
-    if(!hasDecodedData())return false;
+    if(!hasPlayableData())return false;
 
     PlaybackState expected=PlaybackState::Stopped;
     // If we were stopped, set currentFrame to currentFrame (could be non-zero if user seeks while stopped).
@@ -209,20 +262,85 @@ class Audio{
     loopCount.store(n); // 0 => infinite, >0 => number of times to play
     playedLoops.store(0);
   }
+  // Call after overwriting decoded.samples in [startFrame,endFrame)
+  void updatePeaks(uint64_t startFrame,uint64_t endFrame=UINT64_MAX){peaks.update(analysisSource(),analysisFrames(),startFrame,endFrame);}
+  // Same contract; also keeps the summary tree and the min/max/RMS/clipping analysis current
+  void samplesChanged(uint64_t startFrame,uint64_t endFrame=UINT64_MAX){
+    updatePeaks(startFrame,endFrame);
+    summary.update(analysisSource(),analysisFrames(),startFrame,endFrame);
+    if(!editTable.load())audioFile.decoded.totalFrames=summary.getTotalFrames();
+    applySummary();
+  }
+  // After an insert/delete: old frames [startFrame,oldEnd) are now [startFrame,newEnd).
+  // Only the blocks around the edit are rescanned, whatever the file length.
+  void samplesReplaced(uint64_t startFrame,uint64_t oldEnd,uint64_t newEnd){
+    peaks.replace(analysisSource(),startFrame,oldEnd,newEnd);
+    summary.replace(analysisSource(),startFrame,oldEnd,newEnd);
+    if(!editTable.load())audioFile.decoded.totalFrames=summary.getTotalFrames();
+    applySummary();
+  }
+  // Min/max/RMS/clip count of a frame range (a selection, the visible window) in O(log n)
+  inline SummaryTree::Summary summarize(uint64_t startFrame,uint64_t endFrame)const{return summary.query(analysisSource(),startFrame,endFrame);}
+  // What peaks/summary describe, for drawing: the attached piece table or page cache, else the decoded buffer
+  inline FrameSource getFrameSource()const{return analysisSource();}
+  inline PagedStore* getPagedStore()const{return pagedStore.load();}
+  // Decoded size above which reload(path) pages the file instead of decoding it to memory
+  void setPagedLoadThreshold(uint64_t bytes){pagedLoadBytes=bytes;}
+
+  // Edit through an undo history: plays and analyses its piece table from now on; nullptr
+  // goes back to the decoded buffer. Detach only while stopped.
+  void attachHistory(History* history){
+    attachPieceTable(history?&history->getTable():nullptr);
+    const int channels=audioFile.playbackInfo.numChannels;
+    peaks.build(analysisSource(),channels,analysisFrames());
+    summary.build(analysisSource(),channels,analysisFrames());
+    applySummary();
+  }
+  // Pass every Range an edit, undo or redo of the attached history returns
+  void historyChanged(const History::Range& r){
+    if(!r.empty())samplesReplaced(r.start,r.oldEnd,r.newEnd);
+  }
+
+  // Meter everything the callback outputs; configure it for this file's channels/rate. nullptr detaches.
+  void attachLoudnessMeter(LoudnessMeter* meter){outputMeter.store(meter);}
+  // Feed the output to a tuner; call tuner->update() from the UI loop. nullptr detaches.
+  void attachTuner(Tuner* tuner){outputTuner.store(tuner);}
+  // Play the table's published version instead of the decoded buffer; detach (nullptr) only while stopped
+  void attachPieceTable(PieceTable* table){editTable.store(table);}
+  // Play a project's mixdown (channels must match this stream); takes precedence over a piece table
+  void attachProject(Project* project){
+    if(project)adoptFormat(project->getChannels(),project->getSampleRate());
+    playProject.store(project);
+  }
+  // Play a file too large for memory through its page cache (see PagedStore::open)
+  void attachPagedStore(PagedStore* store){
+    if(store)adoptFormat(store->getChannels(),store->getSampleRate());
+    pagedStore.store(store);
+  }
+
+  void setGain(float g){gain.setTarget(g);}
+  void setPan(float p){pan.setTarget(p);}
+  void attachGainLane(const AutomationLane* lane){gain.attachLane(lane);}
+  void attachPanLane(const AutomationLane* lane){pan.attachLane(lane);}
   void setPositionInSeconds(double seconds){
-    if(!hasDecodedData())return;
+    if(!hasPlayableData())return;
     uint64_t sr=audioFile.playbackInfo.sampleRate;
     if(sr==0) return;
     uint64_t target=static_cast<uint64_t>(seconds * sr);
-    uint64_t maxFrames=audioFile.decoded.totalFrames;
+    uint64_t maxFrames=playableFrames();
     if(target>=maxFrames)target=maxFrames?maxFrames-1:0;
     currentFrame.store(target);
+    if(PagedStore *store=pagedStore.load())store->setPlayhead(target); // prefetch before playback reaches it
   }
 
   inline size_t getSampleCount()const{return audioFile.decoded.samples.size();}
   inline size_t getSamplesPerChannel()const{return audioFile.playbackInfo.numChannels?audioFile.decoded.samples.size()/audioFile.playbackInfo.numChannels:0;}
   inline double getDuration()const{return audioFile.playbackInfo.sampleRate?static_cast<double>(audioFile.decoded.totalFrames)/audioFile.playbackInfo.sampleRate:0.0;}
   inline PlaybackState getState()const{return state;}
+  inline const PeakPyramid& getPeaks()const{return peaks;}
+  inline LevelMeter& getLevelMeter(){return levels;}
+  inline float getGain()const{return gain.getValue();}
+  inline float getPan()const{return pan.getValue();}
   inline bool getIsLoop()const{return loopEnabled;}
   inline uint32_t getLoopCount()const{return loopCount;}
   inline double getPositionInSeconds()const{
@@ -233,26 +351,130 @@ class Audio{
 
   private:
   bool loadAudioFile(const std::string& path){
+    if(ownedStore){
+      stop(); // the callback may be reading the old store
+      if(pagedStore.load()==ownedStore.get())pagedStore.store(nullptr);
+      ownedStore.reset();
+    }
     audioFile={}; // Reset all fields
+    peaks.clear();
+    summary.clear();
 
     if(!std::filesystem::exists(path)){
       std::cerr << "File not found: " << path << std::endl;
       return false;
     }
     audioFile.fileInfo.filePath=path;
+    audioFile.fileInfo.fileSizeBytes=std::filesystem::file_size(path);
 
-    SF_INFO sfinfo;
-    sfinfo.format=0; // Set to 0 before opening for read
+    // Plain PCM/float WAV (RF64 included) is read natively, everything else through libsndfile
+    WavReader wav;
+    bool paged=false;
+    if(wav.open(path)){
+      if(!loadWav(wav,paged))return false;
+    }else if(!loadSndfile(path,paged))return false;
 
-    // --- Open File ---
-    SNDFILE* sndfile=sf_open(path.c_str(),SFM_READ,&sfinfo);
-    if(!sndfile){
-      std::cerr << "Error opening file: " << sf_strerror(NULL) << std::endl;
+    setSmoothing();
+    const int channels=audioFile.playbackInfo.numChannels;
+    const int sampleRate=audioFile.playbackInfo.sampleRate;
+    if(paged)return loadPaged(path);
+    peaks.build(audioFile.decoded.samples,channels);
+
+    // --- Simple Analysis ---
+    // min/max/RMS/clipping come from the summary tree root so edits can keep them current
+    summary.build(audioFile.decoded.samples,channels);
+    applySummary();
+    if(!audioFile.decoded.samples.empty()){
+      audioFile.analysis.loudness=LoudnessMeter::measure(audioFile.decoded.samples,channels,sampleRate);
+      audioFile.analysis.roughFrequency=PitchDetector::estimate(audioFile.decoded.samples,channels,sampleRate);
+      audioFile.analysis.channelStats=Statistics::measure(audioFile.decoded.samples,channels,sampleRate);
+      audioFile.analysis.fingerprint=Fingerprint::compute(audioFile.decoded.samples.data(),audioFile.decoded.totalFrames,channels,sampleRate);
+    }
+    return true;
+  }
+
+  inline bool tooLargeToDecode(uint64_t frames,int channels)const{return frames*std::max(channels,0)*sizeof(float)>pagedLoadBytes;}
+
+  // Metadata is already filled in; the samples stay on disk and every analysis
+  // is fed from one pass over the page cache
+  bool loadPaged(const std::string& path){
+    ownedStore=std::make_unique<PagedStore>();
+    if(!ownedStore->open(path)){
+      ownedStore.reset();
       return false;
     }
+    PagedStore& store=*ownedStore;
+    const int channels=store.getChannels();
+    const uint32_t sampleRate=store.getSampleRate();
+    attachPagedStore(&store);
+    audioFile.decoded.totalFrames=store.frames();
+    audioFile.playbackInfo.numChannels=channels;
+    audioFile.playbackInfo.sampleRate=sampleRate;
+    audioFile.playbackInfo.durationSeconds=static_cast<double>(store.frames())/sampleRate;
+
+    LoudnessMeter meter(channels,sampleRate);
+    Statistics::Stream stats(channels,sampleRate);
+    PitchDetector::Estimator pitch(channels,sampleRate);
+    Fingerprint::Builder fingerprint(channels,sampleRate);
+    peaks.begin(channels);
+    summary.begin(channels);
+    store.scan(0,store.frames(),[&](const float *p,size_t n){
+      peaks.append(p,n);
+      summary.append(p,n);
+      meter.process(p,n);
+      stats.push(p,n);
+      pitch.push(p,n);
+      fingerprint.push(p,n);
+    });
+    peaks.finish();
+    summary.finish();
+    applySummary();
+    audioFile.analysis.loudness=meter.stats();
+    audioFile.analysis.roughFrequency=pitch.finish();
+    audioFile.analysis.channelStats=stats.result();
+    audioFile.analysis.fingerprint=fingerprint.finish();
+    return true;
+  }
 
-    // --- Fill FileInfo (Partial) ---
-    audioFile.fileInfo.fileSizeBytes=std::filesystem::file_size(path);
+  bool loadWav(const WavReader& wav,bool& paged){
+    const WavReader::Info& info=wav.getInfo();
+    audioFile.fileInfo.format="wav";
+
+    audioFile.playbackInfo.sampleRate=info.sampleRate;
+    audioFile.playbackInfo.numChannels=info.channels;
+    audioFile.playbackInfo.durationSeconds=static_cast<double>(info.frames)/info.sampleRate;
+
+    audioFile.codecInfo.codecName=info.formatTag==3?"IEEE float":"PCM";
+    audioFile.codecInfo.bitrateKbps=static_cast<uint32_t>(static_cast<uint64_t>(info.sampleRate)*info.blockAlign*8/1000);
+    audioFile.codecInfo.extra["bitsPerSample"]=std::to_string(info.bitsPerSample);
+    audioFile.codecInfo.extra["container"]=info.rf64?"RF64":"RIFF";
+    if(info.channelMask)audioFile.codecInfo.extra["channelMask"]=std::to_string(info.channelMask);
+    if(info.unityNote>=0)audioFile.codecInfo.extra["unityNote"]=std::to_string(info.unityNote);
+    if(!info.cues.empty())audioFile.codecInfo.extra["cues"]=std::to_string(info.cues.size());
+    if(!info.loops.empty())audioFile.codecInfo.extra["loops"]=std::to_string(info.loops.size());
+
+    paged=tooLargeToDecode(info.frames,info.channels);
+    if(!paged && !wav.readAll(audioFile.decoded.samples))return false;
+    audioFile.decoded.totalFrames=info.frames;
+
+    // tags
+    auto tag=[&](const char *key){
+      auto it=info.tags.find(key);
+      return it==info.tags.end()?std::string():it->second;
+    };
+    audioFile.tags.title=tag("title");
+    audioFile.tags.artist=tag("artist");
+    audioFile.tags.album=tag("album");
+    audioFile.tags.year=tag("date");
+    for(const char *key:{"comment","genre","tracknumber"})audioFile.tags.extra[key]=tag(key);
+    return true;
+  }
+
+  bool loadSndfile(const std::string& path,bool& paged){
+    // --- Open File ---
+    SF_INFO sfinfo;
+    SNDFILE* sndfile=openSoundFile(path,sfinfo);
+    if(!sndfile)return false;
 
     int major_format=sfinfo.format & SF_FORMAT_TYPEMASK;
     int minor_format=sfinfo.format & SF_FORMAT_SUBMASK;
@@ -279,31 +501,28 @@ class Audio{
 
     audioFile.codecInfo.isVBR=(audioFile.fileInfo.format=="mp3" || audioFile.fileInfo.format=="ogg");
 
-    // Decode samples
-    audioFile.decoded.totalFrames=sfinfo.frames;
-    sf_count_t total_samples=sfinfo.frames * sfinfo.channels;
-    audioFile.decoded.samples.resize(total_samples);
-
-    sf_count_t read_frames=sf_readf_float(sndfile,audioFile.decoded.samples.data(),sfinfo.frames);
-
-    if(read_frames != sfinfo.frames){
-      audioFile.decoded.samples.resize(read_frames * sfinfo.channels);
-      audioFile.decoded.totalFrames=read_frames;
+    // The frame index is cached, so building it here also makes later seeks instant
+    Mp3Index mp3;
+    if(audioFile.fileInfo.format=="mp3" && mp3.openCached(path)){
+      audioFile.codecInfo.bitrateKbps=mp3.averageBitrate();
+      audioFile.codecInfo.isVBR=mp3.isVBR();
+      audioFile.codecInfo.extra["frames"]=std::to_string(mp3.frameCount());
+      audioFile.codecInfo.extra["encoderDelay"]=std::to_string(mp3.getDelay());
     }
 
-    // --- Simple Analysis ---
-    if(!audioFile.decoded.samples.empty()){
-      auto minmax_pair=std::minmax_element(audioFile.decoded.samples.begin(),audioFile.decoded.samples.end());
-      audioFile.analysis.minAmplitude = *minmax_pair.first;
-      audioFile.analysis.maxAmplitude = *minmax_pair.second;
+    // Decode samples
+    audioFile.decoded.totalFrames=sfinfo.frames;
+    paged=tooLargeToDecode(sfinfo.frames,sfinfo.channels);
+    if(!paged){
+      sf_count_t total_samples=sfinfo.frames * sfinfo.channels;
+      audioFile.decoded.samples.resize(total_samples);
 
-      // Calculate RMS
-      double sumSq=0.0;
-      for(float s:audioFile.decoded.samples)sumSq += s * s;
-      audioFile.analysis.rmsAmplitude=std::sqrt(sumSq / audioFile.decoded.samples.size());
+      sf_count_t read_frames=sf_readf_float(sndfile,audioFile.decoded.samples.data(),sfinfo.frames);
 
-      // Clipping detection (normalized float range is [-1.0, 1.0])
-      audioFile.analysis.clippingDetected=(audioFile.analysis.maxAmplitude>=0.999f || audioFile.analysis.minAmplitude <= -0.999f);
+      if(read_frames != sfinfo.frames){
+        audioFile.decoded.samples.resize(read_frames * sfinfo.channels);
+        audioFile.decoded.totalFrames=read_frames;
+      }
     }
 
     // tags
@@ -321,6 +540,16 @@ class Audio{
     return true;
   }
 
+  void applySummary(){
+    const SummaryTree::Summary& total=summary.total();
+    Analysis& a=audioFile.analysis;
+    a.minAmplitude=total.empty()?0.0f:total.min;
+    a.maxAmplitude=total.empty()?0.0f:total.max;
+    a.rmsAmplitude=total.rms();
+    // Clipping detection (normalized float range is [-1.0, 1.0])
+    a.clippingDetected=total.clips>0;
+  }
+
   // ---------------- PortAudio callback ----------------
   static int paCallback(const void *inputBuffer,void *outputBuffer,unsigned long framesPerBuffer,const PaStreamCallbackTimeInfo *timeInfo,PaStreamCallbackFlags statusFlags,void *userData){
     Audio *self=reinterpret_cast<Audio*>(userData);
@@ -328,23 +557,48 @@ class Audio{
     if (!self || !out) return paContinue;
 
     const uint16_t channels=static_cast<uint16_t>(self->audioFile.playbackInfo.numChannels);
-    const uint64_t totalFrames=self->audioFile.decoded.totalFrames;
+    uint64_t totalFrames=self->audioFile.decoded.totalFrames;
     const float *source=self->audioFile.decoded.samples.data();
 
+    // An attached project, piece table or paged store replaces the decoded buffer as the source
+    Project *project=self->playProject.load(std::memory_order_acquire);
+    PieceTable *table=project?nullptr:self->editTable.load(std::memory_order_acquire);
+    PagedStore *paged=project || table?nullptr:self->pagedStore.load(std::memory_order_acquire);
+    const Arrangement *arrangement=project?project->acquire():nullptr;
+    const PieceTable::Snapshot *snapshot=table?table->acquire():nullptr;
+    if(project){
+      totalFrames=arrangement && arrangement->getChannels()==channels?arrangement->frames():0;
+      source=nullptr;
+    }else if(table){
+      totalFrames=snapshot && snapshot->channels==channels?snapshot->frames:0;
+      source=nullptr;
+    }else if(paged){
+      totalFrames=paged->getChannels()==channels?paged->frames():0;
+      source=nullptr;
+    }
+    auto releaseSource=[&](){
+      if(project)project->release();
+      if(table)table->release();
+    };
+
     // Handle no data
-    if(totalFrames==0 || channels==0 || !source){
+    if(totalFrames==0 || channels==0 || (!source && !snapshot && !arrangement && !paged)){
       std::fill(out,out + framesPerBuffer * channels,0.0f);
+      releaseSource();
       return paContinue;
     }
 
     // If paused: output silence
     if(self->state.load()==PlaybackState::Paused){
       std::fill(out,out + framesPerBuffer * channels,0.0f);
+      releaseSource();
       return paContinue;
     }
 
     uint64_t framePos=self->currentFrame.load();
-    for(unsigned long f=0;f<framesPerBuffer;++f){
+    const uint64_t blockStart=framePos;
+    unsigned long f=0;
+    while(f<framesPerBuffer){
       if(framePos>=totalFrames){
         bool loop=self->loopEnabled.load();
         uint32_t lc=self->loopCount.load();
@@ -357,20 +611,58 @@ class Audio{
         }else{
           self->state.store(PlaybackState::Stopped);
           std::fill(out + f * channels,out + framesPerBuffer * channels,0.0f);
-          self->currentFrame.store(framePos);
-          return paContinue; // <--- never complete, stays alive
+          break; // never complete, stays alive
         }
       }
 
-      size_t srcIndex=static_cast<size_t>(framePos) * channels;
-      for(uint16_t c=0;c<channels;++c)out[f * channels + c]=source[srcIndex+c];
-      ++framePos;
+      // copy up to the end of the data in one go
+      const unsigned long n=static_cast<unsigned long>(std::min<uint64_t>(framesPerBuffer-f,totalFrames-framePos));
+      if(arrangement)arrangement->render(framePos,out + f * channels,n);
+      else if(snapshot)PieceTable::read(snapshot,framePos,out + f * channels,n);
+      else if(paged)paged->tryRead(framePos,out + f * channels,n);
+      else std::copy(source + framePos * channels,source + (framePos + n) * channels,out + f * channels);
+      f+=n;
+      framePos+=n;
     }
+    releaseSource();
 
+    self->applyGainPan(out,f,channels,blockStart);
+    self->levels.process(out,framesPerBuffer,channels);
+    if(LoudnessMeter *meter=self->outputMeter.load(std::memory_order_acquire))meter->process(out,framesPerBuffer);
+    if(Tuner *tuner=self->outputTuner.load(std::memory_order_acquire))tuner->push(out,framesPerBuffer,channels);
     self->currentFrame.store(framePos);
     return paContinue;
   }
 
+  // Ramp gain/pan per sample, in blocks of Parameter::MAX_BLOCK
+  void applyGainPan(float *out,unsigned long frames,uint16_t channels,uint64_t startFrame){
+    float g[Parameter::MAX_BLOCK],p[Parameter::MAX_BLOCK];
+    for(unsigned long done=0;done<frames;){
+      const size_t n=std::min<size_t>(Parameter::MAX_BLOCK,frames-done);
+      const bool gainFlat=gain.process(g,n,startFrame+done);
+      const bool panFlat=pan.process(p,n,startFrame+done);
+      float *blk=out+done*channels;
+
+      if(channels==2){
+        if(gainFlat && panFlat && g[0]==1.0f && p[0]==0.0f){done+=n;continue;}
+        for(size_t i=0;i<n;++i){
+          blk[2*i]*=g[i]*std::min(1.0f,1.0f-p[i]);
+          blk[2*i+1]*=g[i]*std::min(1.0f,1.0f+p[i]);
+        }
+      }else{
+        if(gainFlat && g[0]==1.0f){done+=n;continue;}
+        for(size_t i=0;i<n;++i)for(uint16_t c=0;c<channels;++c)blk[i*channels+c]*=g[i];
+      }
+      done+=n;
+    }
+  }
+
+  void setSmoothing(){
+    const float sr=static_cast<float>(audioFile.playbackInfo.sampleRate);
+    gain.setSmoothingTime(0.01f,sr);
+    pan.setSmoothingTime(0.01f,sr);
+  }
+
   // ---------------- Stream management ----------------
   bool openStreamIfNeeded(){
     std::lock_guard<std::mutex>lock(streamOpenMutex);
@@ -379,7 +671,7 @@ class Audio{
       return true;
     }
 
-    if(!hasDecodedData())return false;
+    if(!hasPlayableData())return false;
 
     // Ensure PortAudio initialized
     std::call_once(paInitFlag,[](){Pa_Initialize();});
@@ -436,6 +728,36 @@ class Audio{
   }
 
   bool hasDecodedData()const{return(audioFile.decoded.totalFrames>0 && audioFile.playbackInfo.numChannels>0 && !audioFile.decoded.samples.empty());}
+  // Nothing loaded: the stream takes the attached source's format
+  void adoptFormat(int channels,uint32_t sampleRate){
+    if(hasDecodedData())return;
+    audioFile.playbackInfo.numChannels=channels;
+    audioFile.playbackInfo.sampleRate=sampleRate;
+    audioFile.playbackInfo.durationSeconds=0.0;
+    setSmoothing();
+  }
+  bool hasPlayableData()const{return audioFile.playbackInfo.numChannels>0 && playableFrames()>0;}
+
+  // What peaks/summary are built from: the piece table's editor version or the page cache when attached
+  FrameSource analysisSource()const{
+    if(const PieceTable *t=editTable.load())return FrameSource([t](uint64_t frame,float *out,size_t count){return t->read(frame,out,count);});
+    if(PagedStore *s=pagedStore.load())return FrameSource([s](uint64_t frame,float *out,size_t count){return s->read(frame,out,count);});
+    return FrameSource(audioFile.decoded.samples);
+  }
+  uint64_t analysisFrames()const{
+    if(const PieceTable *t=editTable.load())return t->frames();
+    if(const PagedStore *s=pagedStore.load())return s->frames();
+    const int channels=audioFile.playbackInfo.numChannels;
+    return channels>0?audioFile.decoded.samples.size()/channels:0;
+  }
+
+  // Frames the callback plays: the attached project or piece table, else the decoded buffer
+  uint64_t playableFrames()const{
+    if(const Project *p=playProject.load())return p->frames();
+    if(const PieceTable *t=editTable.load())return t->frames();
+    if(const PagedStore *s=pagedStore.load())return s->frames();
+    return hasDecodedData()?audioFile.decoded.totalFrames:0;
+  }
 };
 // --- static member definitions (put in the header after the class or in a single cpp) ---
 std::atomic<int> Audio::paInstanceCount{0};
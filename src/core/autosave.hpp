@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#include "project_file.hpp"
+
+/*
+ * Background autosave
+ *
+ * tick() is called from the UI loop. When the document's revision moved and
+ * the interval has passed, it takes a snapshot (must be O(1): a shared,
+ * immutable version of the state) and hands it to a worker thread, which
+ * serializes and writes it at idle CPU/IO priority. Nothing on the UI or
+ * audio thread waits for the disk. A save still running when the next one is
+ * due just delays it; snapshots are never queued up.
+ *
+ * Project autosaves append to one container, which is crash-safe on its own
+ * (a save only becomes visible with the header flip of commit()). resume()
+ * loads an existing container and keeps appending to it with the archive
+ * that read it, so sources it already holds keep their ids and their audio
+ * is never written again. On a clean exit, finish() and then promote() the
+ * autosave to the session file; reopen() moves it back at the next start.
+*/
+class Autosave{
+  public:
+  // Runs on the worker; captures the snapshot it writes
+  typedef std::function<bool()>Job;
+
+  private:
+  std::function<uint64_t()>revision;
+  std::function<Job()>snapshot;
+  std::chrono::steady_clock::duration interval=std::chrono::seconds(30);
+  std::chrono::steady_clock::time_point lastRun;
+  uint64_t savedRevision=0;
+
+  std::thread worker;
+  std::mutex lock;
+  std::condition_variable wake,idle;
+  Job pending;
+  bool quit=false;
+  std::atomic<bool>busy{false};
+  std::atomic<bool>failed{false};
+  std::atomic<uint64_t>saves{0};
+
+  // project container and the archive that knows its sources (worker only once started)
+  std::shared_ptr<ProjectFile>file;
+  std::shared_ptr<ProjectArchive>archive;
+
+  public:
+  Autosave(){}
+  Autosave(const Autosave&)=delete;
+  Autosave& operator=(const Autosave&)=delete;
+  ~Autosave(){stop();}
+
+  // revisionFn: cheap change counter; snapshotFn: O(1) capture, returns the job to run
+  void start(std::function<uint64_t()>revisionFn,std::function<Job()>snapshotFn,double seconds=30.0){
+    stop();
+    revision=std::move(revisionFn);
+    snapshot=std::move(snapshotFn);
+    interval=std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    savedRevision=revision();
+    lastRun=std::chrono::steady_clock::now();
+    quit=false;
+    worker=std::thread([this]{run();});
+  }
+
+  // Finishes the save in progress or already handed over, then joins
+  void stop(){
+    if(!worker.joinable())return;
+    {std::lock_guard<std::mutex>guard(lock);quit=true;}
+    wake.notify_all();
+    worker.join();
+  }
+
+  // UI thread, every loop iteration; returns true when a save was started
+  bool tick(bool force=false){
+    if(!worker.joinable() || busy.load())return false;
+    const auto now=std::chrono::steady_clock::now();
+    const uint64_t r=revision();
+    if(r==savedRevision || (!force && now-lastRun<interval))return false;
+    Job job=snapshot();
+    if(!job)return false;
+    savedRevision=r;
+    lastRun=now;
+    busy.store(true);
+    {std::lock_guard<std::mutex>guard(lock);pending=std::move(job);}
+    wake.notify_one();
+    return true;
+  }
+  inline bool saveNow(){return tick(true);}
+
+  // Blocks until the worker is idle (shutdown, explicit save)
+  void wait(){
+    std::unique_lock<std::mutex>guard(lock);
+    idle.wait(guard,[this]{return !busy.load();});
+  }
+
+  // Writes the latest state if it changed, then stops; for a clean exit
+  void finish(){
+    wait();
+    saveNow();
+    stop();
+  }
+
+  inline bool isSaving()const{return busy.load();}
+  inline bool lastSaveFailed()const{return failed.load();}
+  inline uint64_t getSaveCount()const{return saves.load();}
+
+  // ---------------- Projects ----------------
+  // Autosave a project into its own container at path, appending to the one resume() loaded
+  void start(Project& project,const std::string& path,double seconds=30.0,std::function<std::map<std::string,std::string>()>settings=nullptr){
+    if(!file || file->getPath()!=path){
+      file=std::make_shared<ProjectFile>();
+      archive=std::make_shared<ProjectArchive>();
+    }
+    std::shared_ptr<ProjectFile>f=file;
+    std::shared_ptr<ProjectArchive>a=archive;
+    start([&project]{return project.getRevision();},[&project,path,f,a,settings]()->Job{
+      std::shared_ptr<const Session>state=project.snapshot();
+      std::map<std::string,std::string>values=settings?settings():std::map<std::string,std::string>{};
+      return [state,values,path,f,a]{
+        // only what changed since the last save (or since resume()) is appended
+        if(!f->isOpen() && !f->open(path))return false;
+        if(!a->save(*f,*state,values))return false;
+        // keep replaced chunks from piling up
+        if(f->fileBytes()>2*f->liveBytes()+(64u<<20))return f->compact();
+        return true;
+      };
+    },seconds);
+  }
+
+  // Load the container at path into project; later autosaves to path append to it.
+  // A container that cannot be read is moved aside to path+".damaged".
+  bool resume(const std::string& path,Project& project,std::map<std::string,std::string> *settings=nullptr){
+    stop();
+    file=std::make_shared<ProjectFile>();
+    archive=std::make_shared<ProjectArchive>();
+    if(file->open(path) && archive->load(*file,project,settings))return true;
+    std::cerr << "Could not recover autosave: " << path << std::endl;
+    file->close();
+    *archive=ProjectArchive{};
+    std::rename(path.c_str(),(path+".damaged").c_str());
+    return false;
+  }
+
+  // An autosave left behind by a session that did not exit cleanly
+  static bool hasRecovery(const std::string& path){return access(path.c_str(),F_OK)==0;}
+
+  // Replay the latest autosave into project
+  static bool recover(const std::string& path,Project& project,std::map<std::string,std::string> *settings=nullptr){
+    ProjectFile file;
+    ProjectArchive archive;
+    if(!file.open(path) || !archive.load(file,project,settings)){
+      std::cerr << "Could not recover autosave: " << path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // After a clean save/exit
+  static void discard(const std::string& path){std::remove(path.c_str());}
+
+  // Startup: carry on in the session file a clean exit left, unless a crash left an autosave
+  static bool reopen(const std::string& path,const std::string& sessionPath){
+    if(hasRecovery(path) || !hasRecovery(sessionPath))return hasRecovery(path);
+    if(std::rename(sessionPath.c_str(),path.c_str())!=0){
+      std::cerr << "Error reopening " << sessionPath << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Clean exit: the last autosave becomes the session file (nothing to do if none was written)
+  static bool promote(const std::string& path,const std::string& sessionPath){
+    if(!hasRecovery(path))return true;
+    if(std::rename(path.c_str(),sessionPath.c_str())!=0){
+      std::cerr << "Error keeping autosave as " << sessionPath << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  private:
+  void run(){
+    lowerPriority();
+    for(;;){
+      Job job;
+      {
+        std::unique_lock<std::mutex>guard(lock);
+        wake.wait(guard,[this]{return quit || pending;});
+        if(!pending)return; // quit with nothing left to write
+        job=std::move(pending);
+        pending=nullptr;
+      }
+      const bool ok=job();
+      failed.store(!ok);
+      if(ok)saves.fetch_add(1);
+      job=nullptr; // drop the snapshot before reporting idle
+      {std::lock_guard<std::mutex>guard(lock);busy.store(false);}
+      idle.notify_all();
+    }
+  }
+
+  // Idle IO class and lowest CPU priority for this thread only
+  static void lowerPriority(){
+#if defined(__linux__)
+    const pid_t tid=static_cast<pid_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS,static_cast<id_t>(tid),19);
+#if defined(SYS_ioprio_set)
+    const int IOPRIO_WHO_PROCESS=1,IOPRIO_CLASS_IDLE=3,IOPRIO_CLASS_SHIFT=13;
+    syscall(SYS_ioprio_set,IOPRIO_WHO_PROCESS,tid,IOPRIO_CLASS_IDLE<<IOPRIO_CLASS_SHIFT);
+#endif
+#endif
+  }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "wav_writer.hpp"
+
+/*
+ * Channel mapping
+ *
+ * Gains that take one speaker layout to another. The batch converter and the
+ * arrangement mixer both use them, so a clip plays through the same up/down
+ * mix its file would get when converted.
+*/
+class ChannelMap{
+  public:
+  // Speaker bits of the WAVE_FORMAT_EXTENSIBLE channel mask
+  enum Speaker:uint32_t{
+    FL=0x1,FR=0x2,FC=0x4,LFE=0x8,BL=0x10,BR=0x20,FLC=0x40,FRC=0x80,BC=0x100,SL=0x200,SR=0x400,
+    TC=0x800,TFL=0x1000,TFC=0x2000,TFR=0x4000,TBL=0x8000,TBC=0x10000,TBR=0x20000
+  };
+
+  // One speaker bit per channel, in channel order; empty when the layout is unknown
+  static std::vector<uint32_t>speakers(uint32_t mask,int channels){
+    for(uint32_t m:{mask,WavWriter::defaultChannelMask(channels)}){
+      std::vector<uint32_t>bits;
+      for(uint32_t bit=1;bit && m;bit<<=1)if(m&bit)bits.push_back(bit);
+      if(static_cast<int>(bits.size())==channels)return bits;
+    }
+    return {};
+  }
+
+  // Share of a speaker in a stereo fold-down: L+0.707C+0.707Ls, R+0.707C+0.707Rs, no LFE
+  static void fold(uint32_t bit,float& left,float& right){
+    constexpr float g=0.70710678f;
+    switch(bit){
+      case FL: case FLC: left=1.0f;right=0.0f;break;
+      case FR: case FRC: left=0.0f;right=1.0f;break;
+      case FC: case BC: case TC: case TFC: case TBC: left=g;right=g;break;
+      case BL: case SL: case TFL: case TBL: left=g;right=0.0f;break;
+      case BR: case SR: case TFR: case TBR: left=0.0f;right=g;break;
+      default: left=right=0.0f;break; // LFE
+    }
+  }
+
+  // gains[o*inChannels+i]: how much of input channel i goes to output channel o.
+  // Mono is spread to every output. A speaker the output layout also has goes
+  // straight across (sides and backs stand in for each other); the rest fold
+  // into front left/right, and mono takes half of each side of the fold.
+  static std::vector<float>matrix(uint32_t inMask,int inChannels,int outChannels){
+    std::vector<float>gains(static_cast<size_t>(outChannels*inChannels),0.0f);
+    if(inChannels==1){
+      std::fill(gains.begin(),gains.end(),1.0f);
+      return gains;
+    }
+    const std::vector<uint32_t>in=speakers(inMask,inChannels);
+    const std::vector<uint32_t>out=speakers(WavWriter::defaultChannelMask(outChannels),outChannels);
+    if(in.empty() || out.empty()){
+      // no known layout: input c lands on output c % outChannels, averaged with the others there
+      std::vector<int>sharing(outChannels,0);
+      for(int c=0;c<inChannels;++c)sharing[c%outChannels]++;
+      for(int c=0;c<inChannels;++c)gains[(c%outChannels)*inChannels+c]=1.0f/sharing[c%outChannels];
+      return gains;
+    }
+    auto index=[&](uint32_t bit){return static_cast<int>(std::find(out.begin(),out.end(),bit)-out.begin());};
+    for(int i=0;i<inChannels;++i){
+      if(outChannels>1){
+        int o=index(in[i]);
+        if(o==outChannels)o=index(in[i]==SL?BL:in[i]==SR?BR:in[i]==BL?SL:in[i]==BR?SR:in[i]);
+        if(o<outChannels){
+          gains[o*inChannels+i]=1.0f;
+          continue;
+        }
+      }
+      float left,right;
+      fold(in[i],left,right);
+      if(outChannels==1){
+        gains[i]=0.5f*(left+right);
+      }else{
+        gains[index(FL)*inChannels+i]+=left;
+        gains[index(FR)*inChannels+i]+=right;
+      }
+    }
+    return gains;
+  }
+};
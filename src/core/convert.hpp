@@ -0,0 +1,429 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <sndfile.hh>
+
+#include "channel_map.hpp"
+#include "lockfree.hpp"
+#include "parallel.hpp"
+#include "resampler.hpp"
+#include "wav_reader.hpp"
+#include "wav_writer.hpp"
+
+// What BatchConverter produces
+struct ConvertOptions{
+  std::string outputDir;        // empty => next to each input
+  std::string inputRoot;        // when set, subfolders below it are recreated in outputDir
+  std::string suffix;           // appended to the file name
+  uint32_t sampleRate=0;        // 0 => keep
+  int channels=0;               // 0 => keep
+  WavWriteOptions format;       // bits, float, dither, shaping
+  size_t jobs=0;                // files in flight, 0 => one per core
+  bool overwrite=false;         // replace files already on disk
+};
+
+/*
+ * Batch converter
+ *
+ * Each lane is a three-thread pipeline:
+ *   reader    decode (WavReader or libsndfile)
+ *   processor resample + channel map (downmix by speaker position)
+ *   writer    dither + encode + write (WavWriter)
+ * joined by SpscQueues of fixed-size blocks that cycle through per-lane free
+ * lists, so memory is bounded by lanes * DEPTH blocks whatever the file sizes.
+ * Lanes pull files from a shared counter; a lane's reader starts the next
+ * file while its writer is still finishing the last one.
+ *
+ * Every output path is settled before the first lane starts: an output is
+ * never one of the inputs and never shared by two jobs (later jobs get _2,
+ * _3, ...), so no lane can write over a file another lane is still reading.
+*/
+class BatchConverter{
+  public:
+  static constexpr size_t BLOCK_FRAMES=16384;
+  static constexpr size_t DEPTH=8;
+
+  struct Result{
+    std::string input;
+    std::string output;
+    bool ok=false;
+    std::string error;
+    uint64_t frames=0;          // frames written
+  };
+
+  private:
+  enum class Kind{Start,Data,End,Quit};
+
+  struct Block{
+    Kind kind=Kind::Data;
+    size_t job=0;
+    int channels=0;
+    uint32_t channelMask=0;
+    uint32_t sampleRate=0;
+    size_t frames=0;
+    std::vector<float>samples;
+  };
+
+  struct Lane{
+    SpscQueue<Block*>decoded{DEPTH},decodedFree{DEPTH};
+    SpscQueue<Block*>processed{DEPTH},processedFree{DEPTH};
+    std::vector<std::unique_ptr<Block>>blocks;
+  };
+
+  // Decoder front end: native WAV, libsndfile for the rest
+  struct Input{
+    WavReader wav;
+    SNDFILE *file=nullptr;
+    uint64_t at=0;
+    int channels=0;
+    uint32_t channelMask=0;     // 0 => the usual layout for the channel count
+    uint32_t sampleRate=0;
+
+    ~Input(){if(file)sf_close(file);}
+    bool open(const std::string& path,std::string& error){
+      if(wav.open(path)){
+        channels=wav.getChannels();
+        channelMask=wav.getInfo().channelMask;
+        sampleRate=wav.getInfo().sampleRate;
+        return true;
+      }
+      SF_INFO info{};
+      file=sf_open(path.c_str(),SFM_READ,&info);
+      if(!file){
+        error=sf_strerror(NULL);
+        return false;
+      }
+      channels=info.channels;
+      sampleRate=static_cast<uint32_t>(info.samplerate);
+      return channels>0 && sampleRate>0;
+    }
+    size_t read(float *out,size_t frames){
+      if(file){
+        const sf_count_t got=sf_readf_float(file,out,static_cast<sf_count_t>(frames));
+        return got>0?static_cast<size_t>(got):0;
+      }
+      const size_t got=wav.read(at,out,frames);
+      at+=got;
+      return got;
+    }
+  };
+
+  std::vector<std::string>inputs;
+  std::vector<Result>results;
+  ConvertOptions options;
+  std::atomic<size_t>nextJob{0};
+  std::atomic<size_t>fileCount{0};
+  std::atomic<size_t>filesDone{0};
+  std::atomic<uint64_t>framesDone{0};
+  std::atomic<bool>cancelled{false};
+  std::atomic<bool>running{false};
+
+  public:
+  BatchConverter(){}
+  BatchConverter(const BatchConverter&)=delete;
+  BatchConverter& operator=(const BatchConverter&)=delete;
+
+  // Blocking; safe to call from a worker thread and poll progress from another
+  const std::vector<Result>& run(const std::vector<std::string>& files,const ConvertOptions& opts){
+    inputs=files;
+    options=opts;
+    results.assign(inputs.size(),Result{});
+    resolveOutputs();
+    fileCount=inputs.size();
+    nextJob=0;
+    filesDone=0;
+    framesDone=0;
+    cancelled=false;
+    running=true;
+
+    const size_t lanes=std::max<size_t>(1,std::min(inputs.size(),options.jobs?options.jobs:hardwareThreads()));
+    std::vector<std::unique_ptr<Lane>>pool;
+    std::vector<std::thread>threads;
+    for(size_t l=0;l<lanes;++l){
+      pool.push_back(std::make_unique<Lane>());
+      Lane& lane=*pool.back();
+      for(size_t i=0;i<2*DEPTH;++i){
+        lane.blocks.push_back(std::make_unique<Block>());
+        (i<DEPTH?lane.decodedFree:lane.processedFree).push(lane.blocks.back().get());
+      }
+      threads.emplace_back([this,&lane]{readStage(lane);});
+      threads.emplace_back([this,&lane]{processStage(lane);});
+      threads.emplace_back([this,&lane]{writeStage(lane);});
+    }
+    for(std::thread& t:threads)t.join();
+    running=false;
+    return results;
+  }
+
+  void cancel(){cancelled=true;}
+  inline bool isRunning()const{return running.load();}
+  inline size_t getFilesDone()const{return filesDone.load();}
+  inline size_t getFileCount()const{return fileCount.load();}
+  inline uint64_t getFramesDone()const{return framesDone.load();}
+  // Only once run() has returned
+  inline const std::vector<Result>& getResults()const{return results;}
+
+  // Audio files at path: the file itself, or everything below a folder
+  static std::vector<std::string>collect(const std::string& path){
+    namespace fs=std::filesystem;
+    static const std::vector<std::string>extensions={".wav",".wave",".flac",".ogg",".oga",".opus",".mp3",".aif",".aiff",".w64",".rf64",".caf"};
+    auto isAudio=[](const fs::path& p){
+      std::string ext=p.extension().string();
+      std::transform(ext.begin(),ext.end(),ext.begin(),[](unsigned char c){return static_cast<char>(std::tolower(c));});
+      return std::find(extensions.begin(),extensions.end(),ext)!=extensions.end();
+    };
+    std::vector<std::string>files;
+    std::error_code ec;
+    if(fs::is_regular_file(path,ec)){
+      files.push_back(path);
+    }else if(fs::is_directory(path,ec)){
+      for(fs::recursive_directory_iterator it(path,fs::directory_options::skip_permission_denied,ec),end;it!=end;it.increment(ec)){
+        if(ec)break;
+        if(it->is_regular_file(ec) && isAudio(it->path()))files.push_back(it->path().string());
+      }
+      std::sort(files.begin(),files.end());
+    }
+    return files;
+  }
+
+  private:
+  std::string outputPath(const std::string& input)const{
+    namespace fs=std::filesystem;
+    const fs::path in(input);
+    fs::path dir=options.outputDir.empty()?in.parent_path():fs::path(options.outputDir);
+    if(!options.outputDir.empty() && !options.inputRoot.empty()){
+      std::error_code ec;
+      const fs::path rel=fs::relative(in.parent_path(),options.inputRoot,ec);
+      if(!ec && !rel.empty() && *rel.begin()!="..")dir/=rel;
+    }
+    fs::path out=dir/(in.stem().string()+options.suffix+".wav");
+    if(pathKey(out.string())==pathKey(input))out=dir/(in.stem().string()+options.suffix+"_converted.wav");
+    return out.string();
+  }
+
+  void resolveOutputs(){
+    namespace fs=std::filesystem;
+    std::set<std::string>taken;
+    for(const std::string& input:inputs)taken.insert(pathKey(input));
+    for(size_t i=0;i<inputs.size();++i){
+      results[i].input=inputs[i];
+      const fs::path base=outputPath(inputs[i]);
+      fs::path out=base;
+      for(int n=2;taken.count(pathKey(out.string())) && n<10000;++n){
+        out=base.parent_path()/(base.stem().string()+"_"+std::to_string(n)+base.extension().string());
+      }
+      if(taken.count(pathKey(out.string()))){
+        results[i].error="no free output name";
+        continue;
+      }
+      taken.insert(pathKey(out.string()));
+      results[i].output=out.string();
+    }
+  }
+
+  // Same key for every spelling of one file (relative, ./, .., symlinked folders)
+  static std::string pathKey(const std::string& path){
+    namespace fs=std::filesystem;
+    std::error_code ec;
+    fs::path p=fs::weakly_canonical(path,ec);
+    if(ec)p=fs::absolute(path,ec).lexically_normal();
+    return p.string();
+  }
+
+  // ---------------- Pipeline plumbing ----------------
+  static void backoff(int& spins){
+    if(++spins<64)std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  static Block* take(SpscQueue<Block*>& q){
+    Block *b;
+    for(int spins=0;!q.pop(b);)backoff(spins);
+    return b;
+  }
+  static void give(SpscQueue<Block*>& q,Block *b){
+    for(int spins=0;!q.push(b);)backoff(spins);
+  }
+
+  // ---------------- Stages ----------------
+  void readStage(Lane& lane){
+    for(size_t job=nextJob.fetch_add(1);job<inputs.size() && !cancelled.load();job=nextJob.fetch_add(1)){
+      if(results[job].output.empty()){
+        filesDone.fetch_add(1);
+        continue;
+      }
+      Input input;
+      std::string error;
+      if(!input.open(inputs[job],error)){
+        results[job].error=error.empty()?"unsupported file":error;
+        filesDone.fetch_add(1);
+        continue;
+      }
+      Block *b=take(lane.decodedFree);
+      b->kind=Kind::Start;
+      b->job=job;
+      b->channels=input.channels;
+      b->channelMask=input.channelMask;
+      b->sampleRate=input.sampleRate;
+      give(lane.decoded,b);
+      for(;;){
+        b=take(lane.decodedFree);
+        b->job=job;
+        b->samples.resize(BLOCK_FRAMES*input.channels);
+        b->frames=cancelled.load()?0:input.read(b->samples.data(),BLOCK_FRAMES);
+        const bool end=b->frames==0;
+        b->kind=end?Kind::End:Kind::Data;
+        give(lane.decoded,b); // b belongs to the processor from here on
+        if(end)break;
+      }
+    }
+    Block *quit=take(lane.decodedFree);
+    quit->kind=Kind::Quit;
+    give(lane.decoded,quit);
+  }
+
+  void processStage(Lane& lane){
+    Resampler resampler;
+    std::vector<float>mapped,resampled,gains;
+    int inChannels=0,outChannels=0;
+    uint32_t outRate=0;
+    for(;;){
+      Block *in=take(lane.decoded);
+      const Kind kind=in->kind;
+      if(kind==Kind::Start){
+        inChannels=in->channels;
+        outChannels=options.channels>0?options.channels:inChannels;
+        outRate=options.sampleRate?options.sampleRate:in->sampleRate;
+        gains=ChannelMap::matrix(in->channelMask,inChannels,outChannels);
+        // fewer channels first, so the resampler has less to do
+        resampler.configure(std::min(inChannels,outChannels),in->sampleRate,outRate);
+        Block *out=take(lane.processedFree);
+        out->kind=Kind::Start;
+        out->job=in->job;
+        out->channels=outChannels;
+        out->channelMask=outChannels==inChannels?in->channelMask:0;
+        out->sampleRate=outRate;
+        give(lane.processed,out);
+      }else if(kind==Kind::Data || kind==Kind::End){
+        resampled.clear();
+        if(kind==Kind::Data){
+          const float *src=in->samples.data();
+          if(outChannels<inChannels){
+            mapChannels(src,in->frames,inChannels,outChannels,gains,mapped);
+            src=mapped.data();
+          }
+          resampler.process(src,in->frames,resampled);
+        }else resampler.flush(resampled);
+        if(outChannels>inChannels){
+          mapChannels(resampled.data(),resampled.size()/inChannels,inChannels,outChannels,gains,mapped);
+          resampled.swap(mapped);
+        }
+        if(!resampled.empty()){
+          Block *out=take(lane.processedFree);
+          out->kind=Kind::Data;
+          out->job=in->job;
+          out->channels=outChannels;
+          out->frames=resampled.size()/outChannels;
+          out->samples.swap(resampled); // buffers circulate instead of being copied
+          give(lane.processed,out);
+        }
+        if(kind==Kind::End){
+          Block *out=take(lane.processedFree);
+          out->kind=Kind::End;
+          out->job=in->job;
+          give(lane.processed,out);
+        }
+      }else{
+        Block *out=take(lane.processedFree);
+        out->kind=Kind::Quit;
+        give(lane.processed,out);
+      }
+      give(lane.decodedFree,in);
+      if(kind==Kind::Quit)return;
+    }
+  }
+
+  void writeStage(Lane& lane){
+    WavWriter writer;
+    WavWriteOptions format=options.format;
+    format.background=false;  // this thread is the writer already
+    format.bufferBytes=1u<<20;
+    size_t job=0;
+    bool ok=false;
+    for(;;){
+      Block *b=take(lane.processed);
+      const Kind kind=b->kind;
+      if(kind==Kind::Start){
+        job=b->job;
+        format.channelMask=b->channelMask;
+        ok=openOutput(writer,results[job],b->channels,b->sampleRate,format);
+      }else if(kind==Kind::Data){
+        if(ok && !writer.write(b->samples.data(),b->frames)){
+          ok=false;
+          results[job].error="write failed";
+        }
+        framesDone.fetch_add(b->frames);
+      }else if(kind==Kind::End){
+        const bool created=writer.isOpen();
+        if(created){
+          results[job].frames=writer.frames();
+          if(!writer.close() && ok){
+            ok=false;
+            results[job].error="write failed";
+          }
+        }
+        if(cancelled.load() && ok){
+          ok=false;
+          results[job].error="cancelled";
+        }
+        results[job].ok=ok;
+        std::error_code ec;
+        if(!ok && created)std::filesystem::remove(results[job].output,ec); // no half-written files
+        filesDone.fetch_add(1);
+      }
+      give(lane.processedFree,b);
+      if(kind==Kind::Quit)return;
+    }
+  }
+
+  bool openOutput(WavWriter& writer,Result& result,int channels,uint32_t rate,const WavWriteOptions& format){
+    namespace fs=std::filesystem;
+    std::error_code ec;
+    fs::create_directories(fs::path(result.output).parent_path(),ec);
+    if(!options.overwrite && fs::exists(result.output,ec)){
+      result.error="output exists";
+      return false;
+    }
+    if(!writer.open(result.output,channels,rate,format)){
+      result.error="cannot create output";
+      return false;
+    }
+    return true;
+  }
+
+  static void mapChannels(const float *in,size_t frames,int inChannels,int outChannels,const std::vector<float>& gains,std::vector<float>& out){
+    out.assign(frames*outChannels,0.0f);
+    for(size_t f=0;f<frames;++f){
+      const float *src=in+f*inChannels;
+      float *dst=out.data()+f*outChannels;
+      for(int o=0;o<outChannels;++o){
+        const float *g=gains.data()+o*inChannels;
+        float acc=0.0f;
+        for(int i=0;i<inChannels;++i)acc+=g[i]*src[i];
+        dst[o]=acc;
+      }
+    }
+  }
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Optional decoded audio (if loaded/decoded to PCM)
+struct DecodedAudio{
+  std::vector<float>samples; // normalized [-1,1], interleaved
+  uint64_t totalFrames{};    // samples per channel
+};
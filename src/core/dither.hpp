@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Fast per-thread PRNG
+ *
+ * Eight xorshift32 lanes stepped together, so a block of random numbers is
+ * generated with plain SIMD integer ops. Not for anything cryptographic.
+*/
+class FastRandom{
+  public:
+  static constexpr int LANES=8;
+
+  private:
+  uint32_t state[LANES];
+
+  public:
+  explicit FastRandom(uint64_t seed=0x9E3779B97F4A7C15ull){reseed(seed);}
+
+  void reseed(uint64_t seed){
+    // splitmix64 to spread the seed over all lanes (xorshift must not start at 0)
+    for(int i=0;i<LANES;++i){
+      seed+=0x9E3779B97F4A7C15ull;
+      uint64_t z=seed;
+      z=(z^(z>>30))*0xBF58476D1CE4E5B9ull;
+      z=(z^(z>>27))*0x94D049BB133111EBull;
+      z^=z>>31;
+      state[i]=static_cast<uint32_t>(z)|1u;
+    }
+  }
+
+  // n uniform floats in [0,1)
+  void fillUniform(float *out,size_t n){
+    size_t i=0;
+    for(;i+LANES<=n;i+=LANES){
+      for(int k=0;k<LANES;++k){
+        uint32_t x=state[k];
+        x^=x<<13;x^=x>>17;x^=x<<5;
+        state[k]=x;
+        const uint32_t bits=(x>>9)|0x3F800000u; // [1,2)
+        float f;
+        std::memcpy(&f,&bits,sizeof(f));
+        out[i+k]=f-1.0f;
+      }
+    }
+    if(i<n){
+      float tail[LANES];
+      fillUniform(tail,LANES);
+      std::copy(tail,tail+(n-i),out+i);
+    }
+  }
+
+  uint32_t next(){
+    uint32_t x=state[0];
+    x^=x<<13;x^=x>>17;x^=x<<5;
+    state[0]=x;
+    return x;
+  }
+
+  // One generator per thread, seeded differently for each
+  static FastRandom& local(){
+    static std::atomic<uint64_t>counter{1};
+    thread_local FastRandom rng(counter.fetch_add(0x632BE59BD9B4E019ull));
+    return rng;
+  }
+};
+
+/*
+ * Float -> integer PCM quantizer
+ *
+ * TPDF dither of +-1 LSB and optional error-feedback noise shaping. Without
+ * shaping every step works on whole blocks and vectorizes; shaping feeds each
+ * sample's error into the next one, so it runs per sample but per channel.
+ * Output values are signed integers in the range of the target bit depth,
+ * packPCM() turns them into little-endian bytes.
+*/
+class Quantizer{
+  public:
+  enum class Shaping:int{
+    None=0,
+    FirstOrder=1, // (1 - z^-1), pushes noise toward Nyquist
+    Weighted=2    // 3-tap psychoacoustic (F-weighted) shaping for 44.1/48 kHz
+  };
+
+  static constexpr size_t BLOCK_SIZE=512;
+
+  private:
+  int bits=16;
+  int channels=1;
+  bool dither=true;
+  Shaping shaping=Shaping::None;
+  std::vector<float>errors; // 3 past errors per channel
+
+  public:
+  Quantizer(int bitDepth=16,int numChannels=1,bool useDither=true,Shaping shape=Shaping::None){configure(bitDepth,numChannels,useDither,shape);}
+
+  void configure(int bitDepth,int numChannels,bool useDither,Shaping shape){
+    bits=std::min(32,std::max(8,bitDepth));
+    channels=std::max(1,numChannels);
+    // float has no room left for a 32-bit LSB, dither would be pure rounding noise
+    dither=useDither && bits<32;
+    shaping=dither?shape:Shaping::None;
+    errors.assign(channels*3,0.0f);
+  }
+
+  void reset(){std::fill(errors.begin(),errors.end(),0.0f);}
+
+  inline int getBitDepth()const{return bits;}
+  inline int getChannels()const{return channels;}
+  inline bool getDither()const{return dither;}
+  inline Shaping getShaping()const{return shaping;}
+
+  // Quantize interleaved samples (count = frames * channels)
+  void process(const float *in,int32_t *out,size_t count){
+    if(bits<=16)processBlocks<float>(in,out,count);
+    else processBlocks<double>(in,out,count);
+  }
+
+  // Pack quantized values as little-endian PCM; 8-bit WAV is unsigned
+  static void packPCM(const int32_t *in,uint8_t *out,size_t count,int bits){
+    switch(bits){
+      case 8: for(size_t i=0;i<count;++i)out[i]=static_cast<uint8_t>(in[i]+128);break;
+      case 16: for(size_t i=0;i<count;++i){const uint32_t v=static_cast<uint32_t>(in[i]);out[2*i]=v & 0xFF;out[2*i+1]=(v>>8) & 0xFF;}break;
+      case 24: for(size_t i=0;i<count;++i){const uint32_t v=static_cast<uint32_t>(in[i]);out[3*i]=v & 0xFF;out[3*i+1]=(v>>8) & 0xFF;out[3*i+2]=(v>>16) & 0xFF;}break;
+      default: for(size_t i=0;i<count;++i){const uint32_t v=static_cast<uint32_t>(in[i]);out[4*i]=v & 0xFF;out[4*i+1]=(v>>8) & 0xFF;out[4*i+2]=(v>>16) & 0xFF;out[4*i+3]=(v>>24) & 0xFF;}break;
+    }
+  }
+
+  private:
+  template<typename T> void processBlocks(const float *in,int32_t *out,size_t count){
+    const T scale=static_cast<T>(int64_t{1}<<(bits-1));
+    const T lo=-scale,hi=scale-1;
+    float r1[BLOCK_SIZE],r2[BLOCK_SIZE];
+    FastRandom& rng=FastRandom::local();
+
+    for(size_t done=0;done<count;){
+      const size_t n=std::min(BLOCK_SIZE,count-done);
+      const float *src=in+done;
+      int32_t *dst=out+done;
+
+      if(!dither){
+        for(size_t i=0;i<n;++i)dst[i]=roundClamp<T>(static_cast<T>(src[i])*scale,lo,hi,scale);
+      }else{
+        rng.fillUniform(r1,n);
+        rng.fillUniform(r2,n);
+        if(shaping==Shaping::None){
+          // TPDF: difference of two uniforms, +-1 LSB triangular
+          for(size_t i=0;i<n;++i)dst[i]=roundClamp<T>(static_cast<T>(src[i])*scale+static_cast<T>(r1[i]-r2[i]),lo,hi,scale);
+        }else{
+          shapeBlock<T>(src,dst,r1,r2,n,done,scale,lo,hi);
+        }
+      }
+      done+=n;
+    }
+  }
+
+  template<typename T> void shapeBlock(const float *src,int32_t *dst,const float *r1,const float *r2,size_t n,size_t offset,T scale,T lo,T hi){
+    static constexpr float weighted[3]={1.623f,-0.982f,0.109f};
+    for(size_t i=0;i<n;++i){
+      const int c=static_cast<int>((offset+i)%channels);
+      float *e=&errors[c*3];
+      const float fb=shaping==Shaping::FirstOrder?e[0]:weighted[0]*e[0]+weighted[1]*e[1]+weighted[2]*e[2];
+      const T wanted=static_cast<T>(src[i])*scale-static_cast<T>(fb);
+      const int32_t q=roundClamp<T>(wanted+static_cast<T>(r1[i]-r2[i]),lo,hi,scale);
+      e[2]=e[1];e[1]=e[0];
+      // clipped samples leave a large error, keep it from ringing through the filter
+      e[0]=std::min(2.0f,std::max(-2.0f,static_cast<float>(static_cast<T>(q)-wanted)));
+      dst[i]=q;
+    }
+  }
+
+  // Round half up and clamp; truncation of a positive value is floor, so offset first
+  template<typename T> static inline int32_t roundClamp(T v,T lo,T hi,T scale){
+    using I=typename std::conditional<std::is_same<T,float>::value,int32_t,int64_t>::type;
+    v=v<lo?lo:(v>hi?hi:v);
+    return static_cast<int32_t>(static_cast<I>(v+scale+static_cast<T>(0.5))-static_cast<I>(scale));
+  }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Radix-2 FFT plan
+ *
+ * Real and imaginary parts live in separate arrays and each stage has its own
+ * contiguous twiddle table, so every butterfly loop is a straight SIMD-friendly
+ * pass. A plan owns its scratch buffers: create one per thread and reuse it.
+ * Real input of size N runs as a complex FFT of size N/2.
+*/
+class FFT{
+  public:
+  enum class Window:int{
+    Rectangular=0,
+    Hann=1,
+    Hamming=2,
+    Blackman=3
+  };
+
+  private:
+  size_t n=0;      // real transform size
+  size_t half=0;   // complex transform size
+  std::vector<uint32_t>bitrev;
+  std::vector<float>twRe,twIm;       // per stage, concatenated
+  std::vector<float>postRe,postIm;   // real-split twiddles e^{-2 pi i k/n}
+  std::vector<float>re,im;           // scratch
+
+  public:
+  FFT(){}
+  explicit FFT(size_t size){init(size);}
+
+  static bool isPowerOfTwo(size_t v){return v>=2 && (v & (v-1))==0;}
+
+  // size must be a power of two >= 4
+  bool init(size_t size){
+    if(!isPowerOfTwo(size) || size<4)return false;
+    n=size;
+    half=size/2;
+
+    int bits=0;
+    while((size_t{1}<<bits)<half)++bits;
+    bitrev.resize(half);
+    for(size_t i=0;i<half;++i){
+      uint32_t r=0;
+      for(int b=0;b<bits;++b)if(i & (size_t{1}<<b))r|=1u<<(bits-1-b);
+      bitrev[i]=r;
+    }
+
+    twRe.clear();twIm.clear();
+    for(size_t len=2;len<=half;len<<=1){
+      for(size_t j=0;j<len/2;++j){
+        const double a=-2.0*M_PI*static_cast<double>(j)/static_cast<double>(len);
+        twRe.push_back(static_cast<float>(std::cos(a)));
+        twIm.push_back(static_cast<float>(std::sin(a)));
+      }
+    }
+
+    postRe.resize(half);postIm.resize(half);
+    for(size_t k=0;k<half;++k){
+      const double a=-2.0*M_PI*static_cast<double>(k)/static_cast<double>(n);
+      postRe[k]=static_cast<float>(std::cos(a));
+      postIm[k]=static_cast<float>(std::sin(a));
+    }
+    re.assign(half,0.0f);
+    im.assign(half,0.0f);
+    return true;
+  }
+
+  inline size_t size()const{return n;}
+  inline size_t bins()const{return half+1;}
+
+  // In-place complex FFT of size()/2 points on split arrays
+  void complexForward(float *r,float *i)const{
+    for(size_t k=0;k<half;++k){
+      const size_t j=bitrev[k];
+      if(j>k){std::swap(r[k],r[j]);std::swap(i[k],i[j]);}
+    }
+    size_t tw=0;
+    for(size_t len=2;len<=half;len<<=1){
+      const size_t h=len/2;
+      const float *wr=&twRe[tw],*wi=&twIm[tw];
+      for(size_t s=0;s<half;s+=len){
+        float *ar=r+s,*ai=i+s,*br=r+s+h,*bi=i+s+h;
+        for(size_t j=0;j<h;++j){
+          const float xr=br[j]*wr[j]-bi[j]*wi[j];
+          const float xi=br[j]*wi[j]+bi[j]*wr[j];
+          br[j]=ar[j]-xr;bi[j]=ai[j]-xi;
+          ar[j]+=xr;ai[j]+=xi;
+        }
+      }
+      tw+=h;
+    }
+  }
+
+  // Real input of size() samples -> bins() complex bins
+  void forwardReal(const float *in,float *outRe,float *outIm){
+    for(size_t k=0;k<half;++k){re[k]=in[2*k];im[k]=in[2*k+1];}
+    complexForward(re.data(),im.data());
+
+    outRe[0]=re[0]+im[0];outIm[0]=0.0f;
+    outRe[half]=re[0]-im[0];outIm[half]=0.0f;
+    for(size_t k=1;k<half;++k){
+      const size_t m=half-k;
+      // even/odd parts of the packed transform
+      const float er=0.5f*(re[k]+re[m]),ei=0.5f*(im[k]-im[m]);
+      const float or_=0.5f*(im[k]+im[m]),oi=-0.5f*(re[k]-re[m]);
+      const float tr=or_*postRe[k]-oi*postIm[k];
+      const float ti=or_*postIm[k]+oi*postRe[k];
+      outRe[k]=er+tr;
+      outIm[k]=ei+ti;
+    }
+  }
+
+  // Windowed power spectrum |X|^2 of size() samples, bins() values
+  void powerSpectrum(const float *in,const float *window,float *power,float *scratchRe,float *scratchIm,float *windowed){
+    for(size_t k=0;k<n;++k)windowed[k]=in[k]*window[k];
+    forwardReal(windowed,scratchRe,scratchIm);
+    for(size_t k=0;k<=half;++k)power[k]=scratchRe[k]*scratchRe[k]+scratchIm[k]*scratchIm[k];
+  }
+
+  static std::vector<float>makeWindow(Window type,size_t size){
+    std::vector<float>w(size,1.0f);
+    const double d=static_cast<double>(size);
+    for(size_t k=0;k<size;++k){
+      const double x=2.0*M_PI*static_cast<double>(k)/d; // periodic, for STFT overlap-add
+      switch(type){
+        case Window::Hann: w[k]=static_cast<float>(0.5-0.5*std::cos(x));break;
+        case Window::Hamming: w[k]=static_cast<float>(0.54-0.46*std::cos(x));break;
+        case Window::Blackman: w[k]=static_cast<float>(0.42-0.5*std::cos(x)+0.08*std::cos(2.0*x));break;
+        default: break;
+      }
+    }
+    return w;
+  }
+};
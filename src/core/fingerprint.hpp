@@ -0,0 +1,478 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include <sndfile.hh>
+
+#include "fft.hpp"
+#include "io.hpp"
+#include "parallel.hpp"
+
+/*
+ * Acoustic fingerprint
+ *
+ * Audio is mixed to mono and resampled to 5512 Hz, so encodings at different
+ * rates land on the same grid. Frames of 0.37 s every 11.6 ms are split into
+ * 33 log-spaced bands between 300 and 2000 Hz, and each frame gives one 32-bit
+ * sub-fingerprint: bit m is the sign of the change, over time, of the energy
+ * difference between bands m and m+1. Re-encodes flip only a few bits.
+*/
+class Fingerprint{
+  public:
+  static constexpr uint32_t RATE=5512;
+  static constexpr size_t FRAME=2048;
+  static constexpr size_t HOP=64;
+  static constexpr int BANDS=33;
+  static constexpr double LOW_HZ=300.0;
+  static constexpr double HIGH_HZ=2000.0;
+
+  std::vector<uint32_t>bits; // one sub-fingerprint per hop
+  double duration=0.0;       // seconds of source audio
+
+  inline bool empty()const{return bits.empty();}
+
+  // Bit error rate of b against a over their overlap when b is shifted by offset sub-fingerprints
+  static float bitErrorRate(const Fingerprint& a,const Fingerprint& b,int64_t offset=0,size_t *compared=nullptr){
+    const int64_t aStart=std::max<int64_t>(0,offset);
+    const int64_t bStart=std::max<int64_t>(0,-offset);
+    const int64_t n=std::min<int64_t>(static_cast<int64_t>(a.bits.size())-aStart,static_cast<int64_t>(b.bits.size())-bStart);
+    if(compared)*compared=n>0?static_cast<size_t>(n):0;
+    if(n<=0)return 1.0f;
+    uint64_t errors=0;
+    for(int64_t i=0;i<n;++i)errors+=popcount(a.bits[aStart+i]^b.bits[bStart+i]);
+    return static_cast<float>(errors)/(32.0f*n);
+  }
+
+  class Builder;
+
+  // Interleaved samples at any rate
+  static Fingerprint compute(const float *samples,uint64_t frames,int channels,uint32_t sampleRate);
+
+  // Streams the file in blocks, so memory does not grow with its length
+  static bool computeFile(const std::string& path,Fingerprint& out);
+
+  static inline int popcount(uint32_t v){
+    v=v-((v>>1) & 0x55555555u);
+    v=(v & 0x33333333u)+((v>>2) & 0x33333333u);
+    return static_cast<int>((((v+(v>>4)) & 0x0F0F0F0Fu)*0x01010101u)>>24);
+  }
+};
+
+/*
+ * Incremental fingerprinting
+ *
+ * push() takes interleaved blocks of any size in order; finish() returns the
+ * same fingerprint compute() gives for the whole buffer. The resampler keeps
+ * only its filter span of input and the analysis only one frame of 5512 Hz
+ * audio, so a file can be fingerprinted while it streams past other analyses.
+*/
+class Fingerprint::Builder{
+  private:
+  static constexpr int PHASES=64;
+  static constexpr size_t TRIM=1<<16; // drop consumed history in chunks of at least this much
+
+  int channels=0;
+  uint32_t sampleRate=0;
+  double step=1.0;
+  int half=0;
+  std::vector<float>table;   // h[p][k]: tap k for fractional offset p/PHASES
+
+  std::vector<float>mono;    // input-rate mono, mono[0] is input frame monoStart
+  uint64_t monoStart=0;
+  uint64_t monoEnd=0;        // frames pushed
+  uint64_t produced=0;       // 5512 Hz samples made
+
+  std::vector<float>low;     // 5512 Hz samples, low[0] is sample lowStart
+  uint64_t lowStart=0;
+  uint64_t hop=0;            // next analysis frame
+
+  FFT fft;
+  std::vector<float>window,re,im,power,windowed;
+  int edges[BANDS+1]{};
+  float prev[BANDS]{};
+  Fingerprint fp;
+
+  public:
+  Builder(int numChannels,uint32_t rate):channels(numChannels),sampleRate(rate),fft(FRAME){
+    if(channels<=0 || sampleRate==0)return;
+    // Windowed-sinc low-pass evaluated only at the output instants
+    step=static_cast<double>(rate)/RATE;
+    const double cutoff=0.45*RATE/std::max<double>(rate,RATE); // of the input rate
+    const int zeros=8;
+    half=static_cast<int>(std::ceil(zeros/(2.0*cutoff)));
+    table.resize(static_cast<size_t>(PHASES+1)*(2*half+1));
+    for(int p=0;p<=PHASES;++p){
+      float sum=0.0f;
+      float *row=table.data()+static_cast<size_t>(p)*(2*half+1);
+      for(int k=-half;k<=half;++k){
+        const double t=k-static_cast<double>(p)/PHASES;
+        const double x=2.0*cutoff*t;
+        const double sinc=std::fabs(x)<1e-9?1.0:std::sin(M_PI*x)/(M_PI*x);
+        const double w=std::fabs(t)>=half?0.0:0.5+0.5*std::cos(M_PI*t/half);
+        row[k+half]=static_cast<float>(sinc*w);
+        sum+=row[k+half];
+      }
+      if(sum!=0.0f)for(int k=0;k<2*half+1;++k)row[k]/=sum;
+    }
+
+    window=FFT::makeWindow(FFT::Window::Hann,FRAME);
+    re.resize(fft.bins());im.resize(fft.bins());power.resize(fft.bins());windowed.resize(FRAME);
+    for(int b=0;b<=BANDS;++b){
+      const double hz=LOW_HZ*std::pow(HIGH_HZ/LOW_HZ,static_cast<double>(b)/BANDS);
+      edges[b]=static_cast<int>(hz*FRAME/RATE+0.5);
+    }
+  }
+
+  void push(const float *in,size_t frames){
+    if(channels<=0 || sampleRate==0 || frames==0)return;
+    const size_t at=mono.size();
+    mono.resize(at+frames);
+    const float mix=1.0f/channels;
+    for(size_t f=0;f<frames;++f){
+      float v=0.0f;
+      for(int c=0;c<channels;++c)v+=in[f*channels+c];
+      mono[at+f]=v*mix;
+    }
+    monoEnd+=frames;
+    resample(false);
+    analyze();
+  }
+
+  Fingerprint finish(){
+    if(channels<=0 || sampleRate==0 || monoEnd==0)return Fingerprint{};
+    resample(true);
+    analyze();
+    fp.duration=static_cast<double>(monoEnd)/sampleRate;
+    return std::move(fp);
+  }
+
+  private:
+  // Output samples whose taps are all available; at the end, the rest with the taps past the end dropped
+  void resample(bool final){
+    const uint64_t count=static_cast<uint64_t>(monoEnd/step);
+    for(;produced<count;++produced){
+      const double pos=produced*step;
+      const int64_t base=static_cast<int64_t>(pos);
+      if(!final && base+half>=static_cast<int64_t>(monoEnd))break;
+      const int p=static_cast<int>((pos-base)*PHASES+0.5);
+      const float *row=table.data()+static_cast<size_t>(p)*(2*half+1);
+      float acc=0.0f;
+      const int64_t first=base-half;
+      const int kMin=static_cast<int>(std::max<int64_t>(0,-first));
+      const int kMax=static_cast<int>(std::min<int64_t>(2*half,static_cast<int64_t>(monoEnd)-1-first));
+      const float *src=mono.data()+(first-static_cast<int64_t>(monoStart));
+      for(int k=kMin;k<=kMax;++k)acc+=src[k]*row[k];
+      low.push_back(acc);
+    }
+    const int64_t keep=static_cast<int64_t>(produced*step)-half;
+    if(keep>static_cast<int64_t>(monoStart+TRIM)){
+      const size_t drop=static_cast<size_t>(keep-static_cast<int64_t>(monoStart));
+      mono.erase(mono.begin(),mono.begin()+drop);
+      monoStart+=drop;
+    }
+  }
+
+  void analyze(){
+    float energy[BANDS];
+    for(;hop*HOP+FRAME<=lowStart+low.size();++hop){
+      fft.powerSpectrum(low.data()+(hop*HOP-lowStart),window.data(),power.data(),re.data(),im.data(),windowed.data());
+      for(int b=0;b<BANDS;++b){
+        float e=0.0f;
+        for(int k=edges[b];k<std::max(edges[b]+1,edges[b+1]);++k)e+=power[k];
+        energy[b]=e;
+      }
+      if(hop>0){
+        uint32_t word=0;
+        for(int m=0;m<32;++m){
+          const float d=(energy[m]-energy[m+1])-(prev[m]-prev[m+1]);
+          if(d>0.0f)word|=1u<<m;
+        }
+        fp.bits.push_back(word);
+      }
+      std::copy(energy,energy+BANDS,prev);
+    }
+    if(hop*HOP>lowStart+TRIM){
+      const size_t drop=static_cast<size_t>(hop*HOP-lowStart);
+      low.erase(low.begin(),low.begin()+drop);
+      lowStart+=drop;
+    }
+  }
+};
+
+inline Fingerprint Fingerprint::compute(const float *samples,uint64_t frames,int channels,uint32_t sampleRate){
+  if(channels<=0 || sampleRate==0 || frames==0)return Fingerprint{};
+  Builder builder(channels,sampleRate);
+  builder.push(samples,static_cast<size_t>(frames));
+  return builder.finish();
+}
+
+inline bool Fingerprint::computeFile(const std::string& path,Fingerprint& out){
+  SF_INFO info;
+  SNDFILE *file=openSoundFile(path,info);
+  if(!file)return false;
+  Builder builder(info.channels,static_cast<uint32_t>(info.samplerate));
+  std::vector<float>block(static_cast<size_t>(65536*info.channels));
+  sf_count_t got;
+  while((got=sf_readf_float(file,block.data(),65536))>0)builder.push(block.data(),static_cast<size_t>(got));
+  sf_close(file);
+  out=builder.finish();
+  return true;
+}
+
+/*
+ * Fingerprint library
+ *
+ * Every STRIDE-th sub-fingerprint of each file goes into a hash table keyed on
+ * its 32-bit value. A query looks up all of its own sub-fingerprints, votes
+ * for (file, time offset) pairs and verifies only the best few by bit error
+ * rate, so the cost follows the number of hits, not the library size. Keys
+ * that occur too often (silence, hum) are ignored. Fingerprints are cached on
+ * disk with each file's size and mtime, so rescans only fingerprint new or
+ * changed files.
+*/
+class FingerprintLibrary{
+  public:
+  static constexpr size_t STRIDE=4;
+  static constexpr size_t MAX_POSTINGS=4096; // per key, beyond this it is a stop word
+
+  struct Entry{
+    std::string path;
+    int64_t mtime{};
+    uint64_t size{};
+    Fingerprint fingerprint;
+  };
+
+  struct Match{
+    size_t file{};      // entry index
+    int64_t offset{};   // sub-fingerprints; positive when the query starts later in the file
+    float ber{1.0f};    // bit error rate over the overlap
+  };
+
+  struct Duplicate{
+    size_t a{},b{};     // entry indices, a<b
+    float ber{};
+  };
+
+  private:
+  struct Posting{
+    uint32_t file;
+    uint32_t offset;
+  };
+
+  std::vector<Entry>entries;
+  std::unordered_map<std::string,size_t>byPath;
+  std::unordered_map<uint32_t,std::vector<Posting>>index;
+
+  public:
+  inline size_t size()const{return entries.size();}
+  inline const Entry& at(size_t i)const{return entries[i];}
+
+  // Fingerprint the paths that are new or changed since they were cached; returns how many were computed
+  size_t scan(const std::vector<std::string>& paths,size_t threads=0){
+    std::vector<size_t>todo;
+    std::vector<Entry>fresh(paths.size());
+    for(size_t i=0;i<paths.size();++i){
+      Entry& e=fresh[i];
+      e.path=paths[i];
+      if(!statFile(e.path,e.mtime,e.size))continue;
+      auto it=byPath.find(e.path);
+      if(it!=byPath.end() && entries[it->second].mtime==e.mtime && entries[it->second].size==e.size)continue;
+      todo.push_back(i);
+    }
+
+    std::vector<char>ok(todo.size(),0);
+    parallelForEach(todo.size(),[&](size_t t){
+      ok[t]=Fingerprint::computeFile(fresh[todo[t]].path,fresh[todo[t]].fingerprint);
+    },threads);
+
+    size_t added=0;
+    bool replaced=false;
+    for(size_t t=0;t<todo.size();++t){
+      if(!ok[t])continue;
+      Entry& e=fresh[todo[t]];
+      auto it=byPath.find(e.path);
+      if(it!=byPath.end()){
+        entries[it->second]=std::move(e);
+        replaced=true;
+      }else{
+        byPath[e.path]=entries.size();
+        entries.push_back(std::move(e));
+        if(!replaced)indexEntry(entries.size()-1);
+      }
+      ++added;
+    }
+    if(replaced)rebuildIndex();
+    return added;
+  }
+
+  // Add or replace a fingerprint computed elsewhere (e.g. from an already loaded buffer)
+  size_t add(const std::string& path,Fingerprint fp){
+    Entry e;
+    e.path=path;
+    statFile(path,e.mtime,e.size,false); // may be a buffer that was never saved
+    e.fingerprint=std::move(fp);
+    auto it=byPath.find(path);
+    if(it!=byPath.end()){
+      entries[it->second]=std::move(e);
+      rebuildIndex();
+      return it->second;
+    }
+    byPath[path]=entries.size();
+    entries.push_back(std::move(e));
+    indexEntry(entries.size()-1);
+    return entries.size()-1;
+  }
+
+  // Best matches for a fingerprint, lowest bit error rate first
+  std::vector<Match>query(const Fingerprint& fp,float maxBER=0.35f,size_t minVotes=2,size_t maxCandidates=8)const{
+    std::unordered_map<uint64_t,uint32_t>votes; // (file<<32 | offset bias) -> count
+    const int64_t BIAS=int64_t{1}<<31;
+    for(size_t i=0;i<fp.bits.size();++i){
+      auto it=index.find(fp.bits[i]);
+      if(it==index.end() || it->second.size()>MAX_POSTINGS)continue;
+      for(const Posting& p:it->second){
+        const int64_t offset=static_cast<int64_t>(p.offset)-static_cast<int64_t>(i);
+        ++votes[(static_cast<uint64_t>(p.file)<<32) | static_cast<uint32_t>(offset+BIAS)];
+      }
+    }
+
+    std::vector<std::pair<uint32_t,uint64_t>>ranked;
+    for(const auto& v:votes)if(v.second>=minVotes)ranked.push_back({v.second,v.first});
+    const size_t keep=std::min(ranked.size(),maxCandidates*4);
+    std::partial_sort(ranked.begin(),ranked.begin()+keep,ranked.end(),[](const auto& a,const auto& b){return a.first>b.first || (a.first==b.first && a.second<b.second);});
+    ranked.resize(keep);
+
+    std::vector<Match>out;
+    for(const auto& r:ranked){
+      Match m;
+      m.file=static_cast<size_t>(r.second>>32);
+      m.offset=static_cast<int64_t>(r.second & 0xFFFFFFFFu)-BIAS;
+      bool seen=false;
+      for(const Match& o:out)if(o.file==m.file){seen=true;break;}
+      if(seen)continue;
+      m.ber=Fingerprint::bitErrorRate(entries[m.file].fingerprint,fp,m.offset);
+      if(m.ber<=maxBER)out.push_back(m);
+      if(out.size()>=maxCandidates)break;
+    }
+    std::sort(out.begin(),out.end(),[](const Match& a,const Match& b){return a.ber<b.ber;});
+    return out;
+  }
+
+  // All near-duplicate pairs in the library, queries run in parallel
+  std::vector<Duplicate>findDuplicates(float maxBER=0.35f,size_t threads=0)const{
+    std::vector<Duplicate>out;
+    std::mutex mutex;
+    parallelForEach(entries.size(),[&](size_t i){
+      std::vector<Duplicate>local;
+      for(const Match& m:query(entries[i].fingerprint,maxBER))if(m.file>i)local.push_back({i,m.file,m.ber});
+      if(local.empty())return;
+      std::lock_guard<std::mutex>lock(mutex);
+      out.insert(out.end(),local.begin(),local.end());
+    },threads);
+    std::sort(out.begin(),out.end(),[](const Duplicate& x,const Duplicate& y){return x.a<y.a || (x.a==y.a && x.b<y.b);});
+    return out;
+  }
+
+  // ---------------- Cache file ----------------
+  bool saveCache(const std::string& path)const{
+    const std::string tmp=path+".tmp";
+    std::ofstream file(tmp,std::ios::binary);
+    if(!file){
+      std::cerr << "Error writing fingerprint cache: " << tmp << std::endl;
+      return false;
+    }
+    file.write(CACHE_MAGIC,4);
+    write(file,CACHE_VERSION);
+    write(file,static_cast<uint64_t>(entries.size()));
+    for(const Entry& e:entries){
+      write(file,static_cast<uint32_t>(e.path.size()));
+      file.write(e.path.data(),e.path.size());
+      write(file,e.mtime);
+      write(file,e.size);
+      write(file,e.fingerprint.duration);
+      write(file,static_cast<uint64_t>(e.fingerprint.bits.size()));
+      file.write(reinterpret_cast<const char*>(e.fingerprint.bits.data()),e.fingerprint.bits.size()*sizeof(uint32_t));
+    }
+    file.close();
+    if(!file || std::rename(tmp.c_str(),path.c_str())!=0){
+      std::cerr << "Error writing fingerprint cache: " << path << std::endl;
+      std::remove(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool loadCache(const std::string& path){
+    std::ifstream file(path,std::ios::binary);
+    if(!file)return false;
+    char magic[4];
+    uint32_t version=0;
+    uint64_t count=0;
+    file.read(magic,4);
+    if(!file || std::string(magic,4)!=std::string(CACHE_MAGIC,4) || !read(file,version) || version!=CACHE_VERSION || !read(file,count)){
+      std::cerr << "Invalid fingerprint cache: " << path << std::endl;
+      return false;
+    }
+    std::vector<Entry>loaded;
+    for(uint64_t i=0;i<count;++i){
+      Entry e;
+      uint32_t len=0;
+      uint64_t n=0;
+      if(!read(file,len))break;
+      e.path.resize(len);
+      file.read(&e.path[0],len);
+      if(!read(file,e.mtime) || !read(file,e.size) || !read(file,e.fingerprint.duration) || !read(file,n))break;
+      e.fingerprint.bits.resize(n);
+      file.read(reinterpret_cast<char*>(e.fingerprint.bits.data()),n*sizeof(uint32_t));
+      if(!file)break;
+      loaded.push_back(std::move(e));
+    }
+    if(loaded.size()!=count){
+      std::cerr << "Truncated fingerprint cache: " << path << std::endl;
+      return false;
+    }
+    entries=std::move(loaded);
+    byPath.clear();
+    for(size_t i=0;i<entries.size();++i)byPath[entries[i].path]=i;
+    rebuildIndex();
+    return true;
+  }
+
+  private:
+  static constexpr char CACHE_MAGIC[4]={'S','Z','F','P'};
+  static constexpr uint32_t CACHE_VERSION=1;
+
+  template<typename T> static void write(std::ofstream& f,const T& v){f.write(reinterpret_cast<const char*>(&v),sizeof(T));}
+  template<typename T> static bool read(std::ifstream& f,T& v){f.read(reinterpret_cast<char*>(&v),sizeof(T));return static_cast<bool>(f);}
+
+  static bool statFile(const std::string& path,int64_t& mtime,uint64_t& size,bool report=true){
+    struct stat st;
+    if(stat(path.c_str(),&st)!=0){
+      if(report)std::cerr << "Error reading file: " << path << std::endl;
+      return false;
+    }
+    mtime=static_cast<int64_t>(st.st_mtime);
+    size=static_cast<uint64_t>(st.st_size);
+    return true;
+  }
+
+  void indexEntry(size_t i){
+    const std::vector<uint32_t>& bits=entries[i].fingerprint.bits;
+    for(size_t k=0;k<bits.size();k+=STRIDE)index[bits[k]].push_back({static_cast<uint32_t>(i),static_cast<uint32_t>(k)});
+  }
+
+  void rebuildIndex(){
+    index.clear();
+    for(size_t i=0;i<entries.size();++i)indexEntry(i);
+  }
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Work-stealing deque (Chase-Lev, fixed capacity)
+ *
+ * The owner pushes and pops at the bottom, thieves steal from the top. The
+ * capacity is the node count of the graph, so it never grows at run time.
+*/
+class WorkStealingDeque{
+  private:
+  std::unique_ptr<std::atomic<int>[]>items;
+  int64_t mask=0;
+  alignas(64) std::atomic<int64_t>top{0};
+  alignas(64) std::atomic<int64_t>bottom{0};
+
+  public:
+  void reset(size_t capacity){
+    int64_t n=1;
+    while(n<static_cast<int64_t>(capacity))n<<=1;
+    items.reset(new std::atomic<int>[n]);
+    mask=n-1;
+    top.store(0);
+    bottom.store(0);
+  }
+
+  void push(int item){
+    const int64_t b=bottom.load(std::memory_order_relaxed);
+    items[b & mask].store(item,std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b+1,std::memory_order_relaxed);
+  }
+
+  bool pop(int& item){
+    const int64_t b=bottom.load(std::memory_order_relaxed)-1;
+    bottom.store(b,std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t=top.load(std::memory_order_relaxed);
+    if(t>b){
+      bottom.store(b+1,std::memory_order_relaxed);
+      return false;
+    }
+    item=items[b & mask].load(std::memory_order_relaxed);
+    if(t==b){
+      // last item, race against thieves
+      const bool won=top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+      bottom.store(b+1,std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  bool steal(int& item){
+    int64_t t=top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b=bottom.load(std::memory_order_acquire);
+    if(t>=b)return false;
+    item=items[t & mask].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+  }
+};
+
+/*
+ * Processing graph
+ *
+ * A DAG of nodes (sources -> effects -> buses -> master). Each node owns an
+ * interleaved buffer; before it runs, the buffers of its inputs are summed
+ * into it in connection order, then its process function works in place.
+ * Because every node always sees the same inputs in the same order, output
+ * is identical no matter which thread ran what.
+ *
+ * process() is called from the audio callback. It never locks or allocates:
+ * it seeds the ready nodes, wakes the worker pool through an epoch counter
+ * and then works alongside the workers until every node has run.
+ *
+ * Build the graph (addNode/connect/compile/setThreadCount) while it is not
+ * being processed. compile() and setThreadCount() rebuild the work deques,
+ * so they stop the workers first and restart them after; process() must not
+ * run concurrently with either. Workers read the node count each cycle, so
+ * the order of setThreadCount() and building the graph does not matter.
+*/
+class ProcessingGraph{
+  public:
+  // In-place processing of one node's buffer
+  using ProcessFn=std::function<void(float* buffer,size_t frames,int channels)>;
+
+  enum class NodeType:int{
+    Source=0,
+    Effect=1,
+    Bus=2,
+    Master=3
+  };
+
+  private:
+  static constexpr unsigned IDLE_SPINS=1024; // failed steal attempts before yielding
+
+  struct Node{
+    NodeType type;
+    ProcessFn fn;
+    std::vector<int>inputs;
+    std::vector<int>outputs;
+    std::vector<float>buffer;
+  };
+
+  std::vector<Node>nodes;
+  std::unique_ptr<std::atomic<int>[]>pending; // unresolved inputs per node this cycle
+  std::vector<int>roots;
+  int master=-1;
+  int channels=2;
+  size_t maxFrames=0;
+  bool compiled=false;
+
+  // Worker pool, slot 0 is the calling (audio) thread
+  std::unique_ptr<WorkStealingDeque[]>deques;
+  size_t dequeCount=0;
+  std::vector<std::thread>workers;
+  std::atomic<uint64_t>epoch{0};
+  std::atomic<int>cycleNodes{0};   // nodes to run this cycle, published before the epoch bump
+  std::atomic<int>completed{0};
+  std::atomic<bool>quit{false};
+  int workerPriority=0;
+  size_t currentFrames=0;
+
+  public:
+  ProcessingGraph(){resetDeques(1);}
+  ~ProcessingGraph(){stopWorkers();}
+
+  ProcessingGraph(const ProcessingGraph&)=delete;
+  ProcessingGraph& operator=(const ProcessingGraph&)=delete;
+
+  int addNode(NodeType type,ProcessFn fn=nullptr){
+    nodes.push_back({type,std::move(fn),{},{},{}});
+    compiled=false;
+    int id=static_cast<int>(nodes.size())-1;
+    if(type==NodeType::Master)master=id;
+    return id;
+  }
+
+  bool connect(int from,int to){
+    if(from<0 || to<0 || from>=static_cast<int>(nodes.size()) || to>=static_cast<int>(nodes.size()) || from==to)return false;
+    nodes[from].outputs.push_back(to);
+    nodes[to].inputs.push_back(from);
+    compiled=false;
+    return true;
+  }
+
+  // Validate (acyclic, has a master) and allocate buffers for blocks of up to maxBlockFrames
+  bool compile(size_t maxBlockFrames,int numChannels){
+    compiled=false;
+    if(master<0 || nodes.empty() || numChannels<=0 || maxBlockFrames==0)return false;
+    channels=numChannels;
+    maxFrames=maxBlockFrames;
+
+    // Kahn's algorithm, only to reject cycles
+    std::vector<int>indeg(nodes.size()),queue;
+    for(size_t i=0;i<nodes.size();++i)if((indeg[i]=static_cast<int>(nodes[i].inputs.size()))==0)queue.push_back(static_cast<int>(i));
+    roots=queue;
+    size_t visited=0;
+    while(visited<queue.size()){
+      int n=queue[visited++];
+      for(int o:nodes[n].outputs)if(--indeg[o]==0)queue.push_back(o);
+    }
+    if(visited!=nodes.size()){
+      std::cerr << "ProcessingGraph: cycle detected\n";
+      return false;
+    }
+
+    for(Node& n:nodes)n.buffer.assign(maxFrames*channels,0.0f);
+    pending.reset(new std::atomic<int>[nodes.size()]);
+    const size_t count=workers.size();
+    stopWorkers();   // they may still be polling the deques about to be freed
+    resetDeques(dequeCount);
+    startWorkers(count);
+    compiled=true;
+    return true;
+  }
+
+  // Number of extra worker threads (0 = everything runs on the calling thread).
+  // realtimePriority>0 puts workers on SCHED_FIFO; match the audio callback's
+  // priority, a higher one lets idle workers starve it.
+  void setThreadCount(size_t count,int realtimePriority=0){
+    stopWorkers();
+    workerPriority=realtimePriority;
+    resetDeques(count+1);
+    startWorkers(count);
+  }
+
+  inline size_t getThreadCount()const{return workers.size();}
+  inline size_t getNodeCount()const{return nodes.size();}
+  inline int getChannels()const{return channels;}
+  inline const float* getNodeBuffer(int id)const{return nodes[id].buffer.data();}
+
+  // Render one block into out (interleaved). Real-time safe.
+  bool process(float *out,size_t frames){
+    if(!compiled){
+      std::fill(out,out+frames*channels,0.0f);
+      return false;
+    }
+    while(frames>0){
+      const size_t n=std::min(frames,maxFrames);
+      runCycle(n);
+      const float *src=nodes[master].buffer.data();
+      std::copy(src,src+n*channels,out);
+      out+=n*channels;
+      frames-=n;
+    }
+    return true;
+  }
+
+  private:
+  void runCycle(size_t frames){
+    currentFrames=frames;
+    for(size_t i=0;i<nodes.size();++i)pending[i].store(static_cast<int>(nodes[i].inputs.size()),std::memory_order_relaxed);
+    completed.store(0,std::memory_order_relaxed);
+    for(int r:roots)deques[0].push(r);
+    const int total=static_cast<int>(nodes.size());
+    cycleNodes.store(total,std::memory_order_relaxed);
+    epoch.fetch_add(1,std::memory_order_release);
+
+    unsigned idle=0;
+    while(completed.load(std::memory_order_acquire)<total){
+      int id;
+      if(findWork(0,id)){runNode(0,id);idle=0;}
+      else if(++idle>IDLE_SPINS)std::this_thread::yield(); // only when oversubscribed
+    }
+  }
+
+  bool findWork(size_t self,int& id){
+    if(deques[self].pop(id))return true;
+    const size_t n=dequeCount;
+    for(size_t k=1;k<n;++k)if(deques[(self+k)%n].steal(id))return true;
+    return false;
+  }
+
+  void runNode(size_t self,int id){
+    Node& node=nodes[id];
+    const size_t count=currentFrames*channels;
+    float *buf=node.buffer.data();
+
+    if(node.inputs.empty()){
+      std::fill(buf,buf+count,0.0f);
+    }else{
+      const float *first=nodes[node.inputs[0]].buffer.data();
+      std::copy(first,first+count,buf);
+      for(size_t i=1;i<node.inputs.size();++i){
+        const float *in=nodes[node.inputs[i]].buffer.data();
+        for(size_t s=0;s<count;++s)buf[s]+=in[s];
+      }
+    }
+    if(node.fn)node.fn(buf,currentFrames,channels);
+
+    for(int o:node.outputs)if(pending[o].fetch_sub(1,std::memory_order_acq_rel)==1)deques[self].push(o);
+    completed.fetch_add(1,std::memory_order_release);
+  }
+
+  void workerLoop(size_t self,int realtimePriority){
+    // Best effort, falls back silently without permission
+    if(realtimePriority>0){
+      sched_param param{};
+      param.sched_priority=std::min(realtimePriority,sched_get_priority_max(SCHED_FIFO));
+      pthread_setschedparam(pthread_self(),SCHED_FIFO,&param);
+    }
+
+    uint64_t seen=epoch.load(std::memory_order_acquire);
+    while(!quit.load(std::memory_order_acquire)){
+      // Wait for a new cycle: spin, then yield, then nap
+      unsigned spins=0;
+      while(epoch.load(std::memory_order_acquire)==seen && !quit.load(std::memory_order_relaxed)){
+        if(++spins<2000)continue;
+        if(spins<4000)std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+      seen=epoch.load(std::memory_order_acquire);
+      const int total=cycleNodes.load(std::memory_order_relaxed); // ordered by the acquire above
+
+      unsigned idle=0;
+      while(completed.load(std::memory_order_acquire)<total && !quit.load(std::memory_order_relaxed)){
+        int id;
+        if(findWork(self,id)){runNode(self,id);idle=0;}
+        else if(++idle>IDLE_SPINS)std::this_thread::yield();
+      }
+    }
+  }
+
+  void resetDeques(size_t count){
+    deques.reset(new WorkStealingDeque[count]);
+    dequeCount=count;
+    for(size_t i=0;i<count;++i)deques[i].reset(std::max<size_t>(nodes.size(),1));
+  }
+
+  void startWorkers(size_t count){
+    quit.store(false);
+    for(size_t i=1;i<=count;++i)workers.emplace_back(&ProcessingGraph::workerLoop,this,i,workerPriority);
+  }
+
+  void stopWorkers(){
+    quit.store(true);
+    for(std::thread& t:workers)if(t.joinable())t.join();
+    workers.clear();
+  }
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "piece_table.hpp"
+
+/*
+ * Undo/redo history
+ *
+ * Every edit goes through the history as splices on a PieceTable. The table
+ * is persistent, so a step is just the table's version before and after the
+ * edit (two root pointers): undo/redo restore() a version and publish() it,
+ * O(1) whatever the file length, and the frames a step keeps alive are only
+ * the ones its edits wrote. Several edits can be grouped into one step with
+ * begin()/end().
+ *
+ * Audio plays and analyses getTable() once attached with Audio::attachHistory();
+ * pass every returned Range to Audio::historyChanged().
+*/
+class History{
+  public:
+  // What an edit/undo/redo changed: old frames [start,oldEnd) are now [start,newEnd)
+  struct Range{
+    uint64_t start=UINT64_MAX;
+    uint64_t oldEnd=0;
+    uint64_t newEnd=0;
+    inline bool empty()const{return start==UINT64_MAX;}
+    inline bool resized()const{return !empty() && oldEnd!=newEnd;}
+  };
+
+  private:
+  struct Step{
+    std::string label;
+    PieceTable::Clip before,after;
+    Range range;
+    uint64_t written=0;   // frames the step's edits inserted
+  };
+
+  PieceTable table;
+  std::vector<Step>undoStack,redoStack;
+  Step open;
+  int depth=0;          // nested begin() calls
+  size_t maxSteps=0;    // 0 => unlimited
+
+  public:
+  History(){}
+  History(const std::vector<float>& data,int numChannels){assign(data,numChannels);}
+  History(const History&)=delete;
+  History& operator=(const History&)=delete;
+
+  // New document; drops all history
+  void assign(const std::vector<float>& data,int numChannels){
+    table.assign(data,numChannels);
+    table.publish();
+    clear();
+  }
+  void assign(PieceTable::Source source,int numChannels){
+    table.assign(source,numChannels);
+    table.publish();
+    clear();
+  }
+  void clear(){
+    undoStack.clear();
+    redoStack.clear();
+    open=Step{};
+    depth=0;
+    table.collect();
+  }
+  void setMaxSteps(size_t n){maxSteps=n;trim();}
+
+  inline PieceTable& getTable(){return table;}
+  inline const PieceTable& getTable()const{return table;}
+  inline uint64_t frames()const{return table.frames();}
+  inline int getChannels()const{return table.getChannels();}
+  inline size_t read(uint64_t frame,float *out,size_t count)const{return table.read(frame,out,count);}
+  inline bool canUndo()const{return !undoStack.empty();}
+  inline bool canRedo()const{return !redoStack.empty();}
+  inline size_t undoSteps()const{return undoStack.size();}
+  inline size_t redoSteps()const{return redoStack.size();}
+  inline const std::string& undoLabel()const{static const std::string none;return undoStack.empty()?none:undoStack.back().label;}
+  inline const std::string& redoLabel()const{static const std::string none;return redoStack.empty()?none:redoStack.back().label;}
+
+  // ---------------- Edits ----------------
+  void begin(const std::string& label){
+    if(depth++==0)open=Step{label,table.state(),{},{},0};
+  }
+  void end(){
+    if(depth==0 || --depth>0)return;
+    if(open.range.empty())return;
+    open.after=table.state();
+    undoStack.push_back(std::move(open));
+    open=Step{};
+    redoStack.clear();
+    trim();
+    table.publish();
+  }
+
+  Range splice(uint64_t startFrame,uint64_t eraseFrames,const float *in,uint64_t insertFrames,const std::string& label="Edit"){
+    const int ch=getChannels();
+    if(ch<=0)return {};
+    startFrame=std::min(startFrame,frames());
+    eraseFrames=std::min(eraseFrames,frames()-startFrame);
+    if(eraseFrames==0 && insertFrames==0)return {};
+    begin(label);
+    table.erase(startFrame,startFrame+eraseFrames);
+    if(insertFrames)table.insert(startFrame,std::vector<float>(in,in+insertFrames*ch));
+    const Range r{startFrame,startFrame+eraseFrames,startFrame+insertFrames};
+    open.range=compose(open.range,r);
+    open.written+=insertFrames;
+    end();
+    return r;
+  }
+
+  Range write(uint64_t startFrame,const std::vector<float>& data,const std::string& label="Write"){
+    const uint64_t n=getChannels()>0?data.size()/getChannels():0;
+    return splice(startFrame,n,data.data(),n,label);
+  }
+  Range insert(uint64_t startFrame,const std::vector<float>& data,const std::string& label="Insert"){
+    const uint64_t n=getChannels()>0?data.size()/getChannels():0;
+    return splice(startFrame,0,data.data(),n,label);
+  }
+  Range erase(uint64_t startFrame,uint64_t endFrame,const std::string& label="Delete"){
+    return splice(startFrame,endFrame>startFrame?endFrame-startFrame:0,nullptr,0,label);
+  }
+
+  // Read-modify-write of [startFrame,endFrame) through fn(float *interleaved,size_t frames)
+  template<typename Fn>
+  Range process(uint64_t startFrame,uint64_t endFrame,Fn fn,const std::string& label="Process"){
+    endFrame=std::min(endFrame,frames());
+    if(startFrame>=endFrame)return {};
+    std::vector<float>data(static_cast<size_t>((endFrame-startFrame)*getChannels()));
+    table.read(startFrame,data.data(),static_cast<size_t>(endFrame-startFrame));
+    fn(data.data(),static_cast<size_t>(endFrame-startFrame));
+    return write(startFrame,data,label);
+  }
+
+  // ---------------- Undo / redo ----------------
+  Range undo(){
+    if(undoStack.empty() || depth>0)return {};
+    Step step=std::move(undoStack.back());
+    undoStack.pop_back();
+    table.restore(step.before);
+    table.publish();
+    const Range r{step.range.start,step.range.newEnd,step.range.oldEnd};
+    redoStack.push_back(std::move(step));
+    return r;
+  }
+
+  Range redo(){
+    if(redoStack.empty() || depth>0)return {};
+    Step step=std::move(redoStack.back());
+    redoStack.pop_back();
+    table.restore(step.after);
+    table.publish();
+    const Range r=step.range;
+    undoStack.push_back(std::move(step));
+    return r;
+  }
+
+  // Frames the undo/redo steps wrote; an upper bound on what only the history keeps alive
+  uint64_t historyFrames()const{
+    uint64_t total=0;
+    for(const std::vector<Step>* stack:{&undoStack,&redoStack}){
+      for(const Step& step:*stack)total+=step.written;
+    }
+    return total;
+  }
+  inline size_t historyBytes()const{return static_cast<size_t>(historyFrames()*getChannels()*sizeof(float));}
+
+  private:
+  void trim(){
+    if(maxSteps && undoStack.size()>maxSteps)undoStack.erase(undoStack.begin(),undoStack.end()-maxSteps);
+    table.collect();
+  }
+
+  // a then b (b in the frame positions after a) as one range
+  static Range compose(const Range& a,const Range& b){
+    if(a.empty())return b;
+    if(b.empty())return a;
+    const uint64_t mid=std::max(a.newEnd,b.oldEnd);  // past this, neither edit touched anything
+    return {std::min(a.start,b.start),mid-(a.newEnd-a.oldEnd),mid+(b.newEnd-b.oldEnd)};
+  }
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <sndfile.hh>
+
+/*
+ * File I/O helpers
+ *
+ * One policy for every reader and writer: an interrupted call (EINTR) is
+ * retried, a short transfer carries on from where it stopped, and only end
+ * of file, an error or a device that takes nothing ends the loop.
+*/
+
+// Bytes read; fewer than asked only at end of file or on an error
+inline size_t preadAll(int fd,void *dst,size_t bytes,uint64_t at){
+  size_t done=0;
+  while(done<bytes){
+    const ssize_t n=::pread(fd,static_cast<uint8_t*>(dst)+done,bytes-done,static_cast<off_t>(at+done));
+    if(n<0 && errno==EINTR)continue;
+    if(n<=0)break;
+    done+=static_cast<size_t>(n);
+  }
+  return done;
+}
+
+// All bytes written, or false
+inline bool pwriteAll(int fd,const void *src,size_t bytes,uint64_t at){
+  size_t done=0;
+  while(done<bytes){
+    const ssize_t n=::pwrite(fd,static_cast<const uint8_t*>(src)+done,bytes-done,static_cast<off_t>(at+done));
+    if(n<0 && errno==EINTR)continue;
+    if(n<=0)return false;
+    done+=static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// libsndfile open for reading; reports the error and returns nullptr on failure
+inline SNDFILE* openSoundFile(const std::string& path,SF_INFO& info){
+  info=SF_INFO{};
+  SNDFILE *file=sf_open(path.c_str(),SFM_READ,&info);
+  if(!file)std::cerr << "Error opening file: " << sf_strerror(NULL) << std::endl;
+  return file;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "lockfree.hpp"
+
+/*
+ * Real-time level meter
+ *
+ * The audio callback calls process() on every output block: one pass keeping
+ * a per-channel running max |x| and sum of squares, then a triple buffer
+ * publish. The peak restarts only after the UI has taken a snapshot, so no
+ * transient is missed however slowly the UI polls. Energy is published as a
+ * running total and read() turns it into the RMS since the previous read, so
+ * a read racing a block never counts frames twice. Neither side ever blocks.
+*/
+class LevelMeter{
+  public:
+  static constexpr int MAX_CHANNELS=8;
+
+  struct Levels{
+    int channels=0;
+    uint64_t frames=0;             // frames since the previous read
+    float peak[MAX_CHANNELS]{};    // linear, max |x|
+    float rms[MAX_CHANNELS]{};     // linear, since the previous read
+    bool clipped[MAX_CHANNELS]{};  // reached full scale
+  };
+
+  private:
+  struct Snapshot{
+    int channels=0;
+    uint64_t totalFrames=0;
+    double energy[MAX_CHANNELS]{}; // running sum of squares
+    float peak[MAX_CHANNELS]{};
+  };
+
+  TripleBuffer<Snapshot>buffer;
+  // audio thread only
+  float peak[MAX_CHANNELS]{};
+  double energy[MAX_CHANNELS]{};
+  uint64_t totalFrames=0;
+  bool dirty=false;
+  // UI thread only
+  double readEnergy[MAX_CHANNELS]{};
+  uint64_t readFrames=0;
+
+  public:
+  LevelMeter(){}
+  LevelMeter(const LevelMeter&)=delete;
+  LevelMeter& operator=(const LevelMeter&)=delete;
+
+  // Audio thread: no locks, no allocation
+  void process(const float *in,unsigned long count,int channels){
+    channels=std::min(channels,MAX_CHANNELS);
+    if(channels<=0)return;
+    if(dirty && buffer.consumed()){
+      std::fill(peak,peak+MAX_CHANNELS,0.0f);
+      dirty=false;
+    }
+
+    if(channels==2){
+      float p0=peak[0],p1=peak[1],s0=0.0f,s1=0.0f;
+      for(unsigned long i=0;i<count;++i){
+        const float l=in[2*i],r=in[2*i+1];
+        p0=std::max(p0,std::fabs(l));
+        p1=std::max(p1,std::fabs(r));
+        s0+=l*l;
+        s1+=r*r;
+      }
+      peak[0]=p0;peak[1]=p1;
+      energy[0]+=s0;energy[1]+=s1;
+    }else{
+      for(int c=0;c<channels;++c){
+        float p=peak[c],s=0.0f;
+        for(unsigned long i=0;i<count;++i){
+          const float v=in[i*channels+c];
+          p=std::max(p,std::fabs(v));
+          s+=v*v;
+        }
+        peak[c]=p;
+        energy[c]+=s;
+      }
+    }
+    totalFrames+=count;
+
+    Snapshot& out=buffer.writeBuffer();
+    out.channels=channels;
+    out.totalFrames=totalFrames;
+    std::copy(peak,peak+channels,out.peak);
+    std::copy(energy,energy+channels,out.energy);
+    buffer.publish();
+    dirty=true;
+  }
+
+  // UI thread: levels since the previous read, false when nothing new arrived
+  bool read(Levels& out){
+    if(!buffer.update())return false;
+    const Snapshot& in=buffer.read();
+    out.channels=in.channels;
+    out.frames=in.totalFrames-readFrames;
+    const double inv=out.frames?1.0/static_cast<double>(out.frames):0.0;
+    for(int c=0;c<in.channels;++c){
+      out.peak[c]=in.peak[c];
+      out.rms[c]=static_cast<float>(std::sqrt(std::max(0.0,in.energy[c]-readEnergy[c])*inv));
+      out.clipped[c]=in.peak[c]>=0.999f;
+      readEnergy[c]=in.energy[c];
+    }
+    readFrames=in.totalFrames;
+    return true;
+  }
+
+  static inline float toDB(float linear){return linear>1e-10f?20.0f*std::log10(linear):-200.0f;}
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Lock-free single producer / single consumer ring
+ *
+ * Fixed capacity (rounded up to a power of two), allocated once. Push and pop
+ * never block or allocate, so either side may be the audio callback.
+*/
+template<typename T> class SpscQueue{
+  private:
+  std::vector<T>buffer;
+  size_t mask=0;
+  alignas(64) std::atomic<size_t>head{0}; // next slot to read (consumer)
+  alignas(64) std::atomic<size_t>tail{0}; // next slot to write (producer)
+
+  public:
+  explicit SpscQueue(size_t capacity=1024){
+    size_t n=1;
+    while(n<capacity)n<<=1;
+    buffer.resize(n);
+    mask=n-1;
+  }
+
+  SpscQueue(const SpscQueue&)=delete;
+  SpscQueue& operator=(const SpscQueue&)=delete;
+
+  // Producer side, returns false when full
+  bool push(const T& value){
+    const size_t t=tail.load(std::memory_order_relaxed);
+    if(t-head.load(std::memory_order_acquire)>mask)return false;
+    buffer[t & mask]=value;
+    tail.store(t+1,std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false when empty
+  bool pop(T& value){
+    const size_t h=head.load(std::memory_order_relaxed);
+    if(h==tail.load(std::memory_order_acquire))return false;
+    value=buffer[h & mask];
+    head.store(h+1,std::memory_order_release);
+    return true;
+  }
+
+  inline size_t size()const{return tail.load(std::memory_order_acquire)-head.load(std::memory_order_acquire);}
+  inline bool empty()const{return size()==0;}
+  inline size_t capacity()const{return mask+1;}
+};
+
+/*
+ * Lock-free triple buffer
+ *
+ * Hands the latest value from one writer to one reader without either side
+ * ever waiting: the writer fills its private slot and swaps it with the
+ * shared middle slot, the reader swaps the middle with its own slot when a
+ * new value is there. Intermediate values are overwritten, never queued.
+*/
+template<typename T> class TripleBuffer{
+  private:
+  static constexpr uint8_t FRESH=0x4;   // middle slot holds an unread value
+  T slots[3]{};
+  alignas(64) std::atomic<uint8_t>middle{1};
+  alignas(64) uint8_t back=0;  // writer's slot
+  alignas(64) uint8_t front=2; // reader's slot
+
+  public:
+  TripleBuffer(){}
+  TripleBuffer(const TripleBuffer&)=delete;
+  TripleBuffer& operator=(const TripleBuffer&)=delete;
+
+  // Writer side
+  inline T& writeBuffer(){return slots[back];}
+  void publish(){back=middle.exchange(back | FRESH,std::memory_order_acq_rel) & 0x3;}
+  // True once the reader has taken the last published value
+  inline bool consumed()const{return !(middle.load(std::memory_order_acquire) & FRESH);}
+
+  // Reader side, returns true when a newer value was picked up
+  bool update(){
+    if(!(middle.load(std::memory_order_relaxed) & FRESH))return false;
+    front=middle.exchange(front,std::memory_order_acq_rel) & 0x3;
+    return true;
+  }
+  inline const T& read()const{return slots[front];}
+};
+
+/*
+ * Lock-free snapshot publisher
+ *
+ * One writer publishes immutable versions of T; one reader (the audio
+ * callback) pins the latest for the length of a block with acquire()/release().
+ * The reader announces the version it holds in a hazard slot, so the writer
+ * frees a replaced version only once the reader has moved off it. The reader
+ * never locks, allocates or touches a reference count.
+*/
+template<typename T> class SnapshotPublisher{
+  private:
+  std::atomic<const T*>current{nullptr};
+  std::atomic<const T*>hazard{nullptr};
+  std::shared_ptr<const T>live;                 // owns current
+  std::vector<std::shared_ptr<const T>>retired;
+
+  public:
+  SnapshotPublisher(){}
+  SnapshotPublisher(const SnapshotPublisher&)=delete;
+  SnapshotPublisher& operator=(const SnapshotPublisher&)=delete;
+
+  // Writer side; also frees what the reader has left
+  void publish(std::shared_ptr<const T>next){
+    current.store(next.get());
+    if(live)retired.push_back(std::move(live));
+    live=std::move(next);
+    collect();
+  }
+
+  void collect(){
+    const T *inUse=hazard.load();
+    retired.erase(std::remove_if(retired.begin(),retired.end(),[inUse](const std::shared_ptr<const T>& s){return s.get()!=inUse;}),retired.end());
+  }
+
+  inline const std::shared_ptr<const T>& latest()const{return live;}
+
+  // Reader side: pin the published version for one block, then release()
+  const T* acquire(){
+    const T *s;
+    do{
+      s=current.load();
+      hazard.store(s);
+    }while(s!=current.load()); // re-check so the writer cannot have missed the hazard
+    return s;
+  }
+  inline void release(){hazard.store(nullptr);}
+};
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sndfile.hh>
+
+#include "io.hpp"
+#include "parallel.hpp"
+
+// Loudness figures per EBU R128 / ITU-R BS.1770
+struct LoudnessStats{
+  double integratedLUFS=-HUGE_VAL;
+  double loudnessRangeLU=0.0;
+  double maxMomentaryLUFS=-HUGE_VAL;
+  double maxShortTermLUFS=-HUGE_VAL;
+  double truePeakDBTP=-HUGE_VAL;
+  bool valid=false;
+};
+
+/*
+ * Streaming loudness meter
+ *
+ * K-weighting (two biquads per channel), 100 ms energy sub-blocks combined
+ * into 400 ms momentary and 3 s short-term windows, gated integrated loudness
+ * and loudness range from fixed 0.1 LU histograms (memory does not grow with
+ * length), and 4x oversampled true peak.
+ *
+ * process() is real-time safe. Momentary, short-term, integrated and true
+ * peak are also published through atomics every 100 ms, so a UI can read a
+ * meter that the audio thread is feeding.
+*/
+class LoudnessMeter{
+  public:
+  static constexpr int SUBBLOCKS_MOMENTARY=4;   // 400 ms
+  static constexpr int SUBBLOCKS_SHORT_TERM=30; // 3 s
+  static constexpr double HIST_MIN=-70.0;
+  static constexpr double HIST_MAX=10.0;
+  static constexpr double HIST_STEP=0.1;
+  static constexpr int HIST_BINS=static_cast<int>((HIST_MAX-HIST_MIN)/HIST_STEP);
+  static constexpr int TP_PHASES=4;
+  static constexpr int TP_TAPS=12;              // per phase
+
+  private:
+  struct Biquad{
+    double b0=1,b1=0,b2=0,a1=0,a2=0;
+  };
+  struct ChannelState{
+    double z1a=0,z2a=0,z1b=0,z2b=0; // transposed direct form II state of both stages
+    float history[TP_TAPS]{};
+    float truePeak=0.0f;
+  };
+  struct Histogram{
+    std::vector<double>energy;
+    std::vector<uint64_t>count;
+    void reset(){energy.assign(HIST_BINS,0.0);count.assign(HIST_BINS,0);}
+    void add(double e){
+      const double l=toLUFS(e);
+      if(l<HIST_MIN)return;
+      const int bin=std::min(HIST_BINS-1,static_cast<int>((l-HIST_MIN)/HIST_STEP));
+      energy[bin]+=e;
+      ++count[bin];
+    }
+  };
+
+  int channels=0;
+  uint32_t sampleRate=0;
+  Biquad shelf,highPass;
+  std::vector<double>weights;
+  std::vector<ChannelState>state;
+  float tpCoeffs[TP_PHASES][TP_TAPS]{};
+
+  uint64_t subblockFrames=0;
+  uint64_t subblockPos=0;
+  double subblockSum=0.0;                 // weighted sum of squares in the current sub-block
+  std::vector<double>ring;                // last SUBBLOCKS_SHORT_TERM sub-block energies
+  uint64_t subblocks=0;
+  Histogram blocks400,shortTerms;
+  double maxMomentary=-HUGE_VAL,maxShortTerm=-HUGE_VAL;
+
+  std::atomic<float>momentaryOut{-HUGE_VALF};
+  std::atomic<float>shortTermOut{-HUGE_VALF};
+  std::atomic<float>integratedOut{-HUGE_VALF};
+  std::atomic<float>truePeakOut{0.0f};
+
+  public:
+  LoudnessMeter(int numChannels=2,uint32_t rate=48000){configure(numChannels,rate);}
+
+  LoudnessMeter(const LoudnessMeter&)=delete;
+  LoudnessMeter& operator=(const LoudnessMeter&)=delete;
+
+  // Not real-time safe (allocates)
+  void configure(int numChannels,uint32_t rate){
+    channels=std::max(1,numChannels);
+    sampleRate=std::max(1u,rate);
+    designKWeighting();
+    designTruePeak();
+    // BS.1770 weights: 1.0 front, 1.41 surround, LFE (4th of 5.1) ignored
+    weights.assign(channels,1.0);
+    if(channels==6){weights[3]=0.0;weights[4]=weights[5]=1.41;}
+    state.assign(channels,ChannelState{});
+    ring.assign(SUBBLOCKS_SHORT_TERM,0.0);
+    subblockFrames=std::max<uint64_t>(1,sampleRate/10);
+    blocks400.reset();
+    shortTerms.reset();
+    reset();
+  }
+
+  void reset(){
+    for(ChannelState& s:state)s=ChannelState{};
+    std::fill(ring.begin(),ring.end(),0.0);
+    blocks400.reset();
+    shortTerms.reset();
+    subblockPos=0;
+    subblockSum=0.0;
+    subblocks=0;
+    maxMomentary=maxShortTerm=-HUGE_VAL;
+    momentaryOut.store(-HUGE_VALF);
+    shortTermOut.store(-HUGE_VALF);
+    integratedOut.store(-HUGE_VALF);
+    truePeakOut.store(0.0f);
+  }
+
+  inline int getChannels()const{return channels;}
+  inline uint32_t getSampleRate()const{return sampleRate;}
+
+  // Interleaved input, any block size
+  void process(const float *in,size_t frames){
+    while(frames>0){
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(frames,subblockFrames-subblockPos));
+      for(int c=0;c<channels;++c){
+        if(weights[c]!=0.0)subblockSum+=weights[c]*filterChannel(in,n,c);
+        truePeakChannel(in,n,c);
+      }
+      in+=n*channels;
+      frames-=n;
+      subblockPos+=n;
+      if(subblockPos==subblockFrames)endSubblock();
+    }
+  }
+
+  // ---- Results (owner thread) ----
+  double momentary()const{return toLUFS(windowEnergy(SUBBLOCKS_MOMENTARY));}
+  double shortTerm()const{return toLUFS(windowEnergy(SUBBLOCKS_SHORT_TERM));}
+
+  double integrated()const{
+    // absolute gate -70 LUFS, then relative gate 10 LU below the result
+    double e=0.0;uint64_t n=0;
+    for(int b=0;b<HIST_BINS;++b){e+=blocks400.energy[b];n+=blocks400.count[b];}
+    if(n==0)return -HUGE_VAL;
+    const double gate=toLUFS(e/n)-10.0;
+    e=0.0;n=0;
+    for(int b=binOf(gate);b<HIST_BINS;++b){e+=blocks400.energy[b];n+=blocks400.count[b];}
+    return n?toLUFS(e/n):-HUGE_VAL;
+  }
+
+  double loudnessRange()const{
+    // EBU Tech 3342: short-term values, relative gate -20 LU, 10th..95th percentile
+    double e=0.0;uint64_t n=0;
+    for(int b=0;b<HIST_BINS;++b){e+=shortTerms.energy[b];n+=shortTerms.count[b];}
+    if(n==0)return 0.0;
+    const int first=binOf(toLUFS(e/n)-20.0);
+    uint64_t total=0;
+    for(int b=first;b<HIST_BINS;++b)total+=shortTerms.count[b];
+    if(total==0)return 0.0;
+    const uint64_t lo=static_cast<uint64_t>(total*0.10),hi=static_cast<uint64_t>(total*0.95);
+    double low=0.0,high=0.0;
+    uint64_t seen=0;
+    bool haveLow=false;
+    for(int b=first;b<HIST_BINS;++b){
+      seen+=shortTerms.count[b];
+      if(!haveLow && seen>lo){low=binLUFS(b);haveLow=true;}
+      if(seen>hi){high=binLUFS(b);break;}
+    }
+    return std::max(0.0,high-low);
+  }
+
+  // Linear true peak over all channels
+  float truePeak()const{
+    float p=0.0f;
+    for(const ChannelState& s:state)p=std::max(p,s.truePeak);
+    return p;
+  }
+  double truePeakDB()const{const float p=truePeak();return p>0.0f?20.0*std::log10(p):-HUGE_VAL;}
+
+  inline double getMaxMomentary()const{return maxMomentary;}
+  inline double getMaxShortTerm()const{return maxShortTerm;}
+
+  LoudnessStats stats()const{
+    LoudnessStats s;
+    s.integratedLUFS=integrated();
+    s.loudnessRangeLU=loudnessRange();
+    s.maxMomentaryLUFS=maxMomentary;
+    s.maxShortTermLUFS=maxShortTerm;
+    s.truePeakDBTP=truePeakDB();
+    s.valid=true;
+    return s;
+  }
+
+  // ---- Published values (any thread) ----
+  inline float publishedMomentary()const{return momentaryOut.load(std::memory_order_relaxed);}
+  inline float publishedShortTerm()const{return shortTermOut.load(std::memory_order_relaxed);}
+  inline float publishedIntegrated()const{return integratedOut.load(std::memory_order_relaxed);}
+  inline float publishedTruePeak()const{return truePeakOut.load(std::memory_order_relaxed);}
+
+  // ---- Whole buffers and files ----
+  static LoudnessStats measure(const std::vector<float>& interleaved,int channels,uint32_t sampleRate){
+    LoudnessMeter meter(channels,sampleRate);
+    meter.process(interleaved.data(),interleaved.size()/std::max(channels,1));
+    return meter.stats();
+  }
+
+  // One streaming pass over a file, without decoding it all to memory
+  static bool measureFile(const std::string& path,LoudnessStats& out){
+    SF_INFO info;
+    SNDFILE *file=openSoundFile(path,info);
+    if(!file)return false;
+    LoudnessMeter meter(info.channels,static_cast<uint32_t>(info.samplerate));
+    const sf_count_t chunk=65536;
+    std::vector<float>buffer(chunk*info.channels);
+    sf_count_t got;
+    while((got=sf_readf_float(file,buffer.data(),chunk))>0)meter.process(buffer.data(),static_cast<size_t>(got));
+    sf_close(file);
+    out=meter.stats();
+    return true;
+  }
+
+  // Batch measurement across cores
+  static std::vector<LoudnessStats>measureFiles(const std::vector<std::string>& paths,size_t threads=0){
+    std::vector<LoudnessStats>results(paths.size());
+    parallelForEach(paths.size(),[&](size_t i){measureFile(paths[i],results[i]);},threads);
+    return results;
+  }
+
+  static double toLUFS(double energy){return energy>0.0?-0.691+10.0*std::log10(energy):-HUGE_VAL;}
+
+  private:
+  static int binOf(double lufs){
+    if(lufs<=HIST_MIN)return 0;
+    return std::min(HIST_BINS-1,static_cast<int>((lufs-HIST_MIN)/HIST_STEP));
+  }
+  static double binLUFS(int bin){return HIST_MIN+(bin+0.5)*HIST_STEP;}
+
+  // Mean energy of the last count sub-blocks (what is available at the start)
+  double windowEnergy(int count)const{
+    const uint64_t have=std::min<uint64_t>(subblocks,count);
+    if(have==0)return 0.0;
+    double e=0.0;
+    for(uint64_t k=0;k<have;++k)e+=ring[(subblocks-1-k)%SUBBLOCKS_SHORT_TERM];
+    return e/have;
+  }
+
+  void endSubblock(){
+    ring[subblocks%SUBBLOCKS_SHORT_TERM]=subblockSum/static_cast<double>(subblockFrames);
+    ++subblocks;
+    subblockSum=0.0;
+    subblockPos=0;
+
+    if(subblocks>=SUBBLOCKS_MOMENTARY){
+      const double e=windowEnergy(SUBBLOCKS_MOMENTARY);
+      blocks400.add(e);
+      maxMomentary=std::max(maxMomentary,toLUFS(e));
+      momentaryOut.store(static_cast<float>(toLUFS(e)),std::memory_order_relaxed);
+    }
+    if(subblocks>=SUBBLOCKS_SHORT_TERM){
+      const double e=windowEnergy(SUBBLOCKS_SHORT_TERM);
+      shortTerms.add(e);
+      maxShortTerm=std::max(maxShortTerm,toLUFS(e));
+      shortTermOut.store(static_cast<float>(toLUFS(e)),std::memory_order_relaxed);
+    }
+    // once per second is plenty for the display
+    if(subblocks%10==0)integratedOut.store(static_cast<float>(integrated()),std::memory_order_relaxed);
+    truePeakOut.store(truePeak(),std::memory_order_relaxed);
+  }
+
+  // K-weight one channel of a block, returns its sum of squares
+  double filterChannel(const float *in,size_t n,int c){
+    ChannelState& s=state[c];
+    const Biquad &p=shelf,&q=highPass;
+    double z1a=s.z1a,z2a=s.z2a,z1b=s.z1b,z2b=s.z2b,sum=0.0;
+    for(size_t i=0;i<n;++i){
+      const double x=in[i*channels+c];
+      const double y=p.b0*x+z1a;
+      z1a=p.b1*x-p.a1*y+z2a;
+      z2a=p.b2*x-p.a2*y;
+      const double k=q.b0*y+z1b;
+      z1b=q.b1*y-q.a1*k+z2b;
+      z2b=q.b2*y-q.a2*k;
+      sum+=k*k;
+    }
+    s.z1a=z1a;s.z2a=z2a;s.z1b=z1b;s.z2b=z2b;
+    return sum;
+  }
+
+  void truePeakChannel(const float *in,size_t n,int c){
+    ChannelState& s=state[c];
+    float *h=s.history;
+    float peak=s.truePeak;
+    for(size_t i=0;i<n;++i){
+      // history[0] is the newest sample
+      for(int k=TP_TAPS-1;k>0;--k)h[k]=h[k-1];
+      h[0]=in[i*channels+c];
+      for(int p=0;p<TP_PHASES;++p){
+        float acc=0.0f;
+        for(int k=0;k<TP_TAPS;++k)acc+=tpCoeffs[p][k]*h[k];
+        peak=std::max(peak,std::fabs(acc));
+      }
+    }
+    s.truePeak=peak;
+  }
+
+  void designKWeighting(){
+    // Pre-filter (high shelf) and RLB high-pass, re-derived for any sample rate
+    const double fs=static_cast<double>(sampleRate);
+    {
+      const double f0=1681.974450955533,G=3.999843853973347,Q=0.7071752369554196;
+      const double K=std::tan(M_PI*f0/fs);
+      const double Vh=std::pow(10.0,G/20.0),Vb=std::pow(Vh,0.4996667741545416);
+      const double a0=1.0+K/Q+K*K;
+      shelf.b0=(Vh+Vb*K/Q+K*K)/a0;
+      shelf.b1=2.0*(K*K-Vh)/a0;
+      shelf.b2=(Vh-Vb*K/Q+K*K)/a0;
+      shelf.a1=2.0*(K*K-1.0)/a0;
+      shelf.a2=(1.0-K/Q+K*K)/a0;
+    }
+    {
+      const double f0=38.13547087602444,Q=0.5003270373238773;
+      const double K=std::tan(M_PI*f0/fs);
+      const double a0=1.0+K/Q+K*K;
+      highPass.b0=1.0;highPass.b1=-2.0;highPass.b2=1.0;
+      highPass.a1=2.0*(K*K-1.0)/a0;
+      highPass.a2=(1.0-K/Q+K*K)/a0;
+    }
+  }
+
+  void designTruePeak(){
+    // 48-tap windowed-sinc interpolator split into 4 polyphase branches
+    const int taps=TP_PHASES*TP_TAPS;
+    const double center=(taps-1)*0.5;
+    for(int t=0;t<taps;++t){
+      const double x=(t-center)/TP_PHASES;
+      const double sinc=x==0.0?1.0:std::sin(M_PI*x)/(M_PI*x);
+      const double w=2.0*M_PI*t/(taps-1);
+      const double win=0.35875-0.48829*std::cos(w)+0.14128*std::cos(2*w)-0.01168*std::cos(3*w); // Blackman-Harris
+      tpCoeffs[t%TP_PHASES][t/TP_PHASES]=static_cast<float>(sinc*win);
+    }
+    // unity DC gain per phase
+    for(int p=0;p<TP_PHASES;++p){
+      float sum=0.0f;
+      for(int k=0;k<TP_TAPS;++k)sum+=tpCoeffs[p][k];
+      if(sum!=0.0f)for(int k=0;k<TP_TAPS;++k)tpCoeffs[p][k]/=sum;
+    }
+  }
+};
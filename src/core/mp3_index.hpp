@@ -0,0 +1,504 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sndfile.hh>
+
+#include "io.hpp"
+
+/*
+ * MP3 frame index
+ *
+ * Skips ID3v2 (and an ID3v1 tail), then walks the MPEG frame headers reading
+ * the file in large blocks, recording the byte offset of every audio frame.
+ * Every frame holds the same number of samples, so sample -> frame -> offset
+ * is a division and a lookup. The Xing/Info (with the LAME gapless delay and
+ * padding) or VBRI tag in the first frame is parsed too; without a full scan
+ * its table of contents gives an approximate offset.
+ *
+ * Scans are cached on disk keyed by path, size and mtime, so reopening a long
+ * file costs one small read.
+*/
+class Mp3Index{
+  public:
+  static constexpr int PREROLL=3;            // frames decoded ahead of a seek target (bit reservoir + overlap)
+  static constexpr size_t SCAN_BLOCK=1<<20;
+  static constexpr uint32_t CACHE_MAGIC=0x494D5A53; // "SZMI"
+  static constexpr uint32_t CACHE_VERSION=2;
+
+  struct Header{
+    int version=0;            // 1, 2, or 25 (MPEG 2.5)
+    int layer=0;
+    uint32_t bitrate=0;       // bits per second
+    uint32_t sampleRate=0;
+    int channels=0;
+    int samplesPerFrame=0;
+    size_t frameBytes=0;
+  };
+
+  // Where a streaming decoder has to start to produce a given sample
+  struct Seek{
+    uint64_t offset=0;        // byte offset of the first frame to feed
+    uint64_t frame=0;         // its index among the audio frames
+    uint64_t skip=0;          // decoded samples to drop before the target
+    bool exact=true;          // false when estimated from a TOC
+  };
+
+  private:
+  uint64_t fileSize=0;
+  int64_t fileTime=0;
+  uint64_t audioStart=0;      // first audio frame (after the tag frame)
+  uint64_t audioEnd=0;
+  uint32_t sampleRate=0;
+  int channels=0;
+  int samplesPerFrame=0;
+  uint64_t delay=0;           // encoder + decoder delay trimmed at the start
+  uint64_t padding=0;         // trimmed at the end
+  uint64_t tagFrames=0;       // frame count from Xing/VBRI, 0 if none
+  bool variable=false;
+  std::vector<uint64_t>offsets;
+
+  // Xing: 100 percent -> 1/256 file position entries; VBRI: byte offsets every vbriStep frames
+  std::vector<uint8_t>xingToc;
+  std::vector<uint64_t>vbriToc;
+  uint64_t vbriStep=0;
+
+  public:
+  inline bool empty()const{return samplesPerFrame==0;}
+  inline bool isScanned()const{return !offsets.empty();}
+  inline uint32_t getSampleRate()const{return sampleRate;}
+  inline int getChannels()const{return channels;}
+  inline int getSamplesPerFrame()const{return samplesPerFrame;}
+  inline bool isVBR()const{return variable;}
+  inline uint64_t frameCount()const{return isScanned()?offsets.size():tagFrames;}
+  inline uint64_t getDelay()const{return delay;}
+  inline uint64_t getAudioStart()const{return audioStart;}
+  inline uint64_t getAudioEnd()const{return audioEnd;}
+
+  // Playable sample frames, gapless trim applied
+  uint64_t frames()const{
+    const uint64_t raw=frameCount()*samplesPerFrame;
+    return raw>delay+padding?raw-delay-padding:0;
+  }
+  uint32_t averageBitrate()const{
+    const double seconds=sampleRate?static_cast<double>(frameCount()*samplesPerFrame)/sampleRate:0.0;
+    return seconds>0.0?static_cast<uint32_t>((audioEnd-audioStart)*8/seconds/1000.0):0;
+  }
+
+  // Parse the file; scan=false stops after the tag frame (TOC seeking only)
+  bool open(const std::string& path,bool scan=true){
+    *this=Mp3Index{};
+    const int fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0)return false;
+    struct stat st;
+    const bool ok=fstat(fd,&st)==0 && parse(fd,static_cast<uint64_t>(st.st_size),static_cast<int64_t>(st.st_mtime),scan);
+    ::close(fd);
+    if(!ok)*this=Mp3Index{};
+    return ok;
+  }
+
+  // open() through the on-disk cache
+  bool openCached(const std::string& path){
+    const std::string cache=cachePath(path);
+    struct stat st;
+    if(stat(path.c_str(),&st)!=0)return false;
+    if(load(cache) && fileSize==static_cast<uint64_t>(st.st_size) && fileTime==static_cast<int64_t>(st.st_mtime))return true;
+    if(!open(path))return false;
+    save(cache);
+    return true;
+  }
+
+  Seek locate(uint64_t sample)const{
+    Seek s;
+    if(empty())return s;
+    const uint64_t raw=sample+delay;
+    const uint64_t target=raw/samplesPerFrame;
+    s.frame=target>=static_cast<uint64_t>(PREROLL)?target-PREROLL:0;
+    s.skip=raw-s.frame*samplesPerFrame;
+    if(isScanned()){
+      s.frame=std::min<uint64_t>(s.frame,offsets.size()-1);
+      s.skip=raw-s.frame*samplesPerFrame;
+      s.offset=offsets[s.frame];
+      return s;
+    }
+    s.exact=false;
+    const uint64_t bytes=audioEnd-audioStart;
+    const uint64_t total=std::max<uint64_t>(1,tagFrames);
+    if(!vbriToc.empty() && vbriStep){
+      const size_t i=std::min<size_t>(static_cast<size_t>(s.frame/vbriStep),vbriToc.size()-1);
+      s.frame=i*vbriStep;
+      s.skip=raw-s.frame*samplesPerFrame;
+      s.offset=audioStart+vbriToc[i];
+    }else if(xingToc.size()==100){
+      const double percent=std::min(99.999,100.0*s.frame/total);
+      const size_t i=static_cast<size_t>(percent);
+      const double a=xingToc[i],b=i<99?xingToc[i+1]:256.0;
+      s.offset=audioStart+static_cast<uint64_t>((a+(b-a)*(percent-i))/256.0*bytes);
+    }else{
+      s.offset=audioStart+static_cast<uint64_t>(static_cast<double>(s.frame)/total*bytes); // CBR
+    }
+    return s;
+  }
+
+  // 4 header bytes -> frame layout; false for anything that is not a valid layer I-III header
+  static bool parseHeader(const uint8_t *p,Header& h){
+    if(p[0]!=0xFF || (p[1]&0xE0)!=0xE0)return false;
+    const int versionBits=(p[1]>>3)&3,layerBits=(p[1]>>1)&3;
+    const int bitrateIndex=p[2]>>4,rateIndex=(p[2]>>2)&3,pad=(p[2]>>1)&1;
+    if(versionBits==1 || layerBits==0 || bitrateIndex==0 || bitrateIndex==15 || rateIndex==3)return false;
+    static const uint16_t bitrates[2][3][15]={
+      {{0,32,64,96,128,160,192,224,256,288,320,352,384,416,448},
+       {0,32,48,56,64,80,96,112,128,160,192,224,256,320,384},
+       {0,32,40,48,56,64,80,96,112,128,160,192,224,256,320}},
+      {{0,32,48,56,64,80,96,112,128,144,160,176,192,224,256},
+       {0,8,16,24,32,40,48,56,64,80,96,112,128,144,160},
+       {0,8,16,24,32,40,48,56,64,80,96,112,128,144,160}}
+    };
+    static const uint32_t rates[3]={44100,48000,32000};
+    h.version=versionBits==3?1:versionBits==2?2:25;
+    h.layer=4-layerBits;
+    const int v=h.version==1?0:1;
+    h.bitrate=bitrates[v][h.layer-1][bitrateIndex]*1000u;
+    h.sampleRate=rates[rateIndex]>>(h.version==1?0:h.version==2?1:2);
+    h.channels=(p[3]>>6)==3?1:2;
+    h.samplesPerFrame=h.layer==1?384:(h.layer==3 && h.version!=1)?576:1152;
+    h.frameBytes=h.layer==1?(12*h.bitrate/h.sampleRate+pad)*4:static_cast<size_t>(h.samplesPerFrame/8)*h.bitrate/h.sampleRate+pad;
+    return h.frameBytes>=4;
+  }
+
+  // ---------------- Cache ----------------
+  std::vector<uint8_t>serialize()const{
+    std::vector<uint8_t>out;
+    auto put=[&out](uint64_t v,int bytes){for(int i=0;i<bytes;++i)out.push_back(static_cast<uint8_t>(v>>(8*i)));};
+    put(CACHE_MAGIC,4);put(CACHE_VERSION,4);
+    put(fileSize,8);put(static_cast<uint64_t>(fileTime),8);
+    put(audioStart,8);put(audioEnd,8);
+    put(sampleRate,4);put(static_cast<uint64_t>(channels),4);put(static_cast<uint64_t>(samplesPerFrame),4);
+    put(delay,8);put(padding,8);put(tagFrames,8);put(variable,1);
+    put(offsets.size(),8);
+    // deltas as varints: one or two bytes per frame, and any gap a resync skipped still fits
+    for(size_t i=0;i<offsets.size();++i){
+      uint64_t delta=offsets[i]-(i?offsets[i-1]:audioStart);
+      for(;delta>=0x80;delta>>=7)out.push_back(static_cast<uint8_t>(delta|0x80));
+      out.push_back(static_cast<uint8_t>(delta));
+    }
+    return out;
+  }
+
+  bool deserialize(const std::vector<uint8_t>& in){
+    size_t at=0;
+    bool ok=true;
+    auto get=[&](int bytes){
+      uint64_t v=0;
+      if(at+bytes>in.size()){ok=false;return v;}
+      for(int i=0;i<bytes;++i)v|=static_cast<uint64_t>(in[at+i])<<(8*i);
+      at+=bytes;
+      return v;
+    };
+    if(get(4)!=CACHE_MAGIC || get(4)!=CACHE_VERSION)return false;
+    Mp3Index idx;
+    idx.fileSize=get(8);idx.fileTime=static_cast<int64_t>(get(8));
+    idx.audioStart=get(8);idx.audioEnd=get(8);
+    idx.sampleRate=static_cast<uint32_t>(get(4));idx.channels=static_cast<int>(get(4));idx.samplesPerFrame=static_cast<int>(get(4));
+    idx.delay=get(8);idx.padding=get(8);idx.tagFrames=get(8);idx.variable=get(1)!=0;
+    const uint64_t count=get(8);
+    if(!ok || count>in.size()-at || idx.samplesPerFrame<=0)return false;
+    idx.offsets.resize(static_cast<size_t>(count));
+    uint64_t offset=idx.audioStart;
+    for(uint64_t& o:idx.offsets){
+      uint64_t delta=0;
+      for(int shift=0;;shift+=7){
+        if(at>=in.size() || shift>63)return false;
+        const uint8_t b=in[at++];
+        delta|=static_cast<uint64_t>(b&0x7F)<<shift;
+        if(!(b&0x80))break;
+      }
+      offset+=delta;
+      o=offset;
+    }
+    if(!ok)return false;
+    *this=std::move(idx);
+    return ok;
+  }
+
+  static std::string cachePath(const std::string& path){
+    std::error_code ec;
+    const std::string full=std::filesystem::absolute(path,ec).string();
+    uint64_t h=1469598103934665603ull;
+    for(unsigned char c:full)h=(h^c)*1099511628211ull;
+    char name[40];
+    std::snprintf(name,sizeof(name),"%016llx.idx",static_cast<unsigned long long>(h));
+    return (std::filesystem::temp_directory_path(ec)/"sizzlefx-index"/name).string();
+  }
+
+  private:
+  static inline uint32_t be32(const uint8_t *p){return static_cast<uint32_t>(p[0])<<24|static_cast<uint32_t>(p[1])<<16|static_cast<uint32_t>(p[2])<<8|p[3];}
+  static inline uint16_t be16(const uint8_t *p){return static_cast<uint16_t>(p[0]<<8|p[1]);}
+
+  bool parse(int fd,uint64_t size,int64_t mtime,bool scan){
+    fileSize=size;
+    fileTime=mtime;
+    // ID3v2 tags (possibly several) in front, ID3v1 at the end
+    uint64_t start=0;
+    uint8_t head[10];
+    while(preadAll(fd,head,10,start)==10 && std::memcmp(head,"ID3",3)==0){
+      const uint64_t tagSize=(head[6]&0x7Fu)<<21|(head[7]&0x7Fu)<<14|(head[8]&0x7Fu)<<7|(head[9]&0x7Fu);
+      start+=10+tagSize+((head[5]&0x10)?10:0);
+    }
+    audioEnd=size;
+    if(size>=128 && preadAll(fd,head,3,size-128)==3 && std::memcmp(head,"TAG",3)==0)audioEnd=size-128;
+
+    // first frame: a header whose successor is a header too, so sync bytes in junk do not count
+    std::vector<uint8_t>buffer(SCAN_BLOCK);
+    Header first;
+    uint64_t at=start;
+    for(;;){
+      const size_t got=preadAll(fd,buffer.data(),buffer.size(),at);
+      if(got<4)return false;
+      size_t i=0;
+      for(;i+4<=got;++i){
+        if(!parseHeader(buffer.data()+i,first))continue;
+        Header next;
+        uint8_t h2[4];
+        if(at+i+first.frameBytes+4<=audioEnd && preadAll(fd,h2,4,at+i+first.frameBytes)==4 && parseHeader(h2,next) && next.sampleRate==first.sampleRate)break;
+        if(at+i+first.frameBytes==audioEnd)break; // single-frame file
+      }
+      if(i+4<=got){at+=i;break;}
+      if(at+got>=audioEnd || at-start>(16u<<20))return false;
+      at+=got-3;
+    }
+    sampleRate=first.sampleRate;
+    channels=first.channels;
+    samplesPerFrame=first.samplesPerFrame;
+    audioStart=at;
+
+    // Xing/Info/VBRI in the first frame describes the stream and is not audio
+    std::vector<uint8_t>frame(first.frameBytes);
+    if(preadAll(fd,frame.data(),frame.size(),at)==frame.size() && parseTagFrame(frame,first))audioStart=at+first.frameBytes;
+    return scan?walk(fd,buffer,first):true;
+  }
+
+  bool parseTagFrame(const std::vector<uint8_t>& f,const Header& h){
+    const size_t side=h.version==1?(h.channels==1?17:32):(h.channels==1?9:17);
+    const size_t x=4+side;
+    if(f.size()>=x+8 && (std::memcmp(f.data()+x,"Xing",4)==0 || std::memcmp(f.data()+x,"Info",4)==0)){
+      variable=std::memcmp(f.data()+x,"Xing",4)==0;
+      const uint32_t flags=be32(f.data()+x+4);
+      size_t p=x+8;
+      if((flags&1) && p+4<=f.size()){tagFrames=be32(f.data()+p);p+=4;}
+      if(flags&2)p+=4;
+      if((flags&4) && p+100<=f.size()){xingToc.assign(f.begin()+p,f.begin()+p+100);p+=100;}
+      if(flags&8)p+=4;
+      // LAME extension: encoder delay / padding (12 bits each) at +21
+      if(p+24<=f.size() && (std::memcmp(f.data()+p,"LAME",4)==0 || std::memcmp(f.data()+p,"Lavf",4)==0 || std::memcmp(f.data()+p,"Lavc",4)==0)){
+        const uint8_t *d=f.data()+p+21;
+        delay=(static_cast<uint64_t>(d[0])<<4|d[1]>>4)+529; // + the decoder's own delay
+        padding=static_cast<uint64_t>(d[1]&0x0F)<<8|d[2];
+        padding=padding>529?padding-529:0;
+      }
+      return true;
+    }
+    const size_t v=4+32;
+    if(f.size()>=v+26 && std::memcmp(f.data()+v,"VBRI",4)==0){
+      variable=true;
+      tagFrames=be32(f.data()+v+14);
+      const size_t entries=be16(f.data()+v+18),scale=be16(f.data()+v+20),entryBytes=be16(f.data()+v+22);
+      vbriStep=be16(f.data()+v+24);
+      uint64_t offset=0;
+      vbriToc.push_back(0);
+      for(size_t e=0;e<entries && v+26+(e+1)*entryBytes<=f.size() && entryBytes>=1 && entryBytes<=4;++e){
+        uint64_t n=0;
+        for(size_t b=0;b<entryBytes;++b)n=n<<8|f[v+26+e*entryBytes+b];
+        offset+=n*scale;
+        vbriToc.push_back(offset);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // Every frame header from audioStart to audioEnd, resyncing over damage. As
+  // in parse(), a header found after lost sync only counts when the next
+  // header follows it, so sync bytes inside damaged data are skipped.
+  bool walk(int fd,std::vector<uint8_t>& buffer,const Header& first){
+    offsets.reserve(tagFrames?static_cast<size_t>(tagFrames):static_cast<size_t>((audioEnd-audioStart)/std::max<size_t>(first.frameBytes,1)+1));
+    uint64_t blockStart=audioStart,pos=audioStart;
+    size_t got=0;
+    uint32_t lastBitrate=0;
+    bool synced=true;
+    auto followed=[&](uint64_t next){
+      if(next==audioEnd)return true;
+      uint8_t h2[4];
+      Header h;
+      if(next+4>audioEnd)return false;
+      if(next>=blockStart && next+4<=blockStart+got)std::memcpy(h2,buffer.data()+(next-blockStart),4);
+      else if(preadAll(fd,h2,4,next)!=4)return false;
+      return parseHeader(h2,h) && h.sampleRate==sampleRate && h.samplesPerFrame==samplesPerFrame;
+    };
+    while(pos+4<=audioEnd){
+      if(pos<blockStart || pos+4>blockStart+got){
+        blockStart=pos;
+        got=preadAll(fd,buffer.data(),static_cast<size_t>(std::min<uint64_t>(buffer.size(),audioEnd-pos)),pos);
+        if(got<4)break;
+      }
+      Header h;
+      if(parseHeader(buffer.data()+(pos-blockStart),h) && h.sampleRate==sampleRate && h.samplesPerFrame==samplesPerFrame
+         && (synced || followed(pos+h.frameBytes))){
+        if(pos+h.frameBytes>audioEnd)break; // truncated last frame
+        synced=true;
+        offsets.push_back(pos);
+        if(lastBitrate && h.bitrate!=lastBitrate)variable=true;
+        lastBitrate=h.bitrate;
+        pos+=h.frameBytes;
+      }else{
+        synced=false; // lost sync: slide to the next confirmed header
+        ++pos;
+      }
+    }
+    return !offsets.empty();
+  }
+
+  bool load(const std::string& path){
+    std::ifstream file(path,std::ios::binary);
+    if(!file)return false;
+    std::vector<uint8_t>data((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+    return deserialize(data);
+  }
+
+  bool save(const std::string& path)const{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(),ec);
+    const std::string tmp=path+".tmp";
+    {
+      std::ofstream file(tmp,std::ios::binary | std::ios::trunc);
+      const std::vector<uint8_t>data=serialize();
+      if(!file.write(reinterpret_cast<const char*>(data.data()),data.size()))return false;
+    }
+    return std::rename(tmp.c_str(),path.c_str())==0;
+  }
+};
+
+/*
+ * Seekable MP3 stream
+ *
+ * Decoding goes through libsndfile, opened on a virtual file that starts at
+ * the frame Mp3Index::locate() picked a few frames before the target. A seek
+ * therefore costs reopening the decoder and decoding PREROLL frames, however
+ * far it jumps. Positions are in the same gapless sample frames a full
+ * libsndfile decode would produce.
+*/
+class Mp3Stream{
+  private:
+  Mp3Index index;
+  int fd=-1;
+  SNDFILE *file=nullptr;
+  SF_VIRTUAL_IO io{};
+  uint64_t windowStart=0;     // file offset presented as byte 0
+  uint64_t windowPos=0;       // virtual file position
+  uint64_t position=0;        // next sample frame read() returns
+  std::vector<float>scratch;
+
+  public:
+  Mp3Stream(){
+    io.get_filelen=[](void *self)->sf_count_t{
+      Mp3Stream *s=static_cast<Mp3Stream*>(self);
+      return static_cast<sf_count_t>(s->index.getAudioEnd()-s->windowStart);
+    };
+    io.seek=[](sf_count_t offset,int whence,void *self)->sf_count_t{
+      Mp3Stream *s=static_cast<Mp3Stream*>(self);
+      const int64_t length=static_cast<int64_t>(s->index.getAudioEnd()-s->windowStart);
+      int64_t to=whence==SEEK_SET?offset:whence==SEEK_CUR?static_cast<int64_t>(s->windowPos)+offset:length+offset;
+      s->windowPos=static_cast<uint64_t>(std::max<int64_t>(0,std::min(to,length)));
+      return static_cast<sf_count_t>(s->windowPos);
+    };
+    io.read=[](void *ptr,sf_count_t count,void *self)->sf_count_t{
+      Mp3Stream *s=static_cast<Mp3Stream*>(self);
+      const uint64_t at=s->windowStart+s->windowPos;
+      const uint64_t n=std::min<uint64_t>(static_cast<uint64_t>(std::max<sf_count_t>(count,0)),s->index.getAudioEnd()-std::min(at,s->index.getAudioEnd()));
+      const size_t got=preadAll(s->fd,ptr,static_cast<size_t>(n),at);
+      s->windowPos+=got;
+      return static_cast<sf_count_t>(got);
+    };
+    io.write=[](const void*,sf_count_t,void*)->sf_count_t{return 0;};
+    io.tell=[](void *self)->sf_count_t{return static_cast<sf_count_t>(static_cast<Mp3Stream*>(self)->windowPos);};
+  }
+  Mp3Stream(const Mp3Stream&)=delete;
+  Mp3Stream& operator=(const Mp3Stream&)=delete;
+  ~Mp3Stream(){close();}
+
+  bool open(const std::string& path){
+    close();
+    if(!index.openCached(path))return false;
+    fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0)return false;
+    return seek(0);
+  }
+
+  void close(){
+    if(file)sf_close(file);
+    file=nullptr;
+    if(fd>=0)::close(fd);
+    fd=-1;
+    position=0;
+  }
+
+  inline bool isOpen()const{return fd>=0;}
+  inline const Mp3Index& getIndex()const{return index;}
+  inline uint64_t frames()const{return index.frames();}
+  inline int getChannels()const{return index.getChannels();}
+  inline uint32_t getSampleRate()const{return index.getSampleRate();}
+  inline uint64_t tell()const{return position;}
+
+  bool seek(uint64_t frame){
+    if(fd<0)return false;
+    frame=std::min(frame,frames());
+    if(file && frame>=position && frame-position<=static_cast<uint64_t>(Mp3Index::PREROLL*index.getSamplesPerFrame())){
+      return discard(frame-position); // close ahead: decoding through is cheaper than reopening
+    }
+    if(file)sf_close(file);
+    const Mp3Index::Seek s=index.locate(frame);
+    windowStart=s.offset;
+    windowPos=0;
+    SF_INFO info{};
+    file=sf_open_virtual(&io,SFM_READ,&info,this);
+    if(!file){
+      std::cerr << "Error opening MP3 stream: " << sf_strerror(NULL) << std::endl;
+      return false;
+    }
+    position=frame;
+    return discard(s.skip);
+  }
+
+  size_t read(float *out,size_t count){
+    if(!file || position>=frames())return 0;
+    count=static_cast<size_t>(std::min<uint64_t>(count,frames()-position));
+    const sf_count_t got=sf_readf_float(file,out,static_cast<sf_count_t>(count));
+    const size_t n=got>0?static_cast<size_t>(got):0;
+    position+=n;
+    return n;
+  }
+
+  private:
+  bool discard(uint64_t count){
+    const size_t chunk=static_cast<size_t>(index.getSamplesPerFrame());
+    scratch.resize(chunk*index.getChannels());
+    while(count>0){
+      const sf_count_t want=static_cast<sf_count_t>(std::min<uint64_t>(count,chunk));
+      const sf_count_t got=sf_readf_float(file,scratch.data(),want);
+      if(got<=0)return false;
+      count-=static_cast<uint64_t>(got);
+    }
+    return true;
+  }
+};
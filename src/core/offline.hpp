@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "decoded_audio.hpp"
+#include "parallel.hpp"
+
+/*
+ * Offline whole-buffer processing
+ *
+ * Edits on a DecodedAudio buffer, split into frame ranges across cores.
+ * Reductions (peak, mean) are taken over fixed-size blocks and combined in
+ * block order, so results never depend on the thread count. Stateful filters
+ * produce exactly the samples a serial pass would.
+*/
+class OfflineProcessor{
+  public:
+  enum class FadeCurve:int{
+    Linear=0,
+    EqualPower=1
+  };
+
+  // Frames per reduction block, also the smallest range handed to a thread
+  static constexpr size_t BLOCK_FRAMES=1<<16;
+
+  struct Biquad{
+    double b0=1.0,b1=0.0,b2=0.0,a1=0.0,a2=0.0;
+  };
+
+  // Threads per operation, 0 => one per core; results are the same for any value
+  static inline size_t maxThreads=0;
+
+  // ---------------- Stateless ----------------
+  static void gain(DecodedAudio& audio,int channels,float g,uint64_t startFrame=0,uint64_t endFrame=UINT64_MAX){
+    if(!clampRange(audio,channels,startFrame,endFrame))return;
+    float *data=audio.samples.data()+startFrame*channels;
+    parallelRanges((endFrame-startFrame)*channels,BLOCK_FRAMES*channels,[data,g](size_t begin,size_t end){
+      for(size_t i=begin;i<end;++i)data[i]*=g;
+    },maxThreads);
+  }
+
+  // Largest absolute sample value
+  static float peak(const DecodedAudio& audio){
+    const size_t n=audio.samples.size();
+    const float *data=audio.samples.data();
+    const size_t blocks=(n+BLOCK_FRAMES-1)/BLOCK_FRAMES;
+    std::vector<float>partial(blocks,0.0f);
+    parallelRanges(blocks,1,[&](size_t begin,size_t end){
+      for(size_t b=begin;b<end;++b)partial[b]=peakOf(data+b*BLOCK_FRAMES,std::min(BLOCK_FRAMES,n-b*BLOCK_FRAMES));
+    },maxThreads);
+    float m=0.0f;
+    for(float p:partial)m=std::max(m,p);
+    return m;
+  }
+
+  // Scale so the peak hits targetPeak (linear), returns the gain applied
+  static float normalize(DecodedAudio& audio,int channels,float targetPeak=1.0f){
+    const float p=peak(audio);
+    if(p<=0.0f)return 1.0f;
+    const float g=targetPeak/p;
+    gain(audio,channels,g);
+    return g;
+  }
+
+  static void fadeIn(DecodedAudio& audio,int channels,uint64_t frames,FadeCurve curve=FadeCurve::Linear){
+    fade(audio,channels,0,frames,false,curve);
+  }
+
+  static void fadeOut(DecodedAudio& audio,int channels,uint64_t frames,FadeCurve curve=FadeCurve::Linear){
+    const uint64_t total=audio.samples.size()/std::max(channels,1);
+    frames=std::min(frames,total);
+    fade(audio,channels,total-frames,frames,true,curve);
+  }
+
+  // Reverse frame order, channels stay in place within each frame
+  static void reverse(DecodedAudio& audio,int channels){
+    if(channels<=0)return;
+    const size_t frames=audio.samples.size()/channels;
+    float *data=audio.samples.data();
+    parallelRanges(frames/2,BLOCK_FRAMES,[data,frames,channels](size_t begin,size_t end){
+      for(size_t f=begin;f<end;++f){
+        float *a=data+f*channels,*b=data+(frames-1-f)*channels;
+        for(int c=0;c<channels;++c)std::swap(a[c],b[c]);
+      }
+    },maxThreads);
+  }
+
+  // Subtract each channel's mean, returns the offsets removed
+  static std::vector<double>removeDC(DecodedAudio& audio,int channels){
+    std::vector<double>mean=channelMeans(audio,channels);
+    if(mean.empty())return mean;
+    std::vector<float>offset(mean.begin(),mean.end());
+    float *data=audio.samples.data();
+    const size_t frames=audio.samples.size()/channels;
+    parallelRanges(frames,BLOCK_FRAMES,[data,channels,&offset](size_t begin,size_t end){
+      for(size_t f=begin;f<end;++f)for(int c=0;c<channels;++c)data[f*channels+c]-=offset[c];
+    },maxThreads);
+    return mean;
+  }
+
+  static std::vector<double>channelMeans(const DecodedAudio& audio,int channels){
+    if(channels<=0 || audio.samples.empty())return {};
+    const size_t frames=audio.samples.size()/channels;
+    const size_t blocks=(frames+BLOCK_FRAMES-1)/BLOCK_FRAMES;
+    std::vector<double>partial(blocks*channels,0.0);
+    const float *data=audio.samples.data();
+    parallelRanges(blocks,1,[&](size_t begin,size_t end){
+      for(size_t b=begin;b<end;++b){
+        const size_t f0=b*BLOCK_FRAMES,f1=std::min(frames,f0+BLOCK_FRAMES);
+        double *sum=&partial[b*channels];
+        for(size_t f=f0;f<f1;++f)for(int c=0;c<channels;++c)sum[c]+=data[f*channels+c];
+      }
+    },maxThreads);
+    std::vector<double>mean(channels,0.0);
+    for(size_t b=0;b<blocks;++b)for(int c=0;c<channels;++c)mean[c]+=partial[b*channels+c];
+    for(double& m:mean)m/=static_cast<double>(frames);
+    return mean;
+  }
+
+  // ---------------- Stateful ----------------
+  // FIR filter, same taps on every channel. Each range keeps a copy of the
+  // taps-1 input frames before it (overlap) and is filtered back to front in
+  // place, so every output sample sees exactly the inputs a serial pass sees.
+  static void applyFIR(DecodedAudio& audio,int channels,const std::vector<float>& taps){
+    if(channels<=0 || taps.empty() || audio.samples.empty())return;
+    const size_t frames=audio.samples.size()/channels;
+    const size_t history=taps.size()-1;
+    const size_t ranges=std::max<size_t>(1,std::min(maxThreads?maxThreads:hardwareThreads(),frames/BLOCK_FRAMES));
+    const size_t per=(frames+ranges-1)/ranges;
+    float *data=audio.samples.data();
+
+    // Overlap: input frames preceding each range, zero before the start of the file
+    std::vector<std::vector<float>>overlap(ranges,std::vector<float>(history*channels,0.0f));
+    for(size_t r=1;r<ranges;++r){
+      const size_t start=r*per;
+      const size_t avail=std::min(history,start);
+      std::copy(data+(start-avail)*channels,data+start*channels,overlap[r].begin()+(history-avail)*channels);
+    }
+
+    parallelRanges(ranges,1,[&](size_t begin,size_t end){
+      for(size_t r=begin;r<end;++r){
+        const size_t f0=r*per,f1=std::min(frames,f0+per);
+        const float *prev=overlap[r].data();
+        for(size_t f=f1;f-->f0;){
+          for(int c=0;c<channels;++c){
+            float acc=0.0f;
+            for(size_t k=0;k<taps.size();++k){
+              const float x=k<=f-f0?data[(f-k)*channels+c]:prev[(history-(k-(f-f0)))*channels+c];
+              acc+=taps[k]*x;
+            }
+            data[f*channels+c]=acc;
+          }
+        }
+      }
+    },ranges);
+  }
+
+  // Biquad (direct form I). A recursive filter's state at a range boundary is
+  // only known once everything before it has been filtered, so each channel
+  // runs serially with its state carried across blocks and the channels run
+  // in parallel. Matches a serial pass bit for bit.
+  static void applyBiquad(DecodedAudio& audio,int channels,const Biquad& q){
+    if(channels<=0 || audio.samples.empty())return;
+    const size_t frames=audio.samples.size()/channels;
+    float *data=audio.samples.data();
+    parallelRanges(static_cast<size_t>(channels),1,[&](size_t begin,size_t end){
+      for(size_t c=begin;c<end;++c){
+        double x1=0.0,x2=0.0,y1=0.0,y2=0.0;
+        for(size_t f=0;f<frames;++f){
+          float& s=data[f*channels+c];
+          const double x=s;
+          const double y=q.b0*x+q.b1*x1+q.b2*x2-q.a1*y1-q.a2*y2;
+          x2=x1;x1=x;y2=y1;y1=y;
+          s=static_cast<float>(y);
+        }
+      }
+    },maxThreads);
+  }
+
+  // One-pole DC blocking high-pass, R close to 1 (0.995 ~ 35 Hz at 44.1 kHz)
+  static void dcBlock(DecodedAudio& audio,int channels,double R=0.995){
+    applyBiquad(audio,channels,Biquad{1.0,-1.0,0.0,-R,0.0});
+  }
+
+  private:
+  static bool clampRange(const DecodedAudio& audio,int channels,uint64_t& startFrame,uint64_t& endFrame){
+    if(channels<=0)return false;
+    const uint64_t total=audio.samples.size()/channels;
+    endFrame=std::min(endFrame,total);
+    return startFrame<endFrame;
+  }
+
+  static float peakOf(const float *data,size_t n){
+    // 8 independent lanes so the loop vectorizes without -ffast-math
+    float m[8]{};
+    size_t i=0;
+    for(;i+8<=n;i+=8)for(int k=0;k<8;++k){
+      const float a=std::fabs(data[i+k]);
+      m[k]=a>m[k]?a:m[k];
+    }
+    float r=0.0f;
+    for(int k=0;k<8;++k)r=std::max(r,m[k]);
+    for(;i<n;++i)r=std::max(r,std::fabs(data[i]));
+    return r;
+  }
+
+  static void fade(DecodedAudio& audio,int channels,uint64_t startFrame,uint64_t frames,bool out,FadeCurve curve){
+    uint64_t endFrame=startFrame+frames;
+    if(frames==0 || !clampRange(audio,channels,startFrame,endFrame))return;
+    float *data=audio.samples.data();
+    const double len=static_cast<double>(frames);
+    parallelRanges(endFrame-startFrame,BLOCK_FRAMES,[=](size_t begin,size_t end){
+      for(size_t i=begin;i<end;++i){
+        double t=(static_cast<double>(i)+0.5)/len;
+        if(out)t=1.0-t;
+        const float g=static_cast<float>(curve==FadeCurve::EqualPower?std::sin(t*M_PI_2):t);
+        float *frame=data+(startFrame+i)*channels;
+        for(int c=0;c<channels;++c)frame[c]*=g;
+      }
+    },maxThreads);
+  }
+};
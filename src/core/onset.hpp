@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sndfile.hh>
+
+#include "fft.hpp"
+#include "io.hpp"
+
+// Onset detection settings
+struct OnsetConfig{
+  size_t fftSize=1024;
+  size_t hop=256;
+  FFT::Window window=FFT::Window::Hann;
+  float compression=100.0f;  // log(1+c*|X|) before differencing
+  int preFrames=8;           // adaptive threshold window before a frame
+  int postFrames=4;          // ...and after it (the decision latency)
+  float multiplier=1.5f;     // threshold = multiplier * local median + delta
+  float delta=0.02f;
+  double minInterval=0.05;   // seconds between onsets
+  bool snapToZeroCrossing=false;
+  double snapRadius=0.005;   // seconds searched either side when snapping
+};
+
+/*
+ * Streaming onset detector
+ *
+ * Spectral flux (half-wave rectified rise of the log-compressed magnitude
+ * spectrum) per hop, then adaptive peak picking against a local median. Feed
+ * it any block size with process(); memory stays bounded by the FFT frame, the
+ * threshold window and the snap radius, whatever the file length. One FFT plan
+ * and all buffers are allocated in configure().
+*/
+class OnsetDetector{
+  public:
+  struct Slice{
+    uint64_t start{};
+    uint64_t end{};
+  };
+
+  private:
+  OnsetConfig config;
+  uint32_t sampleRate=0;
+  int channels=1;
+  FFT fft;
+  std::vector<float>window,frame,windowed,re,im,power,magnitude,previous;
+
+  // mono history ring (power of two)
+  std::vector<float>history;
+  size_t historyMask=0;
+  uint64_t consumed=0;   // mono samples seen
+  size_t sinceHop=0;
+
+  // onset detection function ring, indexed by hop number
+  std::vector<float>odf,sorted;
+  uint64_t hops=0;
+  uint64_t lastOnset=0;
+  bool haveOnset=false;
+  uint64_t minGap=0;
+  uint64_t snapFrames=0;
+
+  std::vector<uint64_t>onsets;
+
+  public:
+  OnsetDetector(){}
+  OnsetDetector(uint32_t rate,int numChannels,const OnsetConfig& cfg=OnsetConfig{}){configure(rate,numChannels,cfg);}
+
+  bool configure(uint32_t rate,int numChannels,const OnsetConfig& cfg=OnsetConfig{}){
+    if(rate==0 || numChannels<=0 || !FFT::isPowerOfTwo(cfg.fftSize) || cfg.fftSize<4 || cfg.hop==0 || cfg.hop>cfg.fftSize)return false;
+    config=cfg;
+    config.preFrames=std::max(1,cfg.preFrames);
+    config.postFrames=std::max(0,cfg.postFrames);
+    sampleRate=rate;
+    channels=numChannels;
+    fft.init(cfg.fftSize);
+    window=FFT::makeWindow(cfg.window,cfg.fftSize);
+    frame.assign(cfg.fftSize,0.0f);
+    windowed.assign(cfg.fftSize,0.0f);
+    re.assign(fft.bins(),0.0f);
+    im.assign(fft.bins(),0.0f);
+    power.assign(fft.bins(),0.0f);
+    magnitude.assign(fft.bins(),0.0f);
+    minGap=static_cast<uint64_t>(cfg.minInterval*rate);
+    snapFrames=cfg.snapToZeroCrossing?static_cast<uint64_t>(cfg.snapRadius*rate):0;
+
+    // enough history for one FFT frame plus the decision latency and the snap radius
+    const size_t need=cfg.fftSize+config.postFrames*cfg.hop+2*snapFrames+1;
+    size_t h=1;
+    while(h<need)h<<=1;
+    history.assign(h,0.0f);
+    historyMask=h-1;
+    odf.assign(config.preFrames+config.postFrames+1,0.0f);
+    sorted.resize(odf.size());
+    reset();
+    return true;
+  }
+
+  void reset(){
+    std::fill(history.begin(),history.end(),0.0f);
+    previous.assign(fft.bins(),0.0f);
+    std::fill(odf.begin(),odf.end(),0.0f);
+    consumed=0;
+    sinceHop=0;
+    hops=0;
+    lastOnset=0;
+    haveOnset=false;
+    onsets.clear();
+  }
+
+  // Interleaved input, any block size
+  void process(const float *in,size_t frames){
+    const float mix=1.0f/channels;
+    for(size_t f=0;f<frames;++f){
+      float v=in[f*channels];
+      for(int c=1;c<channels;++c)v+=in[f*channels+c];
+      history[consumed & historyMask]=v*mix;
+      ++consumed;
+      if(++sinceHop==config.hop){
+        sinceHop=0;
+        analyzeHop();
+      }
+    }
+  }
+
+  // Flush the decision latency at the end of the stream
+  void finish(){
+    const std::vector<float>silence(config.hop*channels,0.0f);
+    for(int i=0;i<config.postFrames;++i)process(silence.data(),config.hop);
+  }
+
+  // Onset positions (frames) found so far; takeOnsets() hands them over and clears
+  inline const std::vector<uint64_t>& getOnsets()const{return onsets;}
+  std::vector<uint64_t>takeOnsets(){std::vector<uint64_t>out;out.swap(onsets);return out;}
+
+  // ---------------- Whole buffers / files ----------------
+  static std::vector<uint64_t>detect(const std::vector<float>& samples,int numChannels,uint32_t rate,const OnsetConfig& cfg=OnsetConfig{}){
+    OnsetDetector detector;
+    if(!detector.configure(rate,numChannels,cfg))return {};
+    const uint64_t frames=samples.size()/numChannels;
+    const uint64_t chunk=1<<16;
+    for(uint64_t f=0;f<frames;f+=chunk)detector.process(samples.data()+f*numChannels,static_cast<size_t>(std::min(chunk,frames-f)));
+    detector.finish();
+    return clip(detector.takeOnsets(),frames);
+  }
+
+  // Streams the file in chunks; memory does not grow with its length
+  static bool detectFile(const std::string& path,std::vector<uint64_t>& out,const OnsetConfig& cfg=OnsetConfig{}){
+    SF_INFO info;
+    SNDFILE *file=openSoundFile(path,info);
+    if(!file)return false;
+    OnsetDetector detector;
+    if(!detector.configure(static_cast<uint32_t>(info.samplerate),info.channels,cfg)){
+      std::cerr << "Invalid onset settings for: " << path << std::endl;
+      sf_close(file);
+      return false;
+    }
+    const sf_count_t chunk=65536;
+    std::vector<float>buffer(chunk*info.channels);
+    sf_count_t got;
+    uint64_t frames=0;
+    while((got=sf_readf_float(file,buffer.data(),chunk))>0){
+      detector.process(buffer.data(),static_cast<size_t>(got));
+      frames+=got;
+    }
+    sf_close(file);
+    detector.finish();
+    out=clip(detector.takeOnsets(),frames);
+    return true;
+  }
+
+  // Regions between consecutive onsets; the first starts at frame 0
+  static std::vector<Slice>slices(const std::vector<uint64_t>& onsetFrames,uint64_t totalFrames){
+    std::vector<Slice>out;
+    uint64_t start=0;
+    for(uint64_t o:onsetFrames){
+      if(o<=start || o>=totalFrames)continue;
+      out.push_back({start,o});
+      start=o;
+    }
+    if(start<totalFrames)out.push_back({start,totalFrames});
+    return out;
+  }
+
+  private:
+  static std::vector<uint64_t>clip(std::vector<uint64_t>v,uint64_t frames){
+    v.erase(std::remove_if(v.begin(),v.end(),[frames](uint64_t o){return o>=frames;}),v.end());
+    return v;
+  }
+
+  void analyzeHop(){
+    const size_t n=config.fftSize;
+    // latest n samples, zero before the start of the stream
+    for(size_t k=0;k<n;++k){
+      const uint64_t age=n-k;
+      frame[k]=age<=consumed?history[(consumed-age) & historyMask]:0.0f;
+    }
+    fft.powerSpectrum(frame.data(),window.data(),power.data(),re.data(),im.data(),windowed.data());
+
+    float flux=0.0f;
+    const size_t bins=power.size();
+    for(size_t b=0;b<bins;++b){
+      magnitude[b]=std::log1p(config.compression*std::sqrt(power[b]));
+      flux+=std::max(0.0f,magnitude[b]-previous[b]);
+    }
+    previous.swap(magnitude);
+    odf[hops%odf.size()]=flux/bins;
+    ++hops;
+
+    // decide on the frame postFrames hops back once its whole window is in
+    const int span=config.preFrames+config.postFrames+1;
+    if(hops<static_cast<uint64_t>(span))return;
+    const uint64_t candidate=hops-1-config.postFrames;
+    const float value=odf[candidate%odf.size()];
+    for(int k=0;k<span;++k){
+      const uint64_t i=candidate-config.preFrames+k;
+      const float v=odf[i%odf.size()];
+      if(v>value || (v==value && i<candidate))return; // not the local maximum
+      sorted[k]=v;
+    }
+    std::nth_element(sorted.begin(),sorted.begin()+span/2,sorted.end());
+    if(value<config.multiplier*sorted[span/2]+config.delta)return;
+
+    // the rise shows up as the frame's newest samples arrive; report the frame center
+    const uint64_t end=(candidate+1)*config.hop;
+    uint64_t position=end>n/2?end-n/2:0;
+    if(haveOnset && position<lastOnset+minGap)return;
+    if(snapFrames)position=snap(position);
+    onsets.push_back(position);
+    lastOnset=position;
+    haveOnset=true;
+  }
+
+  // Nearest sign change within the snap radius, searched in the history ring
+  uint64_t snap(uint64_t position)const{
+    const uint64_t oldest=consumed>history.size()?consumed-history.size():0;
+    for(uint64_t d=0;d<=snapFrames;++d){
+      for(int side=0;side<2;++side){
+        if(side==1 && d==0)continue;
+        const uint64_t p=side?position-d:position+d;
+        if((side && position<d) || p==0 || p<=oldest || p>=consumed)continue;
+        const float a=history[(p-1) & historyMask],b=history[p & historyMask];
+        if((a<=0.0f && b>0.0f) || (a>=0.0f && b<0.0f))return p;
+      }
+    }
+    return position;
+  }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Band-limited oscillator
+ *
+ * Phase accumulator oscillator that renders whole blocks at a time. The sine
+ * uses a folded odd polynomial instead of libm, square and saw are corrected
+ * with PolyBLEP so they do not alias. Every per-sample loop is branch free so
+ * the compiler can vectorize it.
+*/
+class Oscillator{
+  public:
+  enum Wave:int{
+    SINE_WAVE=0,
+    SQUARE_WAVE=1,
+    SAWTOOTH_WAVE=2
+  };
+
+  // Samples rendered per inner loop, keeps the float phase ramp accurate
+  static constexpr size_t BLOCK_SIZE=256;
+
+  private:
+  Wave wave=SINE_WAVE;
+  float sampleRate=44100.0f;
+  float frequency=440.0f;
+  float amplitude=1.0f;
+  double phase=0.0;      // normalized [0,1)
+  float increment=0.0f;  // frequency / sampleRate
+
+  public:
+  Oscillator(){updateIncrement();}
+  Oscillator(Wave wave,float frequency,float amplitude,float sampleRate):wave(wave),sampleRate(sampleRate),frequency(frequency),amplitude(amplitude){updateIncrement();}
+
+  void setWave(Wave w){wave=w;}
+  void setFrequency(float hz){frequency=hz;updateIncrement();}
+  void setAmplitude(float amp){amplitude=amp;}
+  void setSampleRate(float sr){sampleRate=sr;updateIncrement();}
+  void setPhase(double p){phase=p-static_cast<double>(static_cast<int64_t>(p));}
+  void reset(){phase=0.0;}
+
+  inline Wave getWave()const{return wave;}
+  inline float getFrequency()const{return frequency;}
+  inline float getAmplitude()const{return amplitude;}
+  inline float getSampleRate()const{return sampleRate;}
+  inline double getPhase()const{return phase;}
+
+  // Render a mono block
+  void process(float *out,size_t frames){
+    float phases[BLOCK_SIZE];
+    while(frames>0){
+      const size_t n=std::min(frames,BLOCK_SIZE);
+      const float base=static_cast<float>(phase);
+      const float inc=increment;
+
+      // Phase ramp for this block, wrapped into [0,1)
+      for(size_t i=0;i<n;++i){
+        float p=base+inc*static_cast<float>(i);
+        phases[i]=p-static_cast<float>(static_cast<int>(p));
+      }
+
+      switch(wave){
+        case SQUARE_WAVE: renderSquare(phases,out,n);break;
+        case SAWTOOTH_WAVE: renderSaw(phases,out,n);break;
+        default: renderSine(phases,out,n);break;
+      }
+
+      phase+=static_cast<double>(inc)*static_cast<double>(n);
+      phase-=static_cast<double>(static_cast<int64_t>(phase));
+      out+=n;
+      frames-=n;
+    }
+  }
+
+  // Render an interleaved block, same signal on every channel
+  void process(float *out,size_t frames,int channels){
+    if(channels<=1){process(out,frames);return;}
+    float mono[BLOCK_SIZE];
+    while(frames>0){
+      const size_t n=std::min(frames,BLOCK_SIZE);
+      process(mono,n);
+      for(size_t f=0;f<n;++f)for(int c=0;c<channels;++c)out[f*channels+c]=mono[f];
+      out+=n*channels;
+      frames-=n;
+    }
+  }
+
+  // Add into an interleaved block (for mixing into an existing buffer)
+  void processAdd(float *out,size_t frames,int channels){
+    float mono[BLOCK_SIZE];
+    while(frames>0){
+      const size_t n=std::min(frames,BLOCK_SIZE);
+      process(mono,n);
+      for(size_t f=0;f<n;++f)for(int c=0;c<channels;++c)out[f*channels+c]+=mono[f];
+      out+=n*channels;
+      frames-=n;
+    }
+  }
+
+  // Render a whole tone, ready for Audio::reload(samples,channels,sampleRate)
+  static std::vector<float>render(Wave wave,float frequency,float amplitude,double seconds,int sampleRate,int channels=1){
+    if(sampleRate<=0 || channels<=0 || seconds<=0.0)return {};
+    const size_t frames=static_cast<size_t>(seconds*sampleRate);
+    std::vector<float>samples(frames*channels);
+    Oscillator osc(wave,frequency,amplitude,static_cast<float>(sampleRate));
+    osc.process(samples.data(),frames,channels);
+    return samples;
+  }
+
+  private:
+  void updateIncrement(){increment=sampleRate>0.0f?frequency/sampleRate:0.0f;}
+
+  // sin(2*pi*p) for p in [0,1), folded to [-1/4,1/4] and evaluated with an odd polynomial
+  static inline float fastSin(float p){
+    float t=p>0.5f?p-1.0f:p;                 // [-0.5,0.5)
+    t=t>0.25f?0.5f-t:t;                        // fold around +1/4
+    t=t<-0.25f?-0.5f-t:t;                      // fold around -1/4
+    const float x=t*6.28318530718f;            // [-pi/2,pi/2]
+    const float x2=x*x;
+    return x*(1.0f+x2*(-1.6666667e-1f+x2*(8.3333333e-3f+x2*(-1.9841270e-4f+x2*2.7557319e-6f))));
+  }
+
+  // Polynomial band-limited step residual, t in [0,1), dt=phase increment
+  static inline float polyBlep(float t,float dt){
+    const float a=t/dt;
+    const float b=(t-1.0f)/dt;
+    const float lo=a+a-a*a-1.0f;
+    const float hi=b*b+b+b+1.0f;
+    return t<dt?lo:(t>1.0f-dt?hi:0.0f);
+  }
+
+  void renderSine(const float *phases,float *out,size_t n)const{
+    const float amp=amplitude;
+    for(size_t i=0;i<n;++i)out[i]=amp*fastSin(phases[i]);
+  }
+
+  void renderSquare(const float *phases,float *out,size_t n)const{
+    const float amp=amplitude,dt=increment;
+    for(size_t i=0;i<n;++i){
+      const float p=phases[i];
+      float half=p+0.5f;
+      half=half>=1.0f?half-1.0f:half;
+      const float naive=p<0.5f?1.0f:-1.0f;
+      out[i]=amp*(naive+polyBlep(p,dt)-polyBlep(half,dt));
+    }
+  }
+
+  void renderSaw(const float *phases,float *out,size_t n)const{
+    const float amp=amplitude,dt=increment;
+    for(size_t i=0;i<n;++i){
+      const float p=phases[i];
+      out[i]=amp*(2.0f*p-1.0f-polyBlep(p,dt));
+    }
+  }
+};
@@ -0,0 +1,448 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sndfile.hh>
+
+#include "io.hpp"
+#include "wav_reader.hpp"
+#include "mp3_index.hpp"
+
+/*
+ * Out-of-core paged sample store
+ *
+ * Decoded audio lives in a temporary spill file (unlinked on creation, so it
+ * never outlives the process) as fixed-size pages of PAGE_FRAMES interleaved
+ * float frames. A bounded cache keeps the most recently used pages in memory;
+ * a background thread prefetches ahead of the playhead and across the visible
+ * view. Memory use is set by the cache size, not by the file length.
+ *
+ * MP3 is not decoded up front: pages are decoded from an Mp3Stream the first
+ * time they are loaded (then written back like edits), so opening and
+ * jumping around a long file cost one frame index lookup and one page.
+ *
+ * Threads: read/write/scan may be called from any non-audio thread and block
+ * on disk. tryRead() is for the audio callback: it copies only resident
+ * pages (pinned while copying, so eviction waits for it), writes silence for
+ * the rest and never locks or touches the disk. write() never changes a
+ * resident page in place: it fills a fresh page and swaps it into the table,
+ * so a tryRead() or scan() still on the old page finishes on consistent data.
+*/
+class PagedStore{
+  public:
+  static constexpr uint64_t PAGE_FRAMES=1<<16;
+
+  private:
+  static constexpr uint64_t NONE=UINT64_MAX;
+
+  struct Page{
+    std::vector<float>data;
+    std::atomic<int>pins{0};
+    std::atomic<uint64_t>lastUse{0};
+    uint64_t index=NONE;   // file page held, guarded by lock
+    bool dirty=false;
+  };
+
+  int channels=0;
+  uint32_t sampleRate=0;
+  uint64_t totalFrames=0;
+  size_t pageCount=0;
+  int fd=-1;
+
+  // lazily decoded source, pages not yet in the spill file
+  std::unique_ptr<Mp3Stream>mp3;
+  std::vector<uint8_t>decoded;   // 0 not yet, 1 in the spill file / pool, 2 failed (retried on demand only); guarded by lock
+
+  std::vector<Page>pool;
+  std::unique_ptr<std::atomic<Page*>[]>table;   // file page -> resident page
+  std::mutex lock;                              // pool/spill file, never taken by tryRead
+  std::atomic<uint64_t>clock{0};
+  std::atomic<uint64_t>misses{0};
+
+  // prefetch
+  std::atomic<uint64_t>playhead{0};
+  std::atomic<uint64_t>viewStart{0},viewEnd{0};
+  uint64_t aheadFrames=0;
+  std::thread prefetcher;
+  std::mutex wakeLock;
+  std::condition_variable wake;
+  bool quit=false;
+
+  public:
+  PagedStore(){}
+  PagedStore(const PagedStore&)=delete;
+  PagedStore& operator=(const PagedStore&)=delete;
+  ~PagedStore(){close();}
+
+  // Decode a file into the spill file, streaming; cacheBytes bounds resident memory
+  bool open(const std::string& path,size_t cacheBytes=256u<<20,double aheadSeconds=4.0){
+    close();
+    if(openMp3(path,cacheBytes,aheadSeconds))return true;
+    // Plain WAV is read natively, anything else through libsndfile
+    WavReader wav;
+    SNDFILE *file=nullptr;
+    SF_INFO info{};
+    if(wav.open(path)){
+      info.channels=wav.getChannels();
+      info.samplerate=static_cast<int>(wav.getInfo().sampleRate);
+      info.frames=static_cast<sf_count_t>(wav.frames());
+    }else if(!(file=openSoundFile(path,info)))return false;
+    auto finish=[&]{if(file)sf_close(file);};
+    if(!allocate(info.channels,static_cast<uint32_t>(info.samplerate),static_cast<uint64_t>(info.frames),cacheBytes,aheadSeconds)){
+      finish();
+      return false;
+    }
+    std::vector<float>buffer(PAGE_FRAMES*channels);
+    uint64_t frames=0;
+    sf_count_t got;
+    while(frames<totalFrames && (got=file?sf_readf_float(file,buffer.data(),PAGE_FRAMES):static_cast<sf_count_t>(wav.read(frames,buffer.data(),PAGE_FRAMES)))>0){
+      if(!pwriteAll(fd,buffer.data(),static_cast<size_t>(got)*channels*sizeof(float),frames*channels*sizeof(float))){
+        std::cerr << "Error writing spill file for: " << path << std::endl;
+        finish();
+        close();
+        return false;
+      }
+      frames+=static_cast<uint64_t>(got);
+    }
+    finish();
+    totalFrames=std::min(totalFrames,frames); // decoders may report more than they deliver
+    startPrefetch();
+    return true;
+  }
+
+  // Empty (silent) store, e.g. for recording or a new document
+  bool create(int numChannels,uint32_t rate,uint64_t frames,size_t cacheBytes=256u<<20,double aheadSeconds=4.0){
+    close();
+    if(!allocate(numChannels,rate,frames,cacheBytes,aheadSeconds))return false;
+    startPrefetch();
+    return true;
+  }
+
+  private:
+  bool openMp3(const std::string& path,size_t cacheBytes,double aheadSeconds){
+    std::string ext=std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+    if(ext!=".mp3")return false;
+    std::unique_ptr<Mp3Stream>stream=std::make_unique<Mp3Stream>();
+    if(!stream->open(path) || !allocate(stream->getChannels(),stream->getSampleRate(),stream->frames(),cacheBytes,aheadSeconds))return false;
+    mp3=std::move(stream);
+    decoded.assign(pageCount,0);
+    startPrefetch();
+    return true;
+  }
+
+  // Only once the spill file holds the data, or it would cache stale pages
+  void startPrefetch(){
+    quit=false;
+    prefetcher=std::thread([this]{prefetchLoop();});
+  }
+
+  public:
+  void close(){
+    if(prefetcher.joinable()){
+      {std::lock_guard<std::mutex>guard(wakeLock);quit=true;}
+      wake.notify_all();
+      prefetcher.join();
+    }
+    mp3.reset();
+    decoded.clear();
+    if(fd>=0)::close(fd);
+    fd=-1;
+    pool.clear();
+    table.reset();
+    channels=0;
+    sampleRate=0;
+    totalFrames=0;
+    pageCount=0;
+  }
+
+  inline bool isOpen()const{return fd>=0;}
+  inline int getChannels()const{return channels;}
+  inline uint32_t getSampleRate()const{return sampleRate;}
+  inline uint64_t frames()const{return totalFrames;}
+  inline size_t cachePages()const{return pool.size();}
+  inline uint64_t getMisses()const{return misses.load();}
+
+  // ---------------- Any non-audio thread ----------------
+  size_t read(uint64_t frame,float *out,size_t count){
+    return walk(frame,count,[&](Page& page,uint64_t offset,size_t done,size_t n){
+      std::copy(page.data.data()+offset*channels,page.data.data()+(offset+n)*channels,out+done*channels);
+    });
+  }
+
+  // Overwrite frames; changed pages go back to the spill file on eviction
+  size_t write(uint64_t frame,const float *in,size_t count){
+    if(frame>=totalFrames)return 0;
+    count=static_cast<size_t>(std::min<uint64_t>(count,totalFrames-frame));
+    std::lock_guard<std::mutex>guard(lock);
+    size_t done=0;
+    while(done<count){
+      const size_t p=static_cast<size_t>((frame+done)/PAGE_FRAMES);
+      const uint64_t offset=(frame+done)%PAGE_FRAMES;
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(count-done,PAGE_FRAMES-offset));
+      Page *page=load(p);
+      if(!page)break;
+      // the callback may be copying this page unlocked: edit a copy and swap it in
+      page->pins.fetch_add(1);  // not a victim candidate for its own copy
+      Page *fresh=pickVictim();
+      page->pins.fetch_sub(1);
+      if(!fresh || !evict(*fresh)){
+        std::cerr << "Page cache exhausted" << std::endl;
+        break;
+      }
+      const size_t frames=static_cast<size_t>(std::min(PAGE_FRAMES,totalFrames-static_cast<uint64_t>(p)*PAGE_FRAMES));
+      if(offset>0 || n<frames)std::copy(page->data.begin(),page->data.begin()+frames*channels,fresh->data.begin());
+      std::copy(in+done*channels,in+(done+n)*channels,fresh->data.data()+offset*channels);
+      fresh->index=p;
+      fresh->dirty=true;
+      fresh->lastUse.store(clock.fetch_add(1,std::memory_order_relaxed),std::memory_order_relaxed);
+      table[p].store(fresh);
+      // retired: reused once nobody has it pinned (see pickVictim)
+      page->index=NONE;
+      page->dirty=false;
+      done+=n;
+    }
+    return done;
+  }
+
+  // fn(const float *interleaved,size_t frames) over [startFrame,endFrame), one
+  // page run at a time, for streaming analysis (meters, statistics, onsets).
+  // The page is pinned rather than locked while fn runs.
+  template<typename Fn>
+  void scan(uint64_t startFrame,uint64_t endFrame,Fn fn){
+    endFrame=std::min(endFrame,totalFrames);
+    for(uint64_t frame=startFrame;frame<endFrame;){
+      const size_t p=static_cast<size_t>(frame/PAGE_FRAMES);
+      const uint64_t offset=frame%PAGE_FRAMES;
+      const size_t n=static_cast<size_t>(std::min(PAGE_FRAMES-offset,endFrame-frame));
+      Page *page;
+      {
+        std::lock_guard<std::mutex>guard(lock);
+        page=load(p);
+        if(!page)return;
+        page->pins.fetch_add(1);
+      }
+      fn(page->data.data()+offset*channels,n);
+      page->pins.fetch_sub(1);
+      frame+=n;
+    }
+  }
+
+  // Write every changed page back
+  bool flush(){
+    std::lock_guard<std::mutex>guard(lock);
+    for(Page& page:pool)if(!writeBack(page))return false;
+    return true;
+  }
+
+  // Where prefetching looks; the callback updates the playhead itself via tryRead()
+  void setPlayhead(uint64_t frame){playhead.store(frame);wake.notify_one();}
+  void setView(uint64_t startFrame,uint64_t endFrame){
+    viewStart.store(startFrame);
+    viewEnd.store(endFrame);
+    wake.notify_one();
+  }
+
+  // ---------------- Audio thread ----------------
+  // Copies resident frames, silence for pages not in memory (counted as misses)
+  size_t tryRead(uint64_t frame,float *out,size_t count){
+    if(frame>=totalFrames)return 0;
+    count=static_cast<size_t>(std::min<uint64_t>(count,totalFrames-frame));
+    playhead.store(frame);
+    size_t done=0;
+    while(done<count){
+      const size_t p=static_cast<size_t>((frame+done)/PAGE_FRAMES);
+      const uint64_t offset=(frame+done)%PAGE_FRAMES;
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(count-done,PAGE_FRAMES-offset));
+      bool copied=false;
+      // a second try covers a write() swapping the page between the load and the pin
+      for(int attempt=0;attempt<2 && !copied;++attempt){
+        Page *page=table[p].load();
+        if(!page)break;
+        page->pins.fetch_add(1);
+        // re-check after pinning: eviction clears the slot before waiting for pins
+        if(table[p].load()==page){
+          std::copy(page->data.data()+offset*channels,page->data.data()+(offset+n)*channels,out+done*channels);
+          page->lastUse.store(clock.fetch_add(1,std::memory_order_relaxed),std::memory_order_relaxed);
+          copied=true;
+        }
+        page->pins.fetch_sub(1);
+      }
+      if(!copied){
+        std::fill(out+done*channels,out+(done+n)*channels,0.0f);
+        misses.fetch_add(1,std::memory_order_relaxed);
+      }
+      done+=n;
+    }
+    return done;
+  }
+
+  private:
+  bool allocate(int numChannels,uint32_t rate,uint64_t frames,size_t cacheBytes,double aheadSeconds){
+    if(numChannels<=0 || rate==0)return false;
+    std::string name=(std::filesystem::temp_directory_path()/"sizzlefx-spill-XXXXXX").string();
+    fd=mkstemp(name.data());
+    if(fd<0){
+      std::cerr << "Error creating spill file: " << name << std::endl;
+      return false;
+    }
+    unlink(name.c_str()); // removed by the OS once closed, even after a crash
+    if(ftruncate(fd,static_cast<off_t>(frames*numChannels*sizeof(float)))!=0){
+      std::cerr << "Error sizing spill file" << std::endl;
+      close();
+      return false;
+    }
+    channels=numChannels;
+    sampleRate=rate;
+    totalFrames=frames;
+    pageCount=static_cast<size_t>((frames+PAGE_FRAMES-1)/PAGE_FRAMES);
+    table.reset(new std::atomic<Page*>[pageCount]);
+    for(size_t p=0;p<pageCount;++p)table[p].store(nullptr);
+
+    const size_t pageBytes=PAGE_FRAMES*channels*sizeof(float);
+    pool=std::vector<Page>(std::max<size_t>(4,cacheBytes/pageBytes));
+    for(Page& page:pool)page.data.assign(PAGE_FRAMES*channels,0.0f);
+    aheadFrames=static_cast<uint64_t>(aheadSeconds*rate);
+    return true;
+  }
+
+  template<typename Fn>
+  size_t walk(uint64_t frame,size_t count,Fn fn){
+    if(frame>=totalFrames)return 0;
+    count=static_cast<size_t>(std::min<uint64_t>(count,totalFrames-frame));
+    std::lock_guard<std::mutex>guard(lock);
+    size_t done=0;
+    while(done<count){
+      const size_t p=static_cast<size_t>((frame+done)/PAGE_FRAMES);
+      const uint64_t offset=(frame+done)%PAGE_FRAMES;
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(count-done,PAGE_FRAMES-offset));
+      Page *page=load(p);
+      if(!page)break;
+      fn(*page,offset,done,n);
+      done+=n;
+    }
+    return done;
+  }
+
+  // Resident page for file page p, evicting the least recently used one (lock held)
+  Page* load(size_t p){
+    if(Page *page=table[p].load()){
+      page->lastUse.store(clock.fetch_add(1,std::memory_order_relaxed),std::memory_order_relaxed);
+      return page;
+    }
+    Page *victim=pickVictim();
+    if(!victim){
+      std::cerr << "Page cache exhausted" << std::endl;
+      return nullptr;
+    }
+    if(!evict(*victim))return nullptr;
+    const uint64_t first=static_cast<uint64_t>(p)*PAGE_FRAMES;
+    const size_t frames=static_cast<size_t>(std::min(PAGE_FRAMES,totalFrames-first));
+    const size_t bytes=frames*channels*sizeof(float);
+    if(mp3 && decoded[p]!=1){
+      // first touch: decode into the page, it reaches the spill file on eviction.
+      // Only the last page may come up short (the stream ends early); anything
+      // else is a decode error and the page stays undecoded for the next try.
+      size_t got=0;
+      const bool seeked=mp3->seek(first);
+      while(seeked && got<frames){
+        const size_t n=mp3->read(victim->data.data()+got*channels,frames-got);
+        if(n==0)break;
+        got+=n;
+      }
+      if(!seeked || (got<frames && (got==0 || p+1<pageCount))){
+        if(decoded[p]==0)std::cerr << "Error decoding mp3 at frame " << first+got << std::endl;
+        decoded[p]=2;
+        return nullptr;
+      }
+      std::fill(victim->data.begin()+got*channels,victim->data.end(),0.0f);
+      decoded[p]=1;
+      victim->dirty=true;
+    }else if(preadAll(fd,victim->data.data(),bytes,first*channels*sizeof(float))!=bytes){
+      std::cerr << "Error reading spill file" << std::endl;
+      return nullptr;
+    }
+    victim->index=p;
+    victim->lastUse.store(clock.fetch_add(1,std::memory_order_relaxed),std::memory_order_relaxed);
+    table[p].store(victim);
+    return victim;
+  }
+
+  // Take a page out of the table (lock held); false if its changes could not be saved
+  bool evict(Page& victim){
+    if(victim.index==NONE)return true;
+    table[victim.index].store(nullptr);
+    while(victim.pins.load()>0)std::this_thread::yield(); // a reader is mid-copy
+    if(!writeBack(victim))return false;
+    victim.index=NONE;
+    return true;
+  }
+
+  // Free page, else the oldest outside the window about to be played. Pinned
+  // pages (a scan in progress, a page write() retired while it was being read)
+  // are skipped; nullptr when everything is pinned.
+  Page* pickVictim(){
+    const uint64_t head=playhead.load()/PAGE_FRAMES;
+    const uint64_t tail=(playhead.load()+aheadFrames)/PAGE_FRAMES;
+    Page *best=nullptr,*fallback=nullptr;
+    for(Page& page:pool){
+      if(page.pins.load()>0)continue;
+      if(page.index==NONE)return &page;
+      const uint64_t use=page.lastUse.load(std::memory_order_relaxed);
+      if(!fallback || use<fallback->lastUse.load(std::memory_order_relaxed))fallback=&page;
+      if(page.index>=head && page.index<=tail)continue;
+      if(!best || use<best->lastUse.load(std::memory_order_relaxed))best=&page;
+    }
+    return best?best:fallback;
+  }
+
+  bool writeBack(Page& page){
+    if(!page.dirty || page.index==NONE)return true;
+    const uint64_t first=page.index*PAGE_FRAMES;
+    const size_t frames=static_cast<size_t>(std::min(PAGE_FRAMES,totalFrames-first));
+    if(!pwriteAll(fd,page.data.data(),frames*channels*sizeof(float),first*channels*sizeof(float))){
+      std::cerr << "Error writing spill file" << std::endl;
+      return false;
+    }
+    page.dirty=false;
+    return true;
+  }
+
+  // Pages ahead of the playhead first, then the view, as far as half the cache
+  void prefetchLoop(){
+    const size_t budget=std::max<size_t>(1,pool.size()/2);
+    for(;;){
+      {
+        std::unique_lock<std::mutex>guard(wakeLock);
+        wake.wait_for(guard,std::chrono::milliseconds(20),[this]{return quit;});
+        if(quit)return;
+      }
+      std::vector<size_t>wanted;
+      const uint64_t head=playhead.load();
+      for(uint64_t f=head/PAGE_FRAMES*PAGE_FRAMES;f<std::min(totalFrames,head+aheadFrames+1) && wanted.size()<budget;f+=PAGE_FRAMES)wanted.push_back(static_cast<size_t>(f/PAGE_FRAMES));
+      const uint64_t vs=viewStart.load(),ve=std::min(viewEnd.load(),totalFrames);
+      for(uint64_t f=vs/PAGE_FRAMES*PAGE_FRAMES;f<ve && wanted.size()<budget;f+=PAGE_FRAMES)wanted.push_back(static_cast<size_t>(f/PAGE_FRAMES));
+      for(size_t p:wanted){
+        if(table[p].load())continue;
+        std::lock_guard<std::mutex>guard(lock); // per page, so editors are not starved
+        if(mp3 && decoded[p]==2)continue;
+        load(p);
+      }
+    }
+  }
+};
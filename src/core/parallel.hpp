@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+ * Small fork/join helpers for offline work
+ *
+ * Threads are started per call; these are meant for jobs that take far longer
+ * than a thread start (whole files, whole libraries), never for the audio
+ * callback.
+*/
+inline size_t hardwareThreads(){
+  const unsigned n=std::thread::hardware_concurrency();
+  return n?n:1;
+}
+
+// Split [0,count) into contiguous ranges of at least minChunk items and run
+// fn(begin,end) for each on its own thread. The calling thread takes the first range.
+template<typename F> void parallelRanges(size_t count,size_t minChunk,F&& fn,size_t maxThreads=0){
+  if(count==0)return;
+  size_t threads=maxThreads?maxThreads:hardwareThreads();
+  threads=std::max<size_t>(1,std::min(threads,(count+minChunk-1)/std::max<size_t>(minChunk,1)));
+  if(threads==1){fn(size_t{0},count);return;}
+
+  const size_t per=(count+threads-1)/threads;
+  std::vector<std::thread>pool;
+  pool.reserve(threads-1);
+  for(size_t t=1;t<threads;++t){
+    const size_t begin=t*per,end=std::min(count,begin+per);
+    if(begin>=end)break;
+    pool.emplace_back([&fn,begin,end](){fn(begin,end);});
+  }
+  fn(size_t{0},std::min(count,per));
+  for(std::thread& th:pool)th.join();
+}
+
+// Run fn(index) for every index in [0,count), handing indices out dynamically
+// so uneven items (files of different lengths) balance across threads.
+template<typename F> void parallelForEach(size_t count,F&& fn,size_t maxThreads=0){
+  if(count==0)return;
+  size_t threads=std::min(count,maxThreads?maxThreads:hardwareThreads());
+  std::atomic<size_t>next{0};
+  auto worker=[&](){
+    for(size_t i=next.fetch_add(1);i<count;i=next.fetch_add(1))fn(i);
+  };
+  std::vector<std::thread>pool;
+  pool.reserve(threads-1);
+  for(size_t t=1;t<threads;++t)pool.emplace_back(worker);
+  worker();
+  for(std::thread& th:pool)th.join();
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "lockfree.hpp"
+
+/*
+ * Breakpoint automation lane
+ *
+ * Sorted (frame,value) points with linear segments. Rendering looks up the
+ * segment once per block and then fills straight-line runs, so the per-sample
+ * cost is a multiply-add.
+*/
+class AutomationLane{
+  public:
+  struct Breakpoint{
+    uint64_t frame{};
+    float value{};
+  };
+
+  private:
+  std::vector<Breakpoint>points;
+
+  public:
+  // Not real-time safe, edit a lane that is not attached to a playing parameter
+  void addPoint(uint64_t frame,float value){
+    Breakpoint bp{frame,value};
+    auto it=std::upper_bound(points.begin(),points.end(),frame,[](uint64_t f,const Breakpoint& p){return f<p.frame;});
+    points.insert(it,bp);
+  }
+  void removePoint(size_t index){if(index<points.size())points.erase(points.begin()+index);}
+  void clear(){points.clear();}
+
+  inline const std::vector<Breakpoint>& getPoints()const{return points;}
+  inline bool empty()const{return points.empty();}
+
+  float valueAt(uint64_t frame)const{
+    if(points.empty())return 0.0f;
+    size_t i=segmentAt(frame);
+    if(frame<=points.front().frame)return points.front().value;
+    if(i+1>=points.size())return points.back().value;
+    const Breakpoint &a=points[i],&b=points[i+1];
+    const float t=static_cast<float>(frame-a.frame)/static_cast<float>(b.frame-a.frame);
+    return a.value+(b.value-a.value)*t;
+  }
+
+  // Fill out[0..frames) with the lane starting at startFrame.
+  // Returns true when the whole block holds one value (out[0] is then enough).
+  bool render(uint64_t startFrame,float *out,size_t frames)const{
+    if(points.empty()){std::fill(out,out+frames,0.0f);return true;}
+
+    const uint64_t endFrame=startFrame+frames;
+    size_t seg=segmentAt(startFrame);
+    bool constant=true;
+    size_t written=0;
+    while(written<frames){
+      const uint64_t frame=startFrame+written;
+      // Before the first point or after the last one the lane is flat
+      if(frame<points.front().frame){
+        size_t n=static_cast<size_t>(std::min<uint64_t>(points.front().frame,endFrame)-frame);
+        std::fill(out+written,out+written+n,points.front().value);
+        written+=n;
+        constant=false;
+        continue;
+      }
+      if(seg+1>=points.size()){
+        std::fill(out+written,out+frames,points.back().value);
+        break;
+      }
+
+      const Breakpoint &a=points[seg],&b=points[seg+1];
+      if(frame>=b.frame){++seg;continue;}
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(b.frame,endFrame)-frame);
+      const float slope=(b.value-a.value)/static_cast<float>(b.frame-a.frame);
+      const float start=a.value+slope*static_cast<float>(frame-a.frame);
+      float *dst=out+written;
+      for(size_t i=0;i<n;++i)dst[i]=start+slope*static_cast<float>(i);
+      if(slope!=0.0f)constant=false;
+      written+=n;
+    }
+    return constant && (frames==0 || out[0]==out[frames-1]);
+  }
+
+  private:
+  // Index of the last point at or before frame (0 when frame precedes all points)
+  size_t segmentAt(uint64_t frame)const{
+    auto it=std::upper_bound(points.begin(),points.end(),frame,[](uint64_t f,const Breakpoint& p){return f<p.frame;});
+    return it==points.begin()?0:static_cast<size_t>(it-points.begin())-1;
+  }
+};
+
+/*
+ * Automatable parameter
+ *
+ * The UI thread calls setTarget(), which only pushes onto a lock-free queue.
+ * The audio thread calls process() once per block: it drains the queue and
+ * ramps linearly to the newest target over the smoothing time, so changes are
+ * sample accurate and free of zipper noise. An attached lane overrides the
+ * manual target while it is enabled.
+*/
+class Parameter{
+  public:
+  static constexpr size_t MAX_BLOCK=256;
+
+  private:
+  struct Message{
+    float value;
+    bool jump; // skip smoothing
+  };
+
+  std::string name;
+  float minValue=0.0f,maxValue=1.0f;
+  SpscQueue<Message>queue{64};
+
+  // audio thread state
+  float current=0.0f;
+  float target=0.0f;
+  float step=0.0f;
+  uint32_t remaining=0;
+
+  // shared
+  std::atomic<uint32_t>rampFrames{441};
+  std::atomic<float>published{0.0f};           // last value rendered, for UI display
+  std::atomic<const AutomationLane*>lane{nullptr};
+
+  public:
+  Parameter(const std::string& name="",float defaultValue=0.0f,float minValue=0.0f,float maxValue=1.0f):name(name),minValue(minValue),maxValue(maxValue){
+    current=target=clamp(defaultValue);
+    published.store(current);
+  }
+
+  Parameter(const Parameter&)=delete;
+  Parameter& operator=(const Parameter&)=delete;
+
+  // ---- UI thread ----
+  bool setTarget(float value){return queue.push({clamp(value),false});}
+  bool setValueImmediate(float value){return queue.push({clamp(value),true});}
+  // The lane must outlive its attachment, pass nullptr to detach
+  void attachLane(const AutomationLane* l){lane.store(l,std::memory_order_release);}
+  void setSmoothingTime(float seconds,float sampleRate){
+    rampFrames.store(static_cast<uint32_t>(std::max(1.0f,seconds*sampleRate)),std::memory_order_relaxed);
+  }
+
+  inline const std::string& getName()const{return name;}
+  inline float getMin()const{return minValue;}
+  inline float getMax()const{return maxValue;}
+  inline float getValue()const{return published.load(std::memory_order_relaxed);}
+
+  // ---- audio thread ----
+  // Fill out[0..frames) (frames<=MAX_BLOCK when out is a stack buffer of that size).
+  // Returns true when the block is constant, so callers may use out[0] as a scalar.
+  bool process(float *out,size_t frames,uint64_t startFrame=0){
+    const AutomationLane *l=lane.load(std::memory_order_acquire);
+    if(l && !l->empty()){
+      Message m;
+      while(queue.pop(m)){} // manual moves are ignored while automated
+      bool constant=l->render(startFrame,out,frames);
+      for(size_t i=0;i<frames;++i)out[i]=std::min(maxValue,std::max(minValue,out[i]));
+      if(frames>0){current=target=out[frames-1];remaining=0;}
+      published.store(current,std::memory_order_relaxed);
+      return constant;
+    }
+
+    drainQueue();
+    if(remaining==0){
+      std::fill(out,out+frames,current);
+      return true;
+    }
+
+    const size_t n=std::min<size_t>(remaining,frames);
+    const float base=current,s=step;
+    for(size_t i=0;i<n;++i)out[i]=base+s*static_cast<float>(i+1);
+    remaining-=static_cast<uint32_t>(n);
+    current=remaining==0?target:base+s*static_cast<float>(n);
+    std::fill(out+n,out+frames,current);
+    published.store(current,std::memory_order_relaxed);
+    return false;
+  }
+
+  // Advance by a block and return the value at its end, for per-block consumers
+  float next(size_t frames,uint64_t startFrame=0){
+    const AutomationLane *l=lane.load(std::memory_order_acquire);
+    if(l && !l->empty()){
+      Message m;
+      while(queue.pop(m)){}
+      current=target=clamp(l->valueAt(startFrame+(frames?frames-1:0)));
+      remaining=0;
+      published.store(current,std::memory_order_relaxed);
+      return current;
+    }
+
+    drainQueue();
+    if(remaining>0){
+      const size_t n=std::min<size_t>(remaining,frames);
+      remaining-=static_cast<uint32_t>(n);
+      current=remaining==0?target:current+step*static_cast<float>(n);
+      published.store(current,std::memory_order_relaxed);
+    }
+    return current;
+  }
+
+  inline bool isSmoothing()const{return remaining>0;}
+
+  private:
+  float clamp(float v)const{return std::min(maxValue,std::max(minValue,v));}
+
+  void drainQueue(){
+    Message m;
+    bool got=false,jump=false;
+    float latest=target;
+    while(queue.pop(m)){latest=m.value;jump=m.jump;got=true;}
+    if(!got)return;
+
+    target=latest;
+    const uint32_t ramp=rampFrames.load(std::memory_order_relaxed);
+    if(jump || ramp<=1){
+      current=target;
+      remaining=0;
+    }else{
+      remaining=ramp;
+      step=(target-current)/static_cast<float>(ramp);
+    }
+    published.store(current,std::memory_order_relaxed);
+  }
+};
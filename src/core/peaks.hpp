@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "parallel.hpp"
+#include "summary_tree.hpp"
+
+/*
+ * Waveform peak index
+ *
+ * Per channel min/max/sum-of-squares buckets of about BUCKET_FRAMES frames
+ * in a BlockTree. A view column merges the O(log n) subtrees inside it, so
+ * drawing costs O(columns log n) at any zoom: once a column spans a bucket
+ * or more its edges snap to bucket boundaries and no samples are read at
+ * all; only closer in are raw samples read for the ragged edges. Edits,
+ * including inserts and deletes, rescan only the buckets they touch.
+*/
+class PeakPyramid{
+  public:
+  struct Bucket{
+    float min=0.0f;
+    float max=0.0f;
+    double sumSq=0.0;
+    uint64_t count=0;
+
+    inline float rms()const{return count?static_cast<float>(std::sqrt(sumSq/count)):0.0f;}
+    void merge(const Bucket& o){
+      if(o.count==0)return;
+      if(count==0){*this=o;return;}
+      min=std::min(min,o.min);
+      max=std::max(max,o.max);
+      sumSq+=o.sumSq;
+      count+=o.count;
+    }
+  };
+
+  static constexpr uint64_t BUCKET_FRAMES=1024;
+  static constexpr uint32_t SERIAL_VERSION=2;
+
+  private:
+  int channels=0;
+  BlockTree<Bucket>tree;    // one lane per channel
+
+  // streaming build
+  std::vector<uint64_t>pendingLengths;
+  std::vector<Bucket>pendingValues;
+
+  public:
+  void clear(){
+    channels=0;
+    tree.reset(1);
+    pendingLengths.clear();
+    pendingValues.clear();
+  }
+
+  // Full build from interleaved samples
+  void build(const FrameSource& samples,int numChannels,uint64_t frames){
+    clear();
+    if(numChannels<=0)return;
+    channels=numChannels;
+    tree.reset(channels);
+    std::vector<uint64_t>lengths;
+    BlockTree<Bucket>::chunk(frames,BUCKET_FRAMES,lengths);
+    std::vector<uint64_t>starts(lengths.size());
+    for(size_t b=1;b<lengths.size();++b)starts[b]=starts[b-1]+lengths[b-1];
+    std::vector<Bucket>values(lengths.size()*channels);
+    parallelRanges(lengths.size(),64,[&](size_t begin,size_t end){
+      std::vector<float>scratch;
+      for(size_t b=begin;b<end;++b)scanBuckets(samples,starts[b],starts[b]+lengths[b],values.data()+b*channels,scratch);
+    });
+    tree.assign(lengths,values);
+  }
+  void build(const std::vector<float>& samples,int numChannels){build(samples,numChannels,numChannels>0?samples.size()/numChannels:0);}
+
+  // Streaming build: begin(), append() consecutive blocks of any size, finish()
+  void begin(int numChannels){
+    clear();
+    channels=numChannels>0?numChannels:0;
+    tree.reset(channels);
+  }
+  void append(const float *interleaved,size_t frames){
+    if(channels<=0)return;
+    while(frames>0){
+      if(pendingLengths.empty() || pendingLengths.back()==BUCKET_FRAMES){
+        pendingLengths.push_back(0);
+        pendingValues.resize(pendingValues.size()+channels);
+      }
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(frames,BUCKET_FRAMES-pendingLengths.back()));
+      Bucket *b=pendingValues.data()+pendingValues.size()-channels;
+      for(int c=0;c<channels;++c)scan(interleaved+c,n,b[c]);
+      pendingLengths.back()+=n;
+      interleaved+=n*channels;
+      frames-=n;
+    }
+  }
+  void finish(){
+    tree.assign(pendingLengths,pendingValues);
+    pendingLengths.clear();
+    pendingValues.clear();
+  }
+
+  // Old frames [startFrame,oldEnd) were replaced by new frames [startFrame,newEnd)
+  void replace(const FrameSource& samples,uint64_t startFrame,uint64_t oldEnd,uint64_t newEnd){
+    if(channels<=0)return;
+    const BlockTree<Bucket>::Span s=tree.cover(startFrame,oldEnd,newEnd>startFrame?newEnd-startFrame:0,BUCKET_FRAMES/2);
+    std::vector<uint64_t>lengths;
+    BlockTree<Bucket>::chunk(s.newEnd-s.first,BUCKET_FRAMES,lengths);
+    std::vector<Bucket>values(lengths.size()*channels);
+    std::vector<float>scratch;
+    uint64_t at=s.first;
+    for(size_t b=0;b<lengths.size();++b){
+      scanBuckets(samples,at,at+lengths[b],values.data()+b*channels,scratch);
+      at+=lengths[b];
+    }
+    tree.splice(s,lengths,values);
+  }
+
+  // Frames [startFrame,endFrame) were overwritten in place. If the length
+  // changed without saying where, everything from startFrame on is replaced;
+  // prefer replace().
+  void update(const FrameSource& samples,uint64_t frames,uint64_t startFrame,uint64_t endFrame=UINT64_MAX){
+    const uint64_t old=tree.frames();
+    if(frames!=old)replace(samples,startFrame,old,frames);
+    else replace(samples,startFrame,std::min(endFrame,old),std::min(endFrame,old));
+  }
+  void update(const std::vector<float>& samples,uint64_t startFrame,uint64_t endFrame=UINT64_MAX){
+    if(channels>0)update(samples,samples.size()/channels,startFrame,endFrame);
+  }
+
+  inline int getChannels()const{return channels;}
+  inline uint64_t getTotalFrames()const{return tree.frames();}
+  inline bool empty()const{return tree.frames()==0;}
+
+  // Bucket lengths and values in order, for caching next to the audio (see ProjectFile)
+  void serialize(std::vector<uint8_t>& out)const{
+    const uint32_t version=SERIAL_VERSION;
+    const int32_t ch=channels;
+    const uint64_t count=tree.blocks();
+    append(out,&version,sizeof(version));
+    append(out,&ch,sizeof(ch));
+    append(out,&count,sizeof(count));
+    tree.forEach([&](uint64_t length,const Bucket *values){
+      append(out,&length,sizeof(length));
+      append(out,values,channels*sizeof(Bucket));
+    });
+  }
+
+  bool deserialize(const uint8_t *data,size_t size){
+    clear();
+    uint32_t version=0;
+    int32_t ch=0;
+    uint64_t count=0;
+    size_t at=sizeof(version)+sizeof(ch)+sizeof(count);
+    if(size<at)return false;
+    std::memcpy(&version,data,sizeof(version));
+    std::memcpy(&ch,data+sizeof(version),sizeof(ch));
+    std::memcpy(&count,data+sizeof(version)+sizeof(ch),sizeof(count));
+    const size_t record=sizeof(uint64_t)+static_cast<size_t>(std::max(ch,0))*sizeof(Bucket);
+    if(version!=SERIAL_VERSION || ch<=0 || count>(size-at)/record)return false;
+    std::vector<uint64_t>lengths(count);
+    std::vector<Bucket>values(count*ch);
+    for(uint64_t b=0;b<count;++b){
+      std::memcpy(&lengths[b],data+at,sizeof(uint64_t));
+      std::memcpy(values.data()+b*ch,data+at+sizeof(uint64_t),ch*sizeof(Bucket));
+      at+=record;
+    }
+    channels=ch;
+    tree.reset(channels);
+    tree.assign(lengths,values);
+    return true;
+  }
+
+  // Summary of frames [startFrame,endFrame) on one channel. Samples are only
+  // read for the ragged edges inside a bucket.
+  Bucket query(const FrameSource& samples,int channel,uint64_t startFrame,uint64_t endFrame)const{
+    std::vector<float>scratch;
+    return query(samples,channel,startFrame,endFrame,scratch);
+  }
+
+  // One bucket per view column starting at startFrame. With a bucket or more
+  // per column, column edges snap to the bucket boundary at or before them,
+  // so whole buckets are merged and samples (possibly paged from disk) are
+  // never read on the drawing thread.
+  void columns(const FrameSource& samples,int channel,uint64_t startFrame,double framesPerColumn,int count,std::vector<Bucket>& out)const{
+    out.assign(std::max(count,0),Bucket{});
+    const uint64_t total=tree.frames();
+    const bool snap=framesPerColumn>=static_cast<double>(BUCKET_FRAMES);
+    auto edge=[&](uint64_t f){return f>=total?total:snap?tree.blockStart(f):f;};
+    std::vector<float>scratch;
+    for(int c=0;c<count;++c){
+      const uint64_t s=edge(startFrame+static_cast<uint64_t>(c*framesPerColumn));
+      if(s>=total)break;
+      const uint64_t e=edge(startFrame+static_cast<uint64_t>((c+1)*framesPerColumn));
+      out[c]=query(samples,channel,s,snap?e:std::max(s+1,e),scratch);
+    }
+  }
+
+  private:
+  Bucket query(const FrameSource& samples,int channel,uint64_t startFrame,uint64_t endFrame,std::vector<float>& scratch)const{
+    Bucket out;
+    if(channel<0 || channel>=channels)return out;
+    tree.query(channel,startFrame,endFrame,out,[&](uint64_t f0,uint64_t f1,Bucket& b){
+      const size_t n=static_cast<size_t>(f1-f0);
+      scan(samples.get(f0,n,channels,scratch)+channel,n,b);
+    });
+    return out;
+  }
+
+  static void append(std::vector<uint8_t>& out,const void *p,size_t n){
+    const uint8_t *b=static_cast<const uint8_t*>(p);
+    out.insert(out.end(),b,b+n);
+  }
+
+  // One channel of n interleaved frames starting at p
+  void scan(const float *p,size_t n,Bucket& b)const{
+    if(n==0)return;
+    float mn=p[0],mx=p[0];
+    double sq=0.0;
+    for(size_t f=0;f<n;++f){
+      const float v=p[f*channels];
+      mn=v<mn?v:mn;
+      mx=v>mx?v:mx;
+      sq+=static_cast<double>(v)*v;
+    }
+    b.merge(Bucket{mn,mx,sq,n});
+  }
+
+  // Every channel's bucket for frames [f0,f1) in one read
+  void scanBuckets(const FrameSource& samples,uint64_t f0,uint64_t f1,Bucket *out,std::vector<float>& scratch)const{
+    const size_t n=static_cast<size_t>(f1-f0);
+    const float *p=samples.get(f0,n,channels,scratch);
+    for(int c=0;c<channels;++c){
+      out[c]=Bucket{};
+      scan(p+c,n,out[c]);
+    }
+  }
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "lockfree.hpp"
+
+/*
+ * Piece table for sample data
+ *
+ * The edited signal is a sequence of pieces, each a frame range of an
+ * immutable source chunk (the loaded file, a recording, pasted material).
+ * Pieces live in a persistent implicit treap keyed by frame offset: split and
+ * merge copy only the O(log n) nodes on their path, so cut, copy, paste,
+ * insert and delete cost O(log n) whatever the file length, and every older
+ * version (a Clip, an undo step, the callback's snapshot) stays valid.
+ *
+ * Publishing: the editor builds versions freely and publish()es one to the
+ * playback side through a SnapshotPublisher, so the callback reads without
+ * locking and old versions are freed on the editor thread.
+*/
+class PieceTable{
+  public:
+  typedef std::shared_ptr<const std::vector<float>>Source;
+
+  private:
+  struct Node;
+  typedef std::shared_ptr<const Node>NodePtr;
+
+  struct Node{
+    NodePtr left,right;
+    Source source;             // keeps the chunk alive
+    const float *data=nullptr; // first sample of the piece inside source
+    uint64_t length=0;         // frames in this piece
+    uint64_t total=0;          // frames in this subtree
+    uint32_t priority=0;
+  };
+
+  public:
+  // A detached run of pieces (copy/cut result); cheap to copy and to paste many times
+  class Clip{
+    friend class PieceTable;
+    NodePtr root;
+    int channels=0;
+    public:
+    inline uint64_t frames()const{return root?root->total:0;}
+    inline bool empty()const{return !root;}
+  };
+
+  // Immutable version handed to the playback callback
+  struct Snapshot{
+    NodePtr root;
+    int channels=0;
+    uint64_t frames=0;
+  };
+
+  private:
+  int channels=0;
+  NodePtr root;
+  mutable uint32_t seed=0x9e3779b9u; // treap priorities
+
+  SnapshotPublisher<Snapshot>published;
+
+  public:
+  PieceTable(){}
+  PieceTable(const std::vector<float>& samples,int numChannels){assign(samples,numChannels);}
+  PieceTable(const PieceTable&)=delete;
+  PieceTable& operator=(const PieceTable&)=delete;
+
+  // ---------------- Editor thread ----------------
+  void assign(const std::vector<float>& samples,int numChannels){
+    assign(std::make_shared<const std::vector<float>>(samples),numChannels);
+  }
+  void assign(Source source,int numChannels){
+    channels=numChannels>0?numChannels:0;
+    root=makePiece(source,0,channels?source->size()/channels:0);
+  }
+  void clear(){root.reset();}
+
+  inline int getChannels()const{return channels;}
+  inline uint64_t frames()const{return root?root->total:0;}
+  inline size_t pieces()const{return count(root);}
+
+  // Frames [start,end) as a clip; the table is unchanged
+  Clip copy(uint64_t start,uint64_t end)const{
+    Clip clip;
+    clip.channels=channels;
+    clampRange(start,end);
+    if(start>=end)return clip;
+    const auto a=split(root,start);
+    clip.root=split(a.second,end-start).first;
+    return clip;
+  }
+
+  // Remove frames [start,end)
+  void erase(uint64_t start,uint64_t end){
+    clampRange(start,end);
+    if(start>=end)return;
+    const auto a=split(root,start);
+    root=merge(a.first,split(a.second,end-start).second);
+  }
+
+  Clip cut(uint64_t start,uint64_t end){
+    Clip clip=copy(start,end);
+    erase(start,end);
+    return clip;
+  }
+
+  // Insert a clip at a frame (clamped to the end); false on a channel mismatch
+  bool paste(uint64_t at,const Clip& clip){
+    if(clip.empty())return true;
+    if(clip.channels!=channels)return false;
+    at=std::min(at,frames());
+    const auto a=split(root,at);
+    root=merge(merge(a.first,clip.root),a.second);
+    return true;
+  }
+
+  // New material becomes its own source chunk
+  bool insert(uint64_t at,const std::vector<float>& samples){return insert(at,std::make_shared<const std::vector<float>>(samples));}
+  bool insert(uint64_t at,Source source){
+    if(channels<=0 || source->size()%channels)return false;
+    Clip clip;
+    clip.channels=channels;
+    clip.root=makePiece(source,0,source->size()/channels);
+    return paste(at,clip);
+  }
+
+  // Overwrite [start,start+frames of samples) without changing the length elsewhere
+  bool replace(uint64_t start,const std::vector<float>& samples){
+    if(channels<=0 || samples.size()%channels)return false;
+    erase(start,start+samples.size()/channels);
+    return insert(start,samples);
+  }
+
+  // Whole edit as a clip (an undo point) and back
+  inline Clip state()const{Clip c;c.root=root;c.channels=channels;return c;}
+  void restore(const Clip& c){root=c.root;channels=c.channels;}
+
+  // Read frames from the editor's current version (not the published one)
+  inline size_t read(uint64_t frame,float *out,size_t count)const{return readFrom(root.get(),channels,frame,out,count);}
+
+  // Contiguous copy, e.g. for saving or for analysis that wants a flat buffer
+  std::vector<float>render()const{
+    std::vector<float>out(static_cast<size_t>(frames()*channels));
+    render(root.get(),out.data());
+    return out;
+  }
+
+  // Make the current version the one the callback plays, and free what it has left
+  void publish(){published.publish(std::make_shared<const Snapshot>(Snapshot{root,channels,frames()}));}
+  // Free replaced versions the callback is no longer on; also called by publish()
+  inline void collect(){published.collect();}
+
+  // ---------------- Playback thread (single reader) ----------------
+  // Pin the published snapshot for one callback; pair with release()
+  inline const Snapshot* acquire(){return published.acquire();}
+  inline void release(){published.release();}
+
+  // Copy count frames starting at frame; returns the frames copied
+  static inline size_t read(const Snapshot *s,uint64_t frame,float *out,size_t count){
+    return s?readFrom(s->root.get(),s->channels,frame,out,count):0;
+  }
+
+  private:
+  NodePtr makePiece(const Source& source,uint64_t firstFrame,uint64_t length){
+    if(length==0 || channels<=0)return nullptr;
+    auto n=std::make_shared<Node>();
+    n->source=source;
+    n->data=source->data()+firstFrame*channels;
+    n->length=length;
+    n->total=length;
+    n->priority=nextPriority();
+    return n;
+  }
+
+  NodePtr makePiece(const Node *piece,uint64_t offset,uint64_t length)const{
+    auto n=std::make_shared<Node>();
+    n->source=piece->source;
+    n->data=piece->data+offset*channels;
+    n->length=length;
+    n->total=length;
+    n->priority=nextPriority();
+    return n;
+  }
+
+  inline uint32_t nextPriority()const{
+    seed^=seed<<13;
+    seed^=seed>>17;
+    seed^=seed<<5;
+    return seed;
+  }
+
+  static inline uint64_t totalOf(const NodePtr& n){return n?n->total:0;}
+  static size_t count(const NodePtr& n){return n?1+count(n->left)+count(n->right):0;}
+
+  static NodePtr withChildren(const Node *n,NodePtr left,NodePtr right){
+    auto c=std::make_shared<Node>(*n);
+    c->left=std::move(left);
+    c->right=std::move(right);
+    c->total=totalOf(c->left)+c->length+totalOf(c->right);
+    return c;
+  }
+
+  inline void clampRange(uint64_t& start,uint64_t& end)const{
+    end=std::min(end,frames());
+    start=std::min(start,end);
+  }
+
+  // First k frames and the rest; only the path to frame k is copied
+  std::pair<NodePtr,NodePtr>split(const NodePtr& t,uint64_t k)const{
+    if(!t)return {nullptr,nullptr};
+    if(k==0)return {nullptr,t};
+    if(k>=t->total)return {t,nullptr};
+    const uint64_t leftTotal=totalOf(t->left);
+    if(k<=leftTotal){
+      auto p=split(t->left,k);
+      return {p.first,withChildren(t.get(),p.second,t->right)};
+    }
+    if(k>=leftTotal+t->length){
+      auto p=split(t->right,k-leftTotal-t->length);
+      return {withChildren(t.get(),t->left,p.first),p.second};
+    }
+    // inside this piece: cut it in two
+    const uint64_t offset=k-leftTotal;
+    return {merge(t->left,makePiece(t.get(),0,offset)),merge(makePiece(t.get(),offset,t->length-offset),t->right)};
+  }
+
+  static NodePtr merge(const NodePtr& a,const NodePtr& b){
+    if(!a)return b;
+    if(!b)return a;
+    if(a->priority>b->priority)return withChildren(a.get(),a->left,merge(a->right,b));
+    return withChildren(b.get(),merge(a,b->left),b->right);
+  }
+
+  // O(log n) per piece crossed; no allocation, safe on the audio thread
+  static size_t readFrom(const Node *root,int numChannels,uint64_t frame,float *out,size_t count){
+    if(!root || numChannels<=0)return 0;
+    size_t done=0;
+    while(done<count && frame<root->total){
+      const Node *n=root;
+      uint64_t offset=frame;
+      for(;;){
+        const uint64_t leftTotal=n->left?n->left->total:0;
+        if(offset<leftTotal){n=n->left.get();continue;}
+        offset-=leftTotal;
+        if(offset<n->length)break;
+        offset-=n->length;
+        n=n->right.get();
+      }
+      const size_t take=static_cast<size_t>(std::min<uint64_t>(count-done,n->length-offset));
+      std::copy(n->data+offset*numChannels,n->data+(offset+take)*numChannels,out+done*numChannels);
+      done+=take;
+      frame+=take;
+    }
+    return done;
+  }
+
+  float* render(const Node *n,float *out)const{
+    if(!n)return out;
+    out=render(n->left.get(),out);
+    out=std::copy(n->data,n->data+n->length*channels,out);
+    return render(n->right.get(),out);
+  }
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "fft.hpp"
+#include "lockfree.hpp"
+#include "parallel.hpp"
+
+// Pitch search settings
+struct PitchConfig{
+  float minFrequency=50.0f;
+  float maxFrequency=2000.0f;
+  float threshold=0.15f; // YIN absolute threshold on the normalized difference
+  size_t hop=512;        // frames between track points
+};
+
+struct PitchFrame{
+  double time{};     // seconds, frame center
+  float frequency{}; // Hz, 0 when unvoiced
+  float clarity{};   // 1 - normalized difference at the chosen lag
+};
+
+/*
+ * YIN pitch detector
+ *
+ * The difference function d(tau)=sum (x[j]-x[j+tau])^2 is expanded as
+ * energy terms from a prefix sum of squares minus twice the autocorrelation,
+ * and the autocorrelation comes from two real FFTs (power spectrum, then its
+ * transform), so a frame costs O(W log W) instead of O(W^2). All buffers are
+ * sized by configure(); detect() does not allocate. One detector per thread.
+*/
+class PitchDetector{
+  private:
+  PitchConfig config;
+  uint32_t sampleRate=0;
+  size_t window=0;   // analysis frame length W (power of two)
+  size_t minLag=2,maxLag=2;
+  FFT fft;           // size 2W: linear, not circular, correlation
+  std::vector<float>padded,spectrum,re,im,prefix,diff;
+
+  public:
+  PitchDetector(){}
+  PitchDetector(uint32_t rate,const PitchConfig& cfg=PitchConfig{}){configure(rate,cfg);}
+
+  bool configure(uint32_t rate,const PitchConfig& cfg=PitchConfig{}){
+    if(rate==0 || cfg.minFrequency<=0.0f || cfg.maxFrequency<=cfg.minFrequency || cfg.hop==0)return false;
+    config=cfg;
+    sampleRate=rate;
+    maxLag=static_cast<size_t>(std::ceil(rate/cfg.minFrequency))+1;
+    minLag=std::max<size_t>(2,static_cast<size_t>(rate/cfg.maxFrequency));
+    window=64;
+    while(window<2*maxLag)window<<=1;
+    fft.init(2*window);
+    padded.assign(2*window,0.0f);
+    spectrum.assign(2*window,0.0f);
+    re.assign(window+1,0.0f);
+    im.assign(window+1,0.0f);
+    prefix.assign(window+1,0.0f);
+    diff.assign(maxLag+2,0.0f);
+    return true;
+  }
+
+  inline size_t frameSize()const{return window;}
+  inline size_t getHop()const{return config.hop;}
+  inline uint32_t getSampleRate()const{return sampleRate;}
+
+  // frame holds frameSize() mono samples; returns Hz, or 0 when unvoiced/silent
+  float detect(const float *frame,float *clarity=nullptr){
+    if(clarity)*clarity=0.0f;
+    if(window==0)return 0.0f;
+    const size_t n=2*window;
+
+    float mean=0.0f;
+    for(size_t j=0;j<window;++j)mean+=frame[j];
+    mean/=window;
+    prefix[0]=0.0f;
+    for(size_t j=0;j<window;++j){
+      const float v=frame[j]-mean;
+      padded[j]=v;
+      prefix[j+1]=prefix[j]+v*v;
+    }
+    if(prefix[window]<1e-8f*window)return 0.0f;
+
+    // autocorrelation = inverse transform of |X|^2; it is real and even, so a forward transform does
+    fft.forwardReal(padded.data(),re.data(),im.data());
+    for(size_t k=0;k<=window;++k)spectrum[k]=re[k]*re[k]+im[k]*im[k];
+    for(size_t k=1;k<window;++k)spectrum[n-k]=spectrum[k];
+    fft.forwardReal(spectrum.data(),re.data(),im.data());
+    const float invN=1.0f/n;
+
+    // cumulative mean normalized difference, overlap-compensated
+    diff[0]=1.0f;
+    float running=0.0f;
+    const float total=prefix[window];
+    for(size_t tau=1;tau<=maxLag;++tau){
+      const float energy=prefix[window-tau]+(total-prefix[tau]);
+      const float d=std::max(0.0f,energy-2.0f*re[tau]*invN)*window/(window-tau);
+      running+=d;
+      diff[tau]=running>0.0f?d*tau/running:1.0f;
+    }
+
+    size_t best=0;
+    for(size_t tau=minLag;tau<maxLag;++tau){
+      if(diff[tau]<config.threshold){
+        while(tau+1<maxLag && diff[tau+1]<diff[tau])++tau;
+        best=tau;
+        break;
+      }
+    }
+    if(best==0){
+      if(clarity){
+        float lowest=1.0f;
+        for(size_t tau=minLag;tau<maxLag;++tau)lowest=std::min(lowest,diff[tau]);
+        *clarity=std::max(0.0f,1.0f-lowest);
+      }
+      return 0.0f;
+    }
+
+    // parabolic refinement of the lag
+    float lag=static_cast<float>(best);
+    const float a=diff[best-1],b=diff[best],c=diff[best+1];
+    const float denom=a-2.0f*b+c;
+    if(denom>1e-12f)lag+=std::max(-0.5f,std::min(0.5f,0.5f*(a-c)/denom));
+    if(clarity)*clarity=std::max(0.0f,1.0f-b);
+    return sampleRate/lag;
+  }
+
+  // Frame-by-frame track over interleaved samples, frames split across threads
+  static std::vector<PitchFrame>track(const std::vector<float>& samples,int channels,uint32_t rate,const PitchConfig& cfg=PitchConfig{},size_t threads=0){
+    std::vector<PitchFrame>out;
+    PitchDetector probe;
+    if(channels<=0 || !probe.configure(rate,cfg))return out;
+    const uint64_t frames=samples.size()/channels;
+    const size_t w=probe.frameSize();
+    if(frames<w)return out;
+    out.resize(static_cast<size_t>((frames-w)/cfg.hop+1));
+
+    parallelRanges(out.size(),16,[&](size_t begin,size_t end){
+      PitchDetector detector(rate,cfg);
+      std::vector<float>mono(w);
+      const float mix=1.0f/channels;
+      for(size_t i=begin;i<end;++i){
+        const float *p=samples.data()+i*cfg.hop*channels;
+        if(channels==1)std::copy(p,p+w,mono.begin());
+        else for(size_t j=0;j<w;++j){
+          float v=0.0f;
+          for(int c=0;c<channels;++c)v+=p[j*channels+c];
+          mono[j]=v*mix;
+        }
+        PitchFrame& f=out[i];
+        f.time=(static_cast<double>(i*cfg.hop)+w*0.5)/rate;
+        f.frequency=detector.detect(mono.data(),&f.clarity);
+      }
+    },threads);
+    return out;
+  }
+
+  // Median of the voiced frames, 0 when nothing is pitched
+  static float summarize(const std::vector<PitchFrame>& pitchTrack,float minClarity=0.8f){
+    std::vector<float>voiced;
+    for(const PitchFrame& f:pitchTrack)if(f.frequency>0.0f && f.clarity>=minClarity)voiced.push_back(f.frequency);
+    if(voiced.empty())return 0.0f;
+    std::nth_element(voiced.begin(),voiced.begin()+voiced.size()/2,voiced.end());
+    return voiced[voiced.size()/2];
+  }
+
+  // Whole-file summary frequency; non-overlapping frames keep it cheap at load time
+  static float estimate(const std::vector<float>& samples,int channels,uint32_t rate){
+    PitchConfig cfg;
+    PitchDetector probe;
+    if(!probe.configure(rate,cfg))return 0.0f;
+    cfg.hop=probe.frameSize();
+    return summarize(track(samples,channels,rate,cfg));
+  }
+
+  // estimate() over an interleaved stream fed in blocks of any size (a page cache scan)
+  class Estimator;
+
+  // Nearest equal-tempered note, e.g. "A4", and the offset from it in cents
+  static std::string noteName(float frequency,float *cents=nullptr,float a4=440.0f){
+    if(cents)*cents=0.0f;
+    if(frequency<=0.0f)return "-";
+    static const char *names[]={"C","C#","D","D#","E","F","F#","G","G#","A","A#","B"};
+    const float midi=69.0f+12.0f*std::log2(frequency/a4);
+    const int note=static_cast<int>(std::lround(midi));
+    if(cents)*cents=(midi-note)*100.0f;
+    const int octave=note/12-1;
+    return std::string(names[((note%12)+12)%12])+std::to_string(octave);
+  }
+};
+
+class PitchDetector::Estimator{
+  private:
+  PitchDetector detector;
+  int channels=0;
+  std::vector<float>mono;
+  size_t fill=0;
+  std::vector<PitchFrame>frames;
+
+  public:
+  // Non-overlapping frames, like estimate()
+  Estimator(int numChannels,uint32_t rate):channels(std::max(numChannels,0)){
+    if(channels>0 && detector.configure(rate))mono.resize(detector.frameSize());
+  }
+
+  void push(const float *interleaved,size_t count){
+    if(mono.empty())return;
+    const float mix=1.0f/channels;
+    for(size_t i=0;i<count;++i){
+      float v=0.0f;
+      for(int c=0;c<channels;++c)v+=interleaved[i*channels+c];
+      mono[fill++]=channels==1?v:v*mix;
+      if(fill==mono.size()){
+        PitchFrame f;
+        f.frequency=detector.detect(mono.data(),&f.clarity);
+        frames.push_back(f);
+        fill=0;
+      }
+    }
+  }
+
+  inline float finish()const{return PitchDetector::summarize(frames);}
+};
+
+/*
+ * Real-time tuner
+ *
+ * push() runs in the audio callback and only mixes to mono into a lock-free
+ * FIFO (samples are dropped if the reader falls behind). update() runs on the
+ * UI side: it drains the FIFO into a sliding frame and re-detects every hop.
+*/
+class Tuner{
+  private:
+  PitchDetector detector;
+  SpscQueue<float>fifo;
+  std::vector<float>history,incoming;
+  size_t fresh=0;
+  float frequency=0.0f;
+  float clarity=0.0f;
+
+  public:
+  Tuner(uint32_t rate,const PitchConfig& cfg=PitchConfig{}):detector(rate,cfg),fifo(std::max<size_t>(rate/2,4096)){
+    history.assign(detector.frameSize(),0.0f);
+  }
+
+  Tuner(const Tuner&)=delete;
+  Tuner& operator=(const Tuner&)=delete;
+
+  // Audio thread
+  void push(const float *interleaved,unsigned long frames,int channels){
+    if(channels<=0)return;
+    const float mix=1.0f/channels;
+    for(unsigned long f=0;f<frames;++f){
+      float v=0.0f;
+      for(int c=0;c<channels;++c)v+=interleaved[f*channels+c];
+      if(!fifo.push(v*mix))return;
+    }
+  }
+
+  // UI thread, returns true when a new estimate was made
+  bool update(){
+    const size_t w=history.size();
+    if(w==0)return false;
+    float v;
+    incoming.clear();
+    while(fifo.pop(v))incoming.push_back(v);
+    const size_t got=incoming.size();
+    if(got==0)return false;
+    if(got>=w)std::copy(incoming.end()-w,incoming.end(),history.begin());
+    else{
+      std::copy(history.begin()+got,history.end(),history.begin());
+      std::copy(incoming.begin(),incoming.end(),history.end()-got);
+    }
+    fresh+=got;
+    if(fresh<detector.getHop())return false;
+    fresh=0;
+    frequency=detector.detect(history.data(),&clarity);
+    return true;
+  }
+
+  inline float getFrequency()const{return frequency;}
+  inline float getClarity()const{return clarity;}
+  inline std::string getNoteName(float *cents=nullptr)const{return PitchDetector::noteName(frequency,cents);}
+};
@@ -0,0 +1,448 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sndfile.hh>
+
+#include "channel_map.hpp"
+#include "lockfree.hpp"
+#include "io.hpp"
+#include "parallel.hpp"
+#include "peaks.hpp"
+#include "resampler.hpp"
+
+// Decoded-once audio shared by every clip that plays it
+struct ClipSource{
+  std::string path;            // empty for generated/recorded material
+  int channels=0;
+  uint32_t sampleRate=0;
+  uint64_t frames=0;
+  std::vector<float>samples;   // interleaved, at the project rate
+  // Or frames read in place from a mapped project file, kept alive by mapping
+  const float *mapped=nullptr;
+  std::shared_ptr<const void>mapping;
+  // Overview for drawing clips; read back from the project file when it was cached there
+  std::shared_ptr<const PeakPyramid>peaks;
+
+  inline const float* data()const{return mapped?mapped:samples.data();}
+};
+
+struct Clip{
+  enum class FadeCurve:int{
+    Linear=0,
+    EqualPower=1
+  };
+
+  uint32_t id=0;
+  int track=0;
+  std::shared_ptr<const ClipSource>source;
+  uint64_t position=0;   // timeline frame of the first frame played
+  uint64_t offset=0;     // first source frame played
+  uint64_t length=0;     // frames played
+  float gain=1.0f;
+  uint64_t fadeIn=0;     // frames
+  uint64_t fadeOut=0;
+  FadeCurve fadeCurve=FadeCurve::Linear;
+  bool muted=false;
+
+  inline uint64_t end()const{return position+length;}
+};
+
+struct Track{
+  std::string name;
+  float gain=1.0f;
+  float pan=0.0f;        // -1=left, 1=right (stereo only)
+  bool muted=false;
+  bool solo=false;
+};
+
+/*
+ * Source pool
+ *
+ * Each file is decoded (and brought to the project rate) once; clips share the
+ * result. Sources stay cached while any clip or the pool itself holds them.
+*/
+class SourcePool{
+  private:
+  std::map<std::string,std::shared_ptr<const ClipSource>>sources;
+
+  public:
+  std::shared_ptr<const ClipSource>load(const std::string& path,uint32_t projectRate){
+    auto it=sources.find(path);
+    if(it!=sources.end())return it->second;
+
+    SF_INFO info;
+    SNDFILE *file=openSoundFile(path,info);
+    if(!file)return nullptr;
+    std::vector<float>samples(static_cast<size_t>(info.frames*info.channels));
+    const sf_count_t got=sf_readf_float(file,samples.data(),info.frames);
+    sf_close(file);
+    samples.resize(static_cast<size_t>(std::max<sf_count_t>(got,0)*info.channels));
+
+    auto source=make(std::move(samples),info.channels,static_cast<uint32_t>(info.samplerate),projectRate);
+    if(!source)return nullptr;
+    std::const_pointer_cast<ClipSource>(source)->path=path;
+    sources[path]=source;
+    return source;
+  }
+
+  // Wrap a buffer (a recording, a render) as a source
+  static std::shared_ptr<const ClipSource>make(std::vector<float>samples,int channels,uint32_t rate,uint32_t projectRate){
+    if(channels<=0 || rate==0 || projectRate==0)return nullptr;
+    auto source=std::make_shared<ClipSource>();
+    source->channels=channels;
+    source->sampleRate=projectRate;
+    source->samples=rate==projectRate?std::move(samples):resample(samples,channels,rate,projectRate);
+    source->frames=source->samples.size()/channels;
+    return source;
+  }
+
+  // Drop sources no clip refers to any more
+  void purge(){
+    for(auto it=sources.begin();it!=sources.end();)it=it->second.use_count()==1?sources.erase(it):std::next(it);
+  }
+
+  inline size_t size()const{return sources.size();}
+
+  private:
+  // Same windowed sinc as the batch converter, so clips at another rate sound as clean as converted files
+  static std::vector<float>resample(const std::vector<float>& in,int channels,uint32_t from,uint32_t to){
+    Resampler resampler;
+    resampler.configure(channels,from,to);
+    std::vector<float>out;
+    out.reserve(static_cast<size_t>((in.size()/channels*static_cast<uint64_t>(to)/from+1)*channels));
+    resampler.process(in.data(),in.size()/channels,out);
+    resampler.flush(out);
+    return out;
+  }
+};
+
+/*
+ * Arrangement
+ *
+ * Immutable, render-ready view of a project: the clips that can sound (mute
+ * and solo already applied) sorted by position, with track gain and pan
+ * folded into per-channel gains (and, for a source of another channel count,
+ * into the ChannelMap matrix the batch converter uses). An implicit interval
+ * tree (max end per subtree, over the sorted array) finds the clips
+ * overlapping a block in O(log n + k), so a block costs the same whether the
+ * session holds ten clips or a thousand. render() does not allocate or lock
+ * and may run on the audio thread or on many bounce threads at once.
+*/
+class Arrangement{
+  public:
+  static constexpr int MAX_CHANNELS=8;
+
+  struct Entry{
+    Clip clip;
+    float channelGain[MAX_CHANNELS]{};
+    std::vector<float>matrix;   // [out*sourceChannels+in] with channelGain applied; empty when the counts match
+  };
+
+  private:
+  uint32_t sampleRate=0;
+  int channels=0;
+  uint64_t totalFrames=0;
+  std::vector<Entry>entries;
+  std::vector<uint64_t>maxEnd;   // implicit tree, stored at each subtree's middle
+
+  public:
+  Arrangement(){}
+  Arrangement(const std::vector<Track>& tracks,const std::vector<Clip>& clips,uint32_t rate,int numChannels){
+    sampleRate=rate;
+    channels=std::min(std::max(numChannels,0),MAX_CHANNELS);
+    bool anySolo=false;
+    for(const Track& t:tracks)anySolo=anySolo || t.solo;
+    for(const Clip& c:clips){
+      if(c.track<0 || c.track>=static_cast<int>(tracks.size()))continue;
+      const Track& t=tracks[c.track];
+      if(c.muted || t.muted || (anySolo && !t.solo) || !c.source || c.length==0)continue;
+      Entry e;
+      e.clip=c;
+      for(int ch=0;ch<channels;++ch){
+        float g=t.gain*c.gain;
+        if(channels==2)g*=std::min(1.0f,ch==0?1.0f-t.pan:1.0f+t.pan);
+        e.channelGain[ch]=g;
+      }
+      const int sc=c.source->channels;
+      if(sc!=channels && channels>0){
+        // sources carry no speaker mask: the usual layout for their channel count
+        e.matrix=ChannelMap::matrix(0,sc,channels);
+        for(int ch=0;ch<channels;++ch)for(int k=0;k<sc;++k)e.matrix[ch*sc+k]*=e.channelGain[ch];
+      }
+      entries.push_back(std::move(e));
+    }
+    std::stable_sort(entries.begin(),entries.end(),[](const Entry& a,const Entry& b){return a.clip.position<b.clip.position;});
+    maxEnd.assign(entries.size(),0);
+    build(0,entries.size());
+    for(const Clip& c:clips)totalFrames=std::max(totalFrames,c.end());
+  }
+
+  inline uint32_t getSampleRate()const{return sampleRate;}
+  inline int getChannels()const{return channels;}
+  inline uint64_t frames()const{return totalFrames;}
+  inline size_t size()const{return entries.size();}
+
+  // fn(const Entry&) for every sounding clip overlapping [startFrame,endFrame), in position order
+  template<typename Fn>
+  void forEachActive(uint64_t startFrame,uint64_t endFrame,Fn fn)const{
+    if(startFrame<endFrame)visit(0,entries.size(),startFrame,endFrame,fn);
+  }
+
+  // Mix frames [startFrame,startFrame+frames) into out (overwritten)
+  void render(uint64_t startFrame,float *out,size_t frames)const{
+    std::fill(out,out+frames*channels,0.0f);
+    forEachActive(startFrame,startFrame+frames,[&](const Entry& e){mix(e,startFrame,out,frames);});
+  }
+
+  // Whole range across cores; each range renders independently
+  std::vector<float>bounce(uint64_t startFrame=0,uint64_t endFrame=UINT64_MAX,size_t threads=0)const{
+    endFrame=std::min(endFrame,totalFrames);
+    if(startFrame>=endFrame)return {};
+    std::vector<float>out(static_cast<size_t>((endFrame-startFrame)*channels));
+    const size_t block=1<<16;
+    const size_t blocks=static_cast<size_t>((endFrame-startFrame+block-1)/block);
+    parallelRanges(blocks,1,[&](size_t begin,size_t end){
+      for(size_t b=begin;b<end;++b){
+        const uint64_t f0=startFrame+b*block;
+        render(f0,out.data()+(f0-startFrame)*channels,static_cast<size_t>(std::min<uint64_t>(block,endFrame-f0)));
+      }
+    },threads);
+    return out;
+  }
+
+  private:
+  uint64_t build(size_t lo,size_t hi){
+    if(lo>=hi)return 0;
+    const size_t mid=lo+(hi-lo)/2;
+    const uint64_t m=std::max({entries[mid].clip.end(),build(lo,mid),build(mid+1,hi)});
+    maxEnd[mid]=m;
+    return m;
+  }
+
+  template<typename Fn>
+  void visit(size_t lo,size_t hi,uint64_t s,uint64_t e,Fn& fn)const{
+    if(lo>=hi)return;
+    const size_t mid=lo+(hi-lo)/2;
+    if(maxEnd[mid]<=s)return;    // everything below ends before the block
+    visit(lo,mid,s,e,fn);
+    const Clip& c=entries[mid].clip;
+    if(c.position>=e)return;     // this clip and all to its right start after it
+    if(c.end()>s)fn(entries[mid]);
+    visit(mid+1,hi,s,e,fn);
+  }
+
+  void mix(const Entry& e,uint64_t startFrame,float *out,size_t frames)const{
+    const Clip& c=e.clip;
+    const ClipSource& src=*c.source;
+    const uint64_t from=std::max(startFrame,c.position);
+    const uint64_t to=std::min({startFrame+frames,c.end(),c.position+(src.frames>c.offset?src.frames-c.offset:0)});
+    const int sc=src.channels;
+    for(uint64_t t=from;t<to;++t){
+      const uint64_t rel=t-c.position;
+      const float env=envelope(c,rel);
+      const float *in=src.data()+(c.offset+rel)*sc;
+      float *o=out+(t-startFrame)*channels;
+      if(sc==channels){
+        for(int ch=0;ch<channels;++ch)o[ch]+=in[ch]*e.channelGain[ch]*env;
+      }else{
+        const float *row=e.matrix.data();
+        for(int ch=0;ch<channels;++ch,row+=sc){
+          float m=0.0f;
+          for(int k=0;k<sc;++k)m+=in[k]*row[k];
+          o[ch]+=m*env;
+        }
+      }
+    }
+  }
+
+  static inline float envelope(const Clip& c,uint64_t rel){
+    double t=1.0;
+    if(rel<c.fadeIn)t=(rel+0.5)/c.fadeIn;
+    if(rel+c.fadeOut>=c.length)t=std::min(t,(c.length-rel-0.5)/c.fadeOut);
+    if(t>=1.0)return 1.0f;
+    return static_cast<float>(c.fadeCurve==Clip::FadeCurve::EqualPower?std::sin(t*M_PI_2):t);
+  }
+};
+
+// Immutable copy of everything a project is made of, for saving off the UI thread
+struct Session{
+  uint32_t sampleRate=48000;
+  int channels=2;
+  std::vector<Track>tracks;
+  std::vector<Clip>clips;
+};
+
+/*
+ * Multi-track project
+ *
+ * Tracks of clips over shared sources. Every edit rebuilds the Arrangement
+ * (O(n log n) in the clip count, editor thread only) and publishes it, so
+ * playback picks up edits on its next block without locking. The same commit
+ * freezes a Session, so snapshot() for saving is a pointer copy.
+*/
+class Project{
+  private:
+  uint32_t sampleRate=48000;
+  int channels=2;
+  std::vector<Track>tracks;
+  std::vector<Clip>clips;
+  uint32_t nextId=1;
+  SourcePool pool;
+  SnapshotPublisher<Arrangement>published;
+  std::shared_ptr<const Session>session;
+  uint64_t revision=0;
+
+  public:
+  Project(uint32_t rate=48000,int numChannels=2):sampleRate(rate),channels(std::min(std::max(numChannels,1),Arrangement::MAX_CHANNELS)){commit();}
+  Project(const Project&)=delete;
+  Project& operator=(const Project&)=delete;
+
+  inline uint32_t getSampleRate()const{return sampleRate;}
+  inline int getChannels()const{return channels;}
+  inline SourcePool& getSources(){return pool;}
+  inline const std::vector<Track>& getTracks()const{return tracks;}
+  inline const std::vector<Clip>& getClips()const{return clips;}
+  inline uint64_t frames()const{return arrangement().frames();}
+  inline double getDuration()const{return static_cast<double>(frames())/sampleRate;}
+  // Bumped by every edit
+  inline uint64_t getRevision()const{return revision;}
+  // O(1); safe to hand to another thread
+  inline std::shared_ptr<const Session>snapshot()const{return session;}
+
+  // Replace the whole session at once (loading), one rebuild
+  void assign(uint32_t rate,int numChannels,const std::vector<Track>& newTracks,const std::vector<Clip>& newClips){
+    sampleRate=rate;
+    channels=std::min(std::max(numChannels,1),Arrangement::MAX_CHANNELS);
+    tracks=newTracks;
+    clips=newClips;
+    nextId=1;
+    for(const Clip& c:clips)nextId=std::max(nextId,c.id+1);
+    commit();
+  }
+
+  // ---------------- Tracks ----------------
+  int addTrack(const std::string& name){
+    tracks.push_back(Track{name});
+    commit();
+    return static_cast<int>(tracks.size())-1;
+  }
+
+  bool removeTrack(int track){
+    if(!validTrack(track))return false;
+    tracks.erase(tracks.begin()+track);
+    clips.erase(std::remove_if(clips.begin(),clips.end(),[track](const Clip& c){return c.track==track;}),clips.end());
+    for(Clip& c:clips)if(c.track>track)--c.track;
+    commit();
+    return true;
+  }
+
+  // Change gain/pan/mute/solo
+  bool setTrack(int track,const Track& t){
+    if(!validTrack(track))return false;
+    tracks[track]=t;
+    commit();
+    return true;
+  }
+
+  // ---------------- Clips ----------------
+  // Returns the clip id, 0 on failure. length is clamped to the source.
+  uint32_t addClip(int track,const std::shared_ptr<const ClipSource>& source,uint64_t position,uint64_t offset=0,uint64_t length=UINT64_MAX){
+    if(!validTrack(track) || !source || offset>=source->frames)return 0;
+    Clip c;
+    c.id=nextId++;
+    c.track=track;
+    c.source=source;
+    c.position=position;
+    c.offset=offset;
+    c.length=std::min(length,source->frames-offset);
+    clips.push_back(c);
+    commit();
+    return c.id;
+  }
+
+  uint32_t addClip(int track,const std::string& path,uint64_t position){
+    return addClip(track,pool.load(path,sampleRate),position);
+  }
+
+  bool removeClip(uint32_t id){
+    auto it=std::find_if(clips.begin(),clips.end(),[id](const Clip& c){return c.id==id;});
+    if(it==clips.end())return false;
+    clips.erase(it);
+    commit();
+    return true;
+  }
+
+  bool moveClip(uint32_t id,uint64_t position,int track=-1){
+    Clip *c=findClip(id);
+    if(!c || (track>=0 && !validTrack(track)))return false;
+    c->position=position;
+    if(track>=0)c->track=track;
+    commit();
+    return true;
+  }
+
+  // Slip/trim: which part of the source plays
+  bool trimClip(uint32_t id,uint64_t offset,uint64_t length){
+    Clip *c=findClip(id);
+    if(!c || offset>=c->source->frames)return false;
+    c->offset=offset;
+    c->length=std::min(length,c->source->frames-offset);
+    // fades never run past the clip, same as setClip()
+    c->fadeIn=std::min(c->fadeIn,c->length);
+    c->fadeOut=std::min(c->fadeOut,c->length);
+    commit();
+    return true;
+  }
+
+  // Replace gain/fades/mute (source, position and track are kept)
+  bool setClip(uint32_t id,float gain,uint64_t fadeIn,uint64_t fadeOut,Clip::FadeCurve curve=Clip::FadeCurve::Linear,bool muted=false){
+    Clip *c=findClip(id);
+    if(!c)return false;
+    c->gain=gain;
+    c->fadeIn=std::min(fadeIn,c->length);
+    c->fadeOut=std::min(fadeOut,c->length);
+    c->fadeCurve=curve;
+    c->muted=muted;
+    commit();
+    return true;
+  }
+
+  inline const Clip* getClip(uint32_t id)const{
+    auto it=std::find_if(clips.begin(),clips.end(),[id](const Clip& c){return c.id==id;});
+    return it==clips.end()?nullptr:&*it;
+  }
+
+  // ---------------- Rendering ----------------
+  // Latest arrangement, for editor-side rendering and bouncing
+  inline const Arrangement& arrangement()const{return *published.latest();}
+
+  inline std::vector<float>bounce(uint64_t startFrame=0,uint64_t endFrame=UINT64_MAX,size_t threads=0)const{
+    return arrangement().bounce(startFrame,endFrame,threads);
+  }
+
+  // Playback thread: pin the current arrangement for one block, then release()
+  inline const Arrangement* acquire(){return published.acquire();}
+  inline void release(){published.release();}
+
+  private:
+  inline bool validTrack(int track)const{return track>=0 && track<static_cast<int>(tracks.size());}
+
+  Clip* findClip(uint32_t id){
+    auto it=std::find_if(clips.begin(),clips.end(),[id](const Clip& c){return c.id==id;});
+    return it==clips.end()?nullptr:&*it;
+  }
+
+  void commit(){
+    published.publish(std::make_shared<const Arrangement>(tracks,clips,sampleRate,channels));
+    session=std::make_shared<const Session>(Session{sampleRate,channels,tracks,clips});
+    ++revision;
+  }
+};
@@ -0,0 +1,598 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.hpp"
+#include "peaks.hpp"
+#include "project.hpp"
+
+/*
+ * Project container
+ *
+ * Append-only file of typed, id'd chunks (little-endian, payloads 16-byte
+ * aligned so sample data can be used in place):
+ *
+ *   Header   magic "SZPJ", version, offset/size of the committed index
+ *   Chunk    type, id, size, hash, payload ... (any number, any order)
+ *   Index    one entry per live chunk, itself stored as a chunk
+ *
+ * Saving appends the chunks whose contents changed, then a fresh index, and
+ * only then rewrites the header's index pointer, so a crash mid-save leaves
+ * the previous version intact. Opening maps the file and reads the header
+ * and the index alone; payloads are faulted in when first touched. Dead
+ * space from replaced chunks is reclaimed by compact().
+*/
+// Chunk type tag from four characters
+constexpr uint32_t fourcc(const char (&s)[5]){
+  return static_cast<uint32_t>(s[0]) | static_cast<uint32_t>(s[1])<<8 | static_cast<uint32_t>(s[2])<<16 | static_cast<uint32_t>(s[3])<<24;
+}
+
+class ProjectFile{
+  public:
+  static constexpr uint32_t MAGIC=fourcc("SZPJ");
+  static constexpr uint32_t VERSION=1;
+  static constexpr uint32_t INDEX=fourcc("INDX");
+  static constexpr uint32_t SETTINGS=fourcc("SETT");
+
+  struct Entry{
+    uint32_t type=0;
+    uint32_t reserved=0;
+    uint64_t id=0;
+    uint64_t offset=0;  // payload
+    uint64_t size=0;
+    uint64_t hash=0;
+  };
+
+  private:
+  struct Header{
+    uint32_t magic=MAGIC;
+    uint32_t version=VERSION;
+    uint64_t indexOffset=0;
+    uint64_t indexSize=0;
+    uint64_t generation=0;
+    uint8_t reserved[32]{};
+  };
+  struct ChunkHeader{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t id;
+    uint64_t size;
+    uint64_t hash;
+  };
+
+  // One read-only view of the file; sources mapped from it keep it alive
+  struct Mapping{
+    void *base=MAP_FAILED;
+    size_t size=0;
+    ~Mapping(){if(base!=MAP_FAILED)munmap(base,size);}
+  };
+
+  std::string path;
+  int fd=-1;
+  Header header;
+  uint64_t endOffset=0;                 // where the next chunk goes
+  std::map<std::pair<uint32_t,uint64_t>,Entry>index;
+  bool changed=false;
+  std::shared_ptr<const Mapping>mapping;
+
+  public:
+  ProjectFile(){}
+  ProjectFile(const ProjectFile&)=delete;
+  ProjectFile& operator=(const ProjectFile&)=delete;
+  ~ProjectFile(){close();}
+
+  // Open or create; an existing file is mapped and only its index is read
+  bool open(const std::string& filePath){
+    close();
+    path=filePath;
+    fd=::open(path.c_str(),O_RDWR | O_CREAT,0644);
+    if(fd<0){
+      std::cerr << "Error opening project: " << path << std::endl;
+      return false;
+    }
+    struct stat st{};
+    fstat(fd,&st);
+    if(st.st_size==0){
+      header=Header{};
+      endOffset=align(sizeof(Header));
+      return writeHeader();
+    }
+    if(static_cast<size_t>(st.st_size)<sizeof(Header) || preadAll(fd,&header,sizeof(header),0)!=sizeof(header) || header.magic!=MAGIC){
+      std::cerr << "Not a SizzleFX project: " << path << std::endl;
+      close();
+      return false;
+    }
+    if(header.version>VERSION){
+      std::cerr << "Project was saved by a newer version: " << path << std::endl;
+      close();
+      return false;
+    }
+    endOffset=align(static_cast<uint64_t>(st.st_size));
+    if(!remap())return false;
+    if(header.indexSize){
+      const uint8_t *p=payload(header.indexOffset,header.indexSize);
+      if(!p || header.indexSize%sizeof(Entry)){
+        std::cerr << "Damaged project index: " << path << std::endl;
+        close();
+        return false;
+      }
+      for(size_t i=0;i<header.indexSize/sizeof(Entry);++i){
+        Entry e;
+        std::memcpy(&e,p+i*sizeof(Entry),sizeof(Entry));
+        index[{e.type,e.id}]=e;
+      }
+    }
+    return true;
+  }
+
+  void close(){
+    if(fd>=0)::close(fd);
+    fd=-1;
+    index.clear();
+    mapping.reset();
+    changed=false;
+  }
+
+  inline bool isOpen()const{return fd>=0;}
+  inline const std::string& getPath()const{return path;}
+  inline uint64_t getGeneration()const{return header.generation;}
+  inline bool hasChanges()const{return changed;}
+
+  // ---------------- Reading ----------------
+  inline bool has(uint32_t type,uint64_t id)const{return index.count({type,id})!=0;}
+
+  // Payload in the mapping (valid while the mapping lives; see storage())
+  const uint8_t* read(uint32_t type,uint64_t id,size_t *size=nullptr){
+    auto it=index.find({type,id});
+    if(it==index.end())return nullptr;
+    if(size)*size=static_cast<size_t>(it->second.size);
+    return payload(it->second.offset,it->second.size);
+  }
+
+  std::vector<uint64_t>ids(uint32_t type)const{
+    std::vector<uint64_t>out;
+    for(auto it=index.lower_bound({type,0});it!=index.end() && it->first.first==type;++it)out.push_back(it->first.second);
+    return out;
+  }
+
+  // Keeps the current mapping (and any pointer from read()) alive
+  inline std::shared_ptr<const void>storage()const{return mapping;}
+
+  // ---------------- Writing ----------------
+  // Append unless a chunk with the same contents is already stored
+  bool write(uint32_t type,uint64_t id,const void *data,size_t size){
+    const uint64_t hash=fnv1a(data,size);
+    auto it=index.find({type,id});
+    if(it!=index.end() && it->second.size==size && it->second.hash==hash)return true;
+    return append(type,id,data,size,hash);
+  }
+
+  // For immutable contents (source audio): skipped, without hashing, once stored
+  bool writeOnce(uint32_t type,uint64_t id,const void *data,size_t size){
+    if(has(type,id))return true;
+    return append(type,id,data,size,fnv1a(data,size));
+  }
+
+  void remove(uint32_t type,uint64_t id){changed|=index.erase({type,id})!=0;}
+
+  // Make everything written so far the file's contents
+  bool commit(){
+    if(fd<0)return false;
+    if(!changed)return true;
+    std::vector<Entry>entries;
+    entries.reserve(index.size());
+    for(const auto& kv:index)entries.push_back(kv.second);
+    const uint64_t at=endOffset+sizeof(ChunkHeader);
+    const size_t bytes=entries.size()*sizeof(Entry);
+    if(!appendRaw(INDEX,0,entries.data(),bytes,fnv1a(entries.data(),bytes)))return false;
+    fdatasync(fd); // chunks and index on disk before the header points at them
+    header.indexOffset=at;
+    header.indexSize=bytes;
+    ++header.generation;
+    if(!writeHeader())return false;
+    fdatasync(fd);
+    changed=false;
+    return remap();
+  }
+
+  // Bytes referenced by the index vs. the whole file
+  uint64_t liveBytes()const{
+    uint64_t n=0;
+    for(const auto& kv:index)n+=kv.second.size;
+    return n;
+  }
+  inline uint64_t fileBytes()const{return endOffset;}
+
+  // Rewrite with only the live chunks (temp file + rename)
+  bool compact(){
+    if(fd<0)return false;
+    if(changed && !commit())return false;
+    const std::string tmp=path+".tmp";
+    std::remove(tmp.c_str());
+    {
+      ProjectFile out;
+      if(!out.open(tmp))return false;
+      for(const auto& kv:index){
+        const uint8_t *p=payload(kv.second.offset,kv.second.size);
+        if(!p || !out.append(kv.first.first,kv.first.second,p,static_cast<size_t>(kv.second.size),kv.second.hash))return false;
+      }
+      out.header.generation=header.generation;
+      if(!out.commit())return false;
+    }
+    if(std::rename(tmp.c_str(),path.c_str())!=0){
+      std::cerr << "Error replacing project: " << path << std::endl;
+      return false;
+    }
+    return open(path);
+  }
+
+  // ---------------- Settings ----------------
+  // key=value lines, so new settings never break old files
+  bool writeSettings(const std::map<std::string,std::string>& settings){
+    std::string text;
+    for(const auto& kv:settings)text+=kv.first+"="+kv.second+"\n";
+    return write(SETTINGS,0,text.data(),text.size());
+  }
+
+  std::map<std::string,std::string>readSettings(){
+    std::map<std::string,std::string>out;
+    size_t size=0;
+    const char *p=reinterpret_cast<const char*>(read(SETTINGS,0,&size));
+    if(!p)return out;
+    const std::string text(p,size);
+    size_t at=0;
+    while(at<text.size()){
+      size_t nl=text.find('\n',at);
+      if(nl==std::string::npos)nl=text.size();
+      const size_t eq=text.find('=',at);
+      if(eq<nl)out[text.substr(at,eq-at)]=text.substr(eq+1,nl-eq-1);
+      at=nl+1;
+    }
+    return out;
+  }
+
+  private:
+  static inline uint64_t align(uint64_t n){return (n+15) & ~uint64_t{15};}
+
+  static uint64_t fnv1a(const void *data,size_t size){
+    const uint8_t *p=static_cast<const uint8_t*>(data);
+    uint64_t h=1469598103934665603ull;
+    for(size_t i=0;i<size;++i){
+      h^=p[i];
+      h*=1099511628211ull;
+    }
+    return h;
+  }
+
+  bool append(uint32_t type,uint64_t id,const void *data,size_t size,uint64_t hash){
+    const uint64_t at=endOffset+sizeof(ChunkHeader);
+    if(!appendRaw(type,id,data,size,hash))return false;
+    index[{type,id}]=Entry{type,0,id,at,size,hash};
+    changed=true;
+    return true;
+  }
+
+  bool appendRaw(uint32_t type,uint64_t id,const void *data,size_t size,uint64_t hash){
+    const ChunkHeader ch{type,0,id,size,hash};
+    if(!pwriteAll(fd,&ch,sizeof(ch),endOffset) || !pwriteAll(fd,data,size,endOffset+sizeof(ch))){
+      std::cerr << "Error writing project: " << path << std::endl;
+      return false;
+    }
+    endOffset=align(endOffset+sizeof(ch)+size);
+    return true;
+  }
+
+  bool writeHeader(){
+    if(!pwriteAll(fd,&header,sizeof(header),0)){
+      std::cerr << "Error writing project header: " << path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Map the file as it is now; older mappings live on while anything holds them
+  bool remap(){
+    struct stat st{};
+    fstat(fd,&st);
+    auto m=std::make_shared<Mapping>();
+    m->size=static_cast<size_t>(st.st_size);
+    if(m->size){
+      m->base=mmap(nullptr,m->size,PROT_READ,MAP_SHARED,fd,0);
+      if(m->base==MAP_FAILED){
+        std::cerr << "Error mapping project: " << path << std::endl;
+        return false;
+      }
+    }
+    mapping=m;
+    return true;
+  }
+
+  const uint8_t* payload(uint64_t offset,uint64_t size){
+    // written since the last map (not committed yet): map again
+    if(!mapping || offset+size>mapping->size)remap();
+    if(!mapping || offset+size>mapping->size)return nullptr;
+    return static_cast<const uint8_t*>(mapping->base)+offset;
+  }
+};
+
+/*
+ * Project <-> container
+ *
+ * Chunks: "EDIT" the tracks and clips, "SRC " one per source (format and
+ * path), "AUDI" a source's samples when embedded, "PEAK" its peak pyramid,
+ * "SETT" settings. Sources are immutable, so their audio and peaks are
+ * written on the first save only; later saves append the edit list and
+ * whatever else changed. New sources get ids past every id already in the
+ * file, so saving into an existing container never lands on stale chunks.
+ * Embedded audio is used straight from the mapping when loading, and cached
+ * peaks come back as ClipSource::peaks, so opening a session reads neither
+ * its audio nor rescans it for drawing.
+*/
+class ProjectArchive{
+  public:
+  static constexpr uint32_t EDIT=fourcc("EDIT");
+  static constexpr uint32_t SOURCE=fourcc("SRC ");
+  static constexpr uint32_t AUDIO=fourcc("AUDI");
+  static constexpr uint32_t PEAKS=fourcc("PEAK");
+
+  private:
+  // ids of the sources this file already holds; held so an address is never reused for another source
+  std::map<const ClipSource*,std::pair<uint64_t,std::shared_ptr<const ClipSource>>>sourceIds;
+  uint64_t nextSource=1;
+
+  public:
+  // embedAudio=false stores file-backed sources by path only
+  bool save(ProjectFile& file,const Project& project,const std::map<std::string,std::string>& settings={},bool embedAudio=true){
+    return save(file,*project.snapshot(),settings,embedAudio);
+  }
+
+  // From a snapshot; may run on any thread as long as one archive/file pair is used by one thread at a time
+  bool save(ProjectFile& file,const Session& session,const std::map<std::string,std::string>& settings={},bool embedAudio=true){
+    if(!file.isOpen())return false;
+    std::vector<uint8_t>edit;
+    put(edit,session.sampleRate);
+    put(edit,static_cast<int32_t>(session.channels));
+    put(edit,static_cast<uint32_t>(session.tracks.size()));
+    for(const Track& t:session.tracks){
+      putString(edit,t.name);
+      put(edit,t.gain);
+      put(edit,t.pan);
+      put(edit,static_cast<uint8_t>(t.muted));
+      put(edit,static_cast<uint8_t>(t.solo));
+    }
+
+    // ids a different archive (an earlier session) left in this file are taken
+    for(uint32_t type:{SOURCE,AUDIO,PEAKS}){
+      for(uint64_t id:file.ids(type))nextSource=std::max(nextSource,id+1);
+    }
+
+    std::vector<const ClipSource*>live;
+    put(edit,static_cast<uint32_t>(session.clips.size()));
+    for(const Clip& c:session.clips){
+      uint64_t sid=0;
+      if(!saveSource(file,c.source,embedAudio,sid))return false;
+      live.push_back(c.source.get());
+      put(edit,c.id);
+      put(edit,static_cast<int32_t>(c.track));
+      put(edit,sid);
+      put(edit,c.position);
+      put(edit,c.offset);
+      put(edit,c.length);
+      put(edit,c.gain);
+      put(edit,c.fadeIn);
+      put(edit,c.fadeOut);
+      put(edit,static_cast<int32_t>(c.fadeCurve));
+      put(edit,static_cast<uint8_t>(c.muted));
+    }
+
+    // sources no clip uses any more drop out of the index
+    for(auto it=sourceIds.begin();it!=sourceIds.end();){
+      if(std::find(live.begin(),live.end(),it->first)!=live.end()){++it;continue;}
+      file.remove(SOURCE,it->second.first);
+      file.remove(AUDIO,it->second.first);
+      file.remove(PEAKS,it->second.first);
+      it=sourceIds.erase(it);
+    }
+
+    if(!file.write(EDIT,0,edit.data(),edit.size()))return false;
+    if(!settings.empty() && !file.writeSettings(settings))return false;
+    return file.commit();
+  }
+
+  bool load(ProjectFile& file,Project& project,std::map<std::string,std::string> *settings=nullptr){
+    sourceIds.clear();
+    nextSource=1;
+    size_t size=0;
+    const uint8_t *p=file.read(EDIT,0,&size);
+    if(!p){
+      std::cerr << "Project has no edit list: " << file.getPath() << std::endl;
+      return false;
+    }
+    Reader r{p,p+size};
+    uint32_t rate=0,trackCount=0,clipCount=0;
+    int32_t channels=0;
+    r.get(rate);
+    r.get(channels);
+    r.get(trackCount);
+    r.expect(trackCount,sizeof(uint32_t)+sizeof(Track::gain)+sizeof(Track::pan)+2);
+    if(!r.ok){
+      std::cerr << "Damaged edit list: " << file.getPath() << std::endl;
+      return false;
+    }
+    std::vector<Track>tracks(trackCount);
+    for(Track& t:tracks){
+      uint8_t muted=0,solo=0;
+      r.getString(t.name);
+      r.get(t.gain);
+      r.get(t.pan);
+      r.get(muted);
+      r.get(solo);
+      t.muted=muted;
+      t.solo=solo;
+    }
+
+    std::map<uint64_t,std::shared_ptr<const ClipSource>>sources;
+    r.get(clipCount);
+    r.expect(clipCount,sizeof(Clip::id)+sizeof(int32_t)+sizeof(uint64_t)+sizeof(Clip::position)+sizeof(Clip::offset)+sizeof(Clip::length)
+      +sizeof(Clip::gain)+sizeof(Clip::fadeIn)+sizeof(Clip::fadeOut)+sizeof(int32_t)+1);
+    std::vector<Clip>clips;
+    if(r.ok)clips.reserve(clipCount);
+    for(uint32_t i=0;i<clipCount && r.ok;++i){
+      Clip c;
+      uint64_t sid=0;
+      int32_t track=0,curve=0;
+      uint8_t muted=0;
+      r.get(c.id);
+      r.get(track);
+      r.get(sid);
+      r.get(c.position);
+      r.get(c.offset);
+      r.get(c.length);
+      r.get(c.gain);
+      r.get(c.fadeIn);
+      r.get(c.fadeOut);
+      r.get(curve);
+      r.get(muted);
+      c.track=track;
+      c.fadeCurve=static_cast<Clip::FadeCurve>(curve);
+      c.muted=muted;
+      auto& source=sources[sid];
+      if(!source)source=loadSource(file,project,sid,rate);
+      if(!source)continue; // missing referenced file: the clip is dropped
+      c.source=source;
+      clips.push_back(c);
+    }
+    if(!r.ok){
+      std::cerr << "Damaged edit list: " << file.getPath() << std::endl;
+      return false;
+    }
+    for(const auto& kv:sources)if(kv.second)sourceIds[kv.second.get()]={kv.first,kv.second};
+    for(const auto& kv:sources)nextSource=std::max(nextSource,kv.first+1);
+    project.assign(rate,channels,tracks,clips);
+    if(settings)*settings=file.readSettings();
+    return true;
+  }
+
+  // Cached peaks of a loaded source, false when none were stored (load() already sets ClipSource::peaks)
+  bool loadPeaks(ProjectFile& file,const ClipSource *source,PeakPyramid& peaks){
+    auto it=sourceIds.find(source);
+    size_t size=0;
+    const uint8_t *p=it==sourceIds.end()?nullptr:file.read(PEAKS,it->second.first,&size);
+    return p && peaks.deserialize(p,size) && peaks.getTotalFrames()==source->frames;
+  }
+
+  private:
+  struct Reader{
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok=true;
+    template<typename T>void get(T& v){
+      if(!ok || end-p<static_cast<ptrdiff_t>(sizeof(T))){ok=false;return;}
+      std::memcpy(&v,p,sizeof(T));
+      p+=sizeof(T);
+    }
+    void getString(std::string& s){
+      uint32_t n=0;
+      get(n);
+      if(!ok || end-p<static_cast<ptrdiff_t>(n)){ok=false;return;}
+      s.assign(reinterpret_cast<const char*>(p),n);
+      p+=n;
+    }
+    // count records of at least each bytes must fit in what is left
+    void expect(uint32_t count,size_t each){
+      if(ok && static_cast<uint64_t>(count)>static_cast<uint64_t>(end-p)/each)ok=false;
+    }
+  };
+
+  template<typename T>static void put(std::vector<uint8_t>& out,const T& v){
+    const uint8_t *b=reinterpret_cast<const uint8_t*>(&v);
+    out.insert(out.end(),b,b+sizeof(T));
+  }
+  static void putString(std::vector<uint8_t>& out,const std::string& s){
+    put(out,static_cast<uint32_t>(s.size()));
+    out.insert(out.end(),s.begin(),s.end());
+  }
+
+  bool saveSource(ProjectFile& file,const std::shared_ptr<const ClipSource>& source,bool embedAudio,uint64_t& sid){
+    auto it=sourceIds.find(source.get());
+    if(it!=sourceIds.end()){sid=it->second.first;return true;}
+    sid=nextSource++;
+    const bool embed=embedAudio || source->path.empty();
+    std::vector<uint8_t>info;
+    put(info,static_cast<int32_t>(source->channels));
+    put(info,source->sampleRate);
+    put(info,source->frames);
+    put(info,static_cast<uint8_t>(embed));
+    putString(info,source->path);
+    if(!file.writeOnce(SOURCE,sid,info.data(),info.size()))return false;
+    if(embed && !file.writeOnce(AUDIO,sid,source->data(),static_cast<size_t>(source->frames*source->channels*sizeof(float))))return false;
+    if(source->frames>0){
+      std::vector<uint8_t>bytes;
+      if(source->peaks)source->peaks->serialize(bytes);
+      else{
+        PeakPyramid peaks;
+        peaks.build(FrameSource([&](uint64_t frame,float *out,size_t count){
+          std::copy(source->data()+frame*source->channels,source->data()+(frame+count)*source->channels,out);
+          return count;
+        }),source->channels,source->frames);
+        peaks.serialize(bytes);
+      }
+      if(!file.writeOnce(PEAKS,sid,bytes.data(),bytes.size()))return false;
+    }
+    sourceIds[source.get()]={sid,source};
+    return true;
+  }
+
+  std::shared_ptr<const ClipSource>loadSource(ProjectFile& file,Project& project,uint64_t sid,uint32_t rate){
+    size_t size=0;
+    const uint8_t *p=file.read(SOURCE,sid,&size);
+    if(!p)return nullptr;
+    Reader r{p,p+size};
+    auto source=std::make_shared<ClipSource>();
+    int32_t channels=0;
+    uint8_t embedded=0;
+    r.get(channels);
+    r.get(source->sampleRate);
+    r.get(source->frames);
+    r.get(embedded);
+    r.getString(source->path);
+    source->channels=channels;
+    if(!r.ok || channels<=0)return nullptr;
+    if(!embedded){
+      std::shared_ptr<const ClipSource>pooled=project.getSources().load(source->path,rate);
+      // filled in only while nothing but the pool (and this call) holds the source
+      if(pooled && !pooled->peaks && pooled.use_count()==2)std::const_pointer_cast<ClipSource>(pooled)->peaks=readPeaks(file,sid,pooled->frames);
+      return pooled;
+    }
+
+    size_t bytes=0;
+    const uint8_t *audio=file.read(AUDIO,sid,&bytes);
+    if(!audio || bytes<source->frames*channels*sizeof(float))return nullptr;
+    source->mapped=reinterpret_cast<const float*>(audio);
+    source->mapping=file.storage();
+    source->peaks=readPeaks(file,sid,source->frames);
+    return source;
+  }
+
+  // nullptr when missing, damaged or not matching the source (then the owner rebuilds it)
+  static std::shared_ptr<const PeakPyramid>readPeaks(ProjectFile& file,uint64_t sid,uint64_t frames){
+    size_t size=0;
+    const uint8_t *p=file.read(PEAKS,sid,&size);
+    auto peaks=std::make_shared<PeakPyramid>();
+    if(!p || !peaks->deserialize(p,size) || peaks->getTotalFrames()!=frames)return nullptr;
+    return peaks;
+  }
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Streaming sample rate converter
+ *
+ * Windowed-sinc (Blackman) from a table of PHASES sub-sample positions,
+ * interpolated between neighbours. The filter spans HALF zero crossings of
+ * the lower rate each side, so when downsampling both the cutoff and the
+ * length scale with the ratio: the transition band stays the same fraction
+ * of the output rate and ends at its Nyquist, so nothing aliases. Input can
+ * arrive in blocks of any size; flush() pushes out the tail so the total
+ * output length is inputFrames*to/from.
+*/
+class Resampler{
+  public:
+  static constexpr int HALF=48;             // taps each side of the output position at 1:1 or up
+  static constexpr int PHASES=256;
+  static constexpr double CUTOFF=0.94;      // of the lower Nyquist; the window's transition band ends at it
+
+  private:
+  int channels=1;
+  int half=HALF;                            // HALF scaled by the downsampling ratio
+  int taps=2*HALF;
+  double step=1.0;                          // input frames per output frame
+  std::vector<float>table;                  // (PHASES+1) rows of taps
+  std::vector<float>coef;                   // taps of the current output
+  std::vector<float>history;                // interleaved input still needed
+  double position=0.0;                      // next output, in frames of history
+  uint64_t framesIn=0,framesOut=0;
+  uint32_t from=0,to=0;
+
+  public:
+  void configure(int numChannels,uint32_t fromRate,uint32_t toRate){
+    channels=std::max(1,numChannels);
+    from=fromRate;
+    to=toRate;
+    step=static_cast<double>(from)/to;
+    const double ratio=std::min(1.0,static_cast<double>(to)/from);
+    const double cutoff=ratio*CUTOFF;
+    half=static_cast<int>(std::ceil(HALF/ratio));
+    taps=2*half;
+    coef.assign(static_cast<size_t>(taps),0.0f);
+    table.assign(static_cast<size_t>((PHASES+1)*taps),0.0f);
+    for(int p=0;p<=PHASES;++p){
+      float *row=table.data()+static_cast<size_t>(p)*taps;
+      double sum=0.0;
+      for(int k=0;k<taps;++k){
+        // distance from the output position to input frame floor(pos)+k-half+1
+        const double x=k-half+1-static_cast<double>(p)/PHASES;
+        const double arg=M_PI*x*cutoff;
+        const double sinc=std::fabs(arg)<1e-9?1.0:std::sin(arg)/arg;
+        const double window=0.42+0.5*std::cos(M_PI*x/half)+0.08*std::cos(2.0*M_PI*x/half);
+        row[k]=static_cast<float>(std::fabs(x)>=half?0.0:sinc*window);
+        sum+=row[k];
+      }
+      for(int k=0;k<taps;++k)row[k]=static_cast<float>(row[k]/sum); // unity DC gain
+    }
+    reset();
+  }
+
+  void reset(){
+    // the first output sits on input frame 0, with silence before it
+    history.assign(static_cast<size_t>((half-1)*channels),0.0f);
+    position=half-1;
+    framesIn=framesOut=0;
+  }
+
+  inline bool isPassthrough()const{return from==to;}
+
+  // Append output frames for frames of interleaved input to out
+  void process(const float *in,size_t frames,std::vector<float>& out){
+    if(isPassthrough()){
+      out.insert(out.end(),in,in+frames*channels);
+      framesIn+=frames;
+      framesOut+=frames;
+      return;
+    }
+    history.insert(history.end(),in,in+frames*channels);
+    framesIn+=frames;
+    run(out,UINT64_MAX);
+  }
+
+  // Remaining output once the input has ended
+  void flush(std::vector<float>& out){
+    if(isPassthrough())return;
+    const uint64_t total=(framesIn*to+from/2)/from;
+    history.insert(history.end(),static_cast<size_t>(half*channels),0.0f);
+    run(out,total);
+  }
+
+  private:
+  void run(std::vector<float>& out,uint64_t limit){
+    const size_t available=history.size()/channels;
+    while(framesOut<limit){
+      const size_t base=static_cast<size_t>(position);
+      if(base+half>=available)break;
+      const double frac=(position-base)*PHASES;
+      const int p=static_cast<int>(frac);
+      const float t=static_cast<float>(frac-p);
+      const float *a=table.data()+static_cast<size_t>(p)*taps,*b=a+taps;
+      for(int k=0;k<taps;++k)coef[k]=a[k]+(b[k]-a[k])*t;
+
+      const float *src=history.data()+(base+1-half)*channels;
+      const size_t at=out.size();
+      out.resize(at+channels,0.0f);
+      for(int c=0;c<channels;++c){
+        float acc=0.0f;
+        for(int k=0;k<taps;++k)acc+=coef[k]*src[k*channels+c];
+        out[at+c]=acc;
+      }
+      position+=step;
+      ++framesOut;
+    }
+    // drop input no later output can reach
+    const size_t base=static_cast<size_t>(position);
+    if(base>=static_cast<size_t>(half)){
+      const size_t drop=std::min(base+1-half,available);
+      history.erase(history.begin(),history.begin()+drop*channels);
+      position-=static_cast<double>(drop);
+    }
+  }
+};
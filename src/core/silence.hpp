@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sndfile.hh>
+
+#include "decoded_audio.hpp"
+#include "io.hpp"
+#include "parallel.hpp"
+
+// What counts as silence
+struct SilenceSettings{
+  float thresholdDb=-60.0f;  // |x| at or below this (dBFS) is silent
+  double minSilence=0.25;    // seconds; shorter gaps do not split a region
+  double minSound=0.02;      // seconds; shorter blips are dropped
+  double padding=0.01;       // seconds kept around each region
+};
+
+/*
+ * Silence / activity index
+ *
+ * One max |x| (over all channels) per BLOCK_FRAMES frames, built in a single
+ * parallel pass. Any threshold can then be queried from the block maxima;
+ * only the block at each region edge is re-read to place the edge on the
+ * exact sample, so changing the threshold never rescans the file.
+*/
+class SilenceIndex{
+  public:
+  static constexpr uint64_t BLOCK_FRAMES=256;
+
+  struct Region{
+    uint64_t start{}; // first frame
+    uint64_t end{};   // one past the last frame
+    inline uint64_t length()const{return end-start;}
+  };
+
+  struct FileResult{
+    bool ok{false};
+    uint32_t sampleRate{};
+    uint64_t totalFrames{};
+    Region trim;                 // active span, start==end when all silent
+    std::vector<Region>regions;  // split points
+  };
+
+  private:
+  int channels=0;
+  uint64_t totalFrames=0;
+  std::vector<float>blockMax;
+
+  public:
+  SilenceIndex(){}
+  SilenceIndex(const std::vector<float>& samples,int numChannels){build(samples,numChannels);}
+
+  void build(const std::vector<float>& samples,int numChannels){
+    blockMax.clear();
+    channels=numChannels;
+    totalFrames=numChannels>0?samples.size()/numChannels:0;
+    if(totalFrames==0)return;
+    blockMax.assign((totalFrames+BLOCK_FRAMES-1)/BLOCK_FRAMES,0.0f);
+    const float *data=samples.data();
+    parallelRanges(blockMax.size(),1024,[&](size_t begin,size_t end){
+      for(size_t b=begin;b<end;++b){
+        const uint64_t f0=b*BLOCK_FRAMES,f1=std::min(totalFrames,f0+BLOCK_FRAMES);
+        const float *p=data+f0*channels;
+        const size_t n=static_cast<size_t>((f1-f0)*channels);
+        float m=0.0f;
+        for(size_t i=0;i<n;++i)m=std::max(m,std::fabs(p[i]));
+        blockMax[b]=m;
+      }
+    });
+  }
+
+  // Refresh after samples in [startFrame,endFrame) changed
+  void update(const std::vector<float>& samples,uint64_t startFrame,uint64_t endFrame=UINT64_MAX){
+    if(channels<=0)return;
+    if(samples.size()/channels!=totalFrames){build(samples,channels);return;}
+    endFrame=std::min(endFrame,totalFrames);
+    for(uint64_t b=startFrame/BLOCK_FRAMES;b*BLOCK_FRAMES<endFrame;++b){
+      const uint64_t f0=b*BLOCK_FRAMES,f1=std::min(totalFrames,f0+BLOCK_FRAMES);
+      float m=0.0f;
+      for(uint64_t i=f0*channels;i<f1*channels;++i)m=std::max(m,std::fabs(samples[i]));
+      blockMax[b]=m;
+    }
+  }
+
+  inline bool empty()const{return blockMax.empty();}
+  inline uint64_t getTotalFrames()const{return totalFrames;}
+  inline int getChannels()const{return channels;}
+
+  // Active (non-silent) regions at the given settings
+  std::vector<Region>regions(const std::vector<float>& samples,uint32_t sampleRate,const SilenceSettings& settings=SilenceSettings{})const{
+    std::vector<Region>out;
+    if(empty() || sampleRate==0)return out;
+    const float threshold=dbToLinear(settings.thresholdDb);
+    const uint64_t minGap=static_cast<uint64_t>(settings.minSilence*sampleRate);
+    const uint64_t minLength=static_cast<uint64_t>(settings.minSound*sampleRate);
+    const uint64_t pad=static_cast<uint64_t>(settings.padding*sampleRate);
+
+    // runs of loud blocks, edges refined inside their first/last block
+    const size_t blocks=blockMax.size();
+    for(size_t b=0;b<blocks;){
+      if(blockMax[b]<=threshold){++b;continue;}
+      size_t e=b;
+      while(e+1<blocks && blockMax[e+1]>threshold)++e;
+      Region r{firstAbove(samples,b,threshold),lastAbove(samples,e,threshold)+1};
+      if(!out.empty() && r.start-out.back().end<minGap)out.back().end=r.end;
+      else out.push_back(r);
+      b=e+1;
+    }
+
+    out.erase(std::remove_if(out.begin(),out.end(),[minLength](const Region& r){return r.length()<minLength;}),out.end());
+
+    // padding, never past the middle of a gap
+    const std::vector<Region>raw=out;
+    for(size_t i=0;i<out.size();++i){
+      const uint64_t lo=i?(raw[i-1].end+raw[i].start)/2:0;
+      const uint64_t hi=i+1<raw.size()?(raw[i].end+raw[i+1].start)/2:totalFrames;
+      out[i].start=raw[i].start>lo+pad?raw[i].start-pad:lo;
+      out[i].end=std::min(hi,raw[i].end+pad);
+    }
+    return out;
+  }
+
+  // Span from the first to the last non-silent sample, plus padding
+  Region trimBounds(const std::vector<float>& samples,uint32_t sampleRate,float thresholdDb=-60.0f,double padding=0.0)const{
+    Region r{0,0};
+    if(empty())return r;
+    const float threshold=dbToLinear(thresholdDb);
+    size_t first=0,last=blockMax.size();
+    while(first<last && blockMax[first]<=threshold)++first;
+    if(first==last)return r;
+    while(blockMax[last-1]<=threshold)--last;
+    const uint64_t pad=static_cast<uint64_t>(padding*sampleRate);
+    r.start=firstAbove(samples,first,threshold);
+    r.end=lastAbove(samples,last-1,threshold)+1;
+    r.start=r.start>pad?r.start-pad:0;
+    r.end=std::min(totalFrames,r.end+pad);
+    return r;
+  }
+
+  // ---------------- Operations ----------------
+  // Cut leading/trailing silence in place, returns the kept span of the original
+  static Region autoTrim(DecodedAudio& audio,int numChannels,uint32_t sampleRate,float thresholdDb=-60.0f,double padding=0.0){
+    const SilenceIndex index(audio.samples,numChannels);
+    const Region r=index.trimBounds(audio.samples,sampleRate,thresholdDb,padding);
+    if(numChannels<=0)return r;
+    audio.samples.erase(audio.samples.begin()+r.end*numChannels,audio.samples.end());
+    audio.samples.erase(audio.samples.begin(),audio.samples.begin()+r.start*numChannels);
+    audio.totalFrames=r.length();
+    return r;
+  }
+
+  // One buffer per active region
+  static std::vector<DecodedAudio>splitOnSilence(const DecodedAudio& audio,int numChannels,uint32_t sampleRate,const SilenceSettings& settings=SilenceSettings{}){
+    std::vector<DecodedAudio>parts;
+    const SilenceIndex index(audio.samples,numChannels);
+    for(const Region& r:index.regions(audio.samples,sampleRate,settings)){
+      DecodedAudio part;
+      part.samples.assign(audio.samples.begin()+r.start*numChannels,audio.samples.begin()+r.end*numChannels);
+      part.totalFrames=r.length();
+      parts.push_back(std::move(part));
+    }
+    return parts;
+  }
+
+  static bool analyzeFile(const std::string& path,const SilenceSettings& settings,FileResult& out){
+    SF_INFO info;
+    SNDFILE *file=openSoundFile(path,info);
+    if(!file)return false;
+    std::vector<float>samples(static_cast<size_t>(info.frames*info.channels));
+    const sf_count_t got=sf_readf_float(file,samples.data(),info.frames);
+    sf_close(file);
+    samples.resize(static_cast<size_t>(std::max<sf_count_t>(got,0)*info.channels));
+
+    const SilenceIndex index(samples,info.channels);
+    out.sampleRate=static_cast<uint32_t>(info.samplerate);
+    out.totalFrames=index.getTotalFrames();
+    out.trim=index.trimBounds(samples,out.sampleRate,settings.thresholdDb,settings.padding);
+    out.regions=index.regions(samples,out.sampleRate,settings);
+    out.ok=true;
+    return true;
+  }
+
+  // Trim bounds and split points for a batch of files, one file per core at a time
+  static std::vector<FileResult>analyzeFiles(const std::vector<std::string>& paths,const SilenceSettings& settings=SilenceSettings{},size_t threads=0){
+    std::vector<FileResult>results(paths.size());
+    parallelForEach(paths.size(),[&](size_t i){analyzeFile(paths[i],settings,results[i]);},threads);
+    return results;
+  }
+
+  static inline float dbToLinear(float db){return std::pow(10.0f,db/20.0f);}
+
+  private:
+  uint64_t firstAbove(const std::vector<float>& samples,size_t block,float threshold)const{
+    const uint64_t f0=block*BLOCK_FRAMES,f1=std::min(totalFrames,f0+BLOCK_FRAMES);
+    for(uint64_t f=f0;f<f1;++f)if(frameAbove(samples,f,threshold))return f;
+    return f0;
+  }
+
+  uint64_t lastAbove(const std::vector<float>& samples,size_t block,float threshold)const{
+    const uint64_t f0=block*BLOCK_FRAMES,f1=std::min(totalFrames,f0+BLOCK_FRAMES);
+    for(uint64_t f=f1;f-->f0;)if(frameAbove(samples,f,threshold))return f;
+    return f1-1;
+  }
+
+  inline bool frameAbove(const std::vector<float>& samples,uint64_t frame,float threshold)const{
+    const float *p=samples.data()+frame*channels;
+    for(int c=0;c<channels;++c)if(std::fabs(p[c])>threshold)return true;
+    return false;
+  }
+};
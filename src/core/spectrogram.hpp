@@ -0,0 +1,264 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+
+#include "fft.hpp"
+
+// STFT analysis settings
+struct SpectrogramConfig{
+  size_t fftSize=2048;
+  size_t hop=512;
+  FFT::Window window=FFT::Window::Hann;
+};
+
+/*
+ * Cached STFT spectrogram
+ *
+ * Columns (one per hop, channels mixed down) are computed in tiles of
+ * TILE_COLUMNS by background workers and kept in an LRU cache. getTile()
+ * never waits: a miss queues the tile and returns nullptr. Misses go to an
+ * urgent queue served before any prefetch (a prefetched tile that is asked
+ * for moves over), newest first, so the visible range wins while scrolling.
+ *
+ * The sample buffer passed to setSource() must stay alive and unchanged
+ * until setSource()/invalidate() is called again.
+*/
+class Spectrogram{
+  public:
+  static constexpr size_t TILE_COLUMNS=64;
+
+  using Config=SpectrogramConfig;
+
+  struct Tile{
+    uint64_t index{};
+    size_t columns{};  // may be short at the end of the file
+    size_t bins{};
+    std::vector<float>db; // columns * bins, power in dBFS
+    inline const float* column(size_t c)const{return db.data()+c*bins;}
+  };
+
+  private:
+  Config config;
+  const std::vector<float>* samples=nullptr;
+  int channels=1;
+  uint32_t sampleRate=0;
+  uint64_t totalColumns=0;
+  std::vector<float>window;
+  float dbOffset=0.0f; // normalizes a full-scale sine to 0 dB
+
+  // cache
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  size_t capacity=256;
+  std::list<std::shared_ptr<const Tile>>lru; // front = most recent
+  std::unordered_map<uint64_t,std::list<std::shared_ptr<const Tile>>::iterator>cache;
+  std::deque<uint64_t>urgent;                // getTile() misses, back = newest
+  std::deque<uint64_t>requests;              // prefetch, back = served first
+  std::unordered_set<uint64_t>pending;
+  uint64_t generation=0;
+
+  std::vector<std::thread>workers;
+  bool quit=false;
+
+  public:
+  explicit Spectrogram(size_t threads=0){
+    if(threads==0)threads=std::max(1u,std::thread::hardware_concurrency()>1?std::thread::hardware_concurrency()-1:1u);
+    for(size_t i=0;i<threads;++i)workers.emplace_back(&Spectrogram::workerLoop,this);
+  }
+
+  ~Spectrogram(){
+    {
+      std::lock_guard<std::mutex>lock(mutex);
+      quit=true;
+    }
+    cv.notify_all();
+    for(std::thread& t:workers)t.join();
+  }
+
+  Spectrogram(const Spectrogram&)=delete;
+  Spectrogram& operator=(const Spectrogram&)=delete;
+
+  bool setSource(const std::vector<float>& interleaved,int numChannels,uint32_t rate,const Config& cfg=Config{}){
+    if(numChannels<=0 || !FFT::isPowerOfTwo(cfg.fftSize) || cfg.fftSize<4 || cfg.hop==0)return false;
+    std::lock_guard<std::mutex>lock(mutex);
+    samples=&interleaved;
+    channels=numChannels;
+    sampleRate=rate;
+    config=cfg;
+    window=FFT::makeWindow(cfg.window,cfg.fftSize);
+    double sum=0.0;
+    for(float w:window)sum+=w;
+    dbOffset=static_cast<float>(-20.0*std::log10(std::max(sum*0.5,1e-9)));
+    const uint64_t frames=interleaved.size()/numChannels;
+    totalColumns=frames?(frames+cfg.hop-1)/cfg.hop:0;
+    resetLocked();
+    return true;
+  }
+
+  // Drop everything computed so far (after an edit)
+  void invalidate(){
+    std::lock_guard<std::mutex>lock(mutex);
+    if(samples && channels>0)totalColumns=(samples->size()/channels+config.hop-1)/config.hop;
+    resetLocked();
+  }
+
+  void setCacheCapacity(size_t tiles){
+    std::lock_guard<std::mutex>lock(mutex);
+    capacity=std::max<size_t>(1,tiles);
+    evictLocked();
+  }
+
+  inline uint64_t getTotalColumns()const{std::lock_guard<std::mutex>lock(mutex);return totalColumns;}
+  inline size_t getBins()const{std::lock_guard<std::mutex>lock(mutex);return config.fftSize/2+1;}
+  inline uint32_t getSampleRate()const{std::lock_guard<std::mutex>lock(mutex);return sampleRate;}
+  inline Config getConfig()const{std::lock_guard<std::mutex>lock(mutex);return config;}
+  inline static uint64_t tileOf(uint64_t column){return column/TILE_COLUMNS;}
+
+  // Non-blocking; queues the tile on a miss
+  std::shared_ptr<const Tile>getTile(uint64_t index){
+    std::unique_lock<std::mutex>lock(mutex);
+    auto it=cache.find(index);
+    if(it!=cache.end()){
+      lru.splice(lru.begin(),lru,it->second);
+      return *it->second;
+    }
+    requestLocked(index,true);
+    lock.unlock();
+    cv.notify_one();
+    return nullptr;
+  }
+
+  // Queue tiles without touching the LRU order (prefetch around the view);
+  // the outer ends are queued first so the middle of the range is served first
+  void prefetch(uint64_t firstTile,uint64_t lastTile){
+    {
+      std::lock_guard<std::mutex>lock(mutex);
+      for(uint64_t lo=firstTile,hi=lastTile;lo<=hi;++lo,--hi){
+        if(!cache.count(lo))requestLocked(lo,false);
+        if(hi!=lo && !cache.count(hi))requestLocked(hi,false);
+        if(hi==0)break;
+      }
+    }
+    cv.notify_all();
+  }
+
+  private:
+  void resetLocked(){
+    ++generation;
+    lru.clear();
+    cache.clear();
+    urgent.clear();
+    requests.clear();
+    pending.clear();
+  }
+
+  void requestLocked(uint64_t index,bool now){
+    if(!samples || index*TILE_COLUMNS>=totalColumns)return;
+    if(pending.count(index)){
+      // queued (not in flight): an urgent request moves it to the back of the urgent queue
+      if(!now)return;
+      auto it=std::find(urgent.begin(),urgent.end(),index);
+      if(it!=urgent.end())urgent.erase(it);
+      else if((it=std::find(requests.begin(),requests.end(),index))!=requests.end())requests.erase(it);
+      else return;
+    }
+    pending.insert(index);
+    std::deque<uint64_t>& queue=now?urgent:requests;
+    queue.push_back(index);
+    // Stale requests from far-away scrolling are dropped first
+    while(queue.size()>capacity){
+      pending.erase(queue.front());
+      queue.pop_front();
+    }
+  }
+
+  void evictLocked(){
+    while(lru.size()>capacity){
+      cache.erase(lru.back()->index);
+      lru.pop_back();
+    }
+  }
+
+  void workerLoop(){
+    FFT fft;
+    std::vector<float>frame,windowed,re,im,power;
+    while(true){
+      uint64_t index,gen;
+      Config cfg;
+      const std::vector<float>* src;
+      int ch;
+      uint64_t columns;
+      std::vector<float>win;
+      float offset;
+      {
+        std::unique_lock<std::mutex>lock(mutex);
+        cv.wait(lock,[this](){return quit || !urgent.empty() || !requests.empty();});
+        if(quit)return;
+        std::deque<uint64_t>& queue=urgent.empty()?requests:urgent;
+        index=queue.back();
+        queue.pop_back();
+        gen=generation;
+        cfg=config;
+        src=samples;
+        ch=channels;
+        columns=totalColumns;
+        offset=dbOffset;
+        win=window;
+      }
+
+      if(fft.size()!=cfg.fftSize){
+        fft.init(cfg.fftSize);
+        frame.resize(cfg.fftSize);windowed.resize(cfg.fftSize);
+        re.resize(cfg.fftSize/2+1);im.resize(cfg.fftSize/2+1);power.resize(cfg.fftSize/2+1);
+      }
+
+      auto tile=std::make_shared<Tile>();
+      tile->index=index;
+      tile->bins=cfg.fftSize/2+1;
+      tile->columns=static_cast<size_t>(std::min<uint64_t>(TILE_COLUMNS,columns-index*TILE_COLUMNS));
+      tile->db.resize(tile->columns*tile->bins);
+
+      const uint64_t frames=src->size()/ch;
+      const float gainMix=1.0f/ch;
+      for(size_t c=0;c<tile->columns;++c){
+        // Frame centered on the hop position, zero padded at the edges
+        const int64_t center=static_cast<int64_t>((index*TILE_COLUMNS+c)*cfg.hop);
+        const int64_t start=center-static_cast<int64_t>(cfg.fftSize/2);
+        for(size_t k=0;k<cfg.fftSize;++k){
+          const int64_t f=start+static_cast<int64_t>(k);
+          float v=0.0f;
+          if(f>=0 && static_cast<uint64_t>(f)<frames){
+            const float *p=src->data()+f*ch;
+            for(int j=0;j<ch;++j)v+=p[j];
+            v*=gainMix;
+          }
+          frame[k]=v;
+        }
+        fft.powerSpectrum(frame.data(),win.data(),power.data(),re.data(),im.data(),windowed.data());
+        float *out=tile->db.data()+c*tile->bins;
+        for(size_t b=0;b<tile->bins;++b)out[b]=10.0f*std::log10(power[b]+1e-20f)+offset;
+      }
+
+      std::lock_guard<std::mutex>lock(mutex);
+      if(gen!=generation)continue; // source changed while computing
+      pending.erase(index);
+      if(cache.count(index))continue;
+      lru.push_front(tile);
+      cache[index]=lru.begin();
+      evictLocked();
+    }
+  }
+};
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sndfile.hh>
+
+#include "io.hpp"
+#include "parallel.hpp"
+
+// One channel's report, same fields as the reference analyzer (OUTPUT.WAV.INFO)
+struct ChannelStats{
+  double dcOffset{};
+  float minLevel{};
+  float maxLevel{};
+  double peakDb{};
+  double rmsDb{};
+  double rmsPeakDb{};    // highest windowed RMS
+  double rmsTroughDb{};  // lowest windowed RMS
+  double crestFactor{};  // peak / RMS, linear
+  double flatFactor{};   // dB of the longest run held at the min or max level
+  uint64_t peakCount{};  // samples at the peak magnitude
+  double meanNorm{};     // mean |x|
+  double maxDelta{};
+  double meanDelta{};
+  double rmsDelta{};
+  uint64_t samples{};
+  double windowSeconds{};
+};
+
+/*
+ * Per-channel statistics
+ *
+ * One streaming pass per channel. Samples are de-interleaved a chunk at a
+ * time so the reductions (min, max, sums, deltas) run as straight loops the
+ * compiler vectorizes; a second loop over the same chunk keeps the windowed
+ * RMS and the flat runs. As in the reference analyzer the window is a one-pole
+ * mean square with a windowSeconds time constant; its peak and trough are
+ * taken once the average has settled (five time constants). Channels are measured on separate threads and
+ * files in a batch are spread across cores.
+*/
+class Statistics{
+  public:
+  static constexpr size_t CHUNK=4096;
+
+  // Streaming accumulator for one channel
+  class Accumulator{
+    private:
+    double windowSeconds=0.05;
+    uint64_t settle=0;     // samples before the windowed RMS is trusted
+    double decay=0.0;
+    double meanSquare=0.0; // one-pole windowed mean square
+    double rmsPeak=0.0,rmsTrough=std::numeric_limits<double>::infinity();
+
+    uint64_t count=0;
+    double sum=0.0,sumSq=0.0,sumAbs=0.0;
+    float mn=std::numeric_limits<float>::infinity(),mx=-std::numeric_limits<float>::infinity();
+    double deltaSum=0.0,deltaSq=0.0;
+    float deltaMax=0.0f;
+    float last=0.0f;
+
+    // occurrences and longest consecutive runs at the running min/max
+    uint64_t maxCount=0,minCount=0,maxRun=0,minRun=0,maxLongest=0,minLongest=0;
+
+    public:
+    Accumulator(uint32_t sampleRate=48000,double windowSec=0.05){reset(sampleRate,windowSec);}
+
+    void reset(uint32_t sampleRate,double windowSec=0.05){
+      windowSeconds=windowSec;
+      const double tc=std::max(1.0,windowSec*sampleRate);
+      decay=std::exp(-1.0/tc);
+      settle=static_cast<uint64_t>(5.0*tc);
+      meanSquare=0.0;
+      rmsPeak=0.0;
+      rmsTrough=std::numeric_limits<double>::infinity();
+      count=0;
+      sum=sumSq=sumAbs=0.0;
+      mn=std::numeric_limits<float>::infinity();
+      mx=-std::numeric_limits<float>::infinity();
+      deltaSum=deltaSq=0.0;
+      deltaMax=0.0f;
+      last=0.0f;
+      maxCount=minCount=maxRun=minRun=maxLongest=minLongest=0;
+    }
+
+    // Contiguous samples of this channel
+    void add(const float *x,size_t n){
+      if(n==0)return;
+      // vectorizable reductions
+      float cmn=mn,cmx=mx;
+      double s=0.0,sq=0.0,sa=0.0,ds=0.0,dq=0.0;
+      float dmax=deltaMax;
+      for(size_t i=0;i<n;++i){
+        const float v=x[i];
+        cmn=std::min(cmn,v);
+        cmx=std::max(cmx,v);
+        s+=v;
+        sq+=static_cast<double>(v)*v;
+        sa+=std::fabs(v);
+      }
+      if(count>0){ // delta across the chunk boundary
+        const float d=std::fabs(x[0]-last);
+        ds+=d;dq+=static_cast<double>(d)*d;dmax=std::max(dmax,d);
+      }
+      for(size_t i=1;i<n;++i){
+        const float d=std::fabs(x[i]-x[i-1]);
+        ds+=d;
+        dq+=static_cast<double>(d)*d;
+        dmax=std::max(dmax,d);
+      }
+      sum+=s;sumSq+=sq;sumAbs+=sa;
+      deltaSum+=ds;deltaSq+=dq;deltaMax=dmax;
+      last=x[n-1];
+
+      // runs at the extremes, restarted whenever a new extreme appears
+      if(cmx>mx){mx=cmx;maxCount=maxRun=maxLongest=0;}
+      if(cmn<mn){mn=cmn;minCount=minRun=minLongest=0;}
+      for(size_t i=0;i<n;++i){
+        const float v=x[i];
+        if(v==mx){++maxCount;maxLongest=std::max(maxLongest,++maxRun);}else maxRun=0;
+        if(v==mn){++minCount;minLongest=std::max(minLongest,++minRun);}else minRun=0;
+
+        meanSquare=meanSquare*decay+static_cast<double>(v)*v*(1.0-decay);
+        if(count+i>=settle){
+          rmsPeak=std::max(rmsPeak,meanSquare);
+          rmsTrough=std::min(rmsTrough,meanSquare);
+        }
+      }
+      count+=n;
+    }
+
+    ChannelStats result()const{
+      ChannelStats st;
+      st.samples=count;
+      st.windowSeconds=windowSeconds;
+      if(count==0)return st;
+      const double n=static_cast<double>(count);
+      const double rms=std::sqrt(sumSq/n);
+      const double peak=std::max(std::fabs(mn),std::fabs(mx));
+      st.dcOffset=sum/n;
+      st.minLevel=mn;
+      st.maxLevel=mx;
+      st.peakDb=toDb(peak);
+      st.rmsDb=toDb(rms);
+      // too short for the average to settle: fall back to the whole-file RMS
+      const bool windowed=count>settle;
+      st.rmsPeakDb=toDb(windowed?std::sqrt(rmsPeak):rms);
+      st.rmsTroughDb=toDb(windowed?std::sqrt(rmsTrough):rms);
+      st.crestFactor=rms>0.0?peak/rms:0.0;
+      uint64_t longest=0;
+      if(std::fabs(mx)==peak){st.peakCount+=maxCount;longest=std::max(longest,maxLongest);}
+      if(std::fabs(mn)==peak && mn!=mx){st.peakCount+=minCount;longest=std::max(longest,minLongest);}
+      st.flatFactor=longest>1?20.0*std::log10(static_cast<double>(longest)):0.0;
+      st.meanNorm=sumAbs/n;
+      if(count>1){
+        st.maxDelta=deltaMax;
+        st.meanDelta=deltaSum/(n-1);
+        st.rmsDelta=std::sqrt(deltaSq/(n-1));
+      }
+      return st;
+    }
+  };
+
+  // All channels of an interleaved stream fed in blocks of any size (a file, a page cache scan)
+  class Stream{
+    private:
+    int channels=0;
+    std::vector<Accumulator>acc;
+    std::vector<float>chunk;
+
+    public:
+    Stream(int numChannels,uint32_t sampleRate,double windowSeconds=0.05):channels(std::max(numChannels,0)),acc(channels,Accumulator(sampleRate,windowSeconds)),chunk(CHUNK){}
+
+    void push(const float *interleaved,size_t frames){
+      for(size_t f=0;f<frames;f+=CHUNK){
+        const size_t n=std::min(CHUNK,frames-f);
+        const float *p=interleaved+f*channels;
+        for(int c=0;c<channels;++c){
+          for(size_t i=0;i<n;++i)chunk[i]=p[i*channels+c];
+          acc[c].add(chunk.data(),n);
+        }
+      }
+    }
+
+    std::vector<ChannelStats>result()const{
+      std::vector<ChannelStats>out;
+      for(const Accumulator& a:acc)out.push_back(a.result());
+      return out;
+    }
+  };
+
+  // All channels of an interleaved buffer, one thread per channel
+  static std::vector<ChannelStats>measure(const std::vector<float>& samples,int channels,uint32_t sampleRate,double windowSeconds=0.05,size_t threads=0){
+    std::vector<ChannelStats>out;
+    if(channels<=0 || sampleRate==0)return out;
+    out.resize(channels);
+    const uint64_t frames=samples.size()/channels;
+    parallelForEach(static_cast<size_t>(channels),[&](size_t c){
+      Accumulator acc(sampleRate,windowSeconds);
+      std::vector<float>chunk(CHUNK);
+      for(uint64_t f=0;f<frames;f+=CHUNK){
+        const size_t n=static_cast<size_t>(std::min<uint64_t>(CHUNK,frames-f));
+        const float *p=samples.data()+f*channels+c;
+        for(size_t i=0;i<n;++i)chunk[i]=p[i*channels];
+        acc.add(chunk.data(),n);
+      }
+      out[c]=acc.result();
+    },threads);
+    return out;
+  }
+
+  // Streams the file through libsndfile; memory does not depend on its length
+  static bool measureFile(const std::string& path,std::vector<ChannelStats>& out,double windowSeconds=0.05){
+    SF_INFO info;
+    SNDFILE *file=openSoundFile(path,info);
+    if(!file)return false;
+    Stream stream(info.channels,static_cast<uint32_t>(info.samplerate),windowSeconds);
+    std::vector<float>buffer(CHUNK*info.channels);
+    sf_count_t got;
+    while((got=sf_readf_float(file,buffer.data(),CHUNK))>0)stream.push(buffer.data(),static_cast<size_t>(got));
+    sf_close(file);
+    out=stream.result();
+    return true;
+  }
+
+  // Batch across cores, one file per thread at a time
+  static std::vector<std::vector<ChannelStats>>measureFiles(const std::vector<std::string>& paths,double windowSeconds=0.05,size_t threads=0){
+    std::vector<std::vector<ChannelStats>>results(paths.size());
+    parallelForEach(paths.size(),[&](size_t i){measureFile(paths[i],results[i],windowSeconds);},threads);
+    return results;
+  }
+
+  // ---------------- Reports ----------------
+  // Column per channel, laid out like the reference analyzer
+  static std::string toText(const std::vector<ChannelStats>& stats){
+    std::string out;
+    char line[256];
+    auto row=[&](const char *label,auto value,const char *fmt){
+      int len=std::snprintf(line,sizeof(line),"%-13s",label);
+      for(const ChannelStats& s:stats)len+=std::snprintf(line+len,sizeof(line)-len,fmt,value(s));
+      out+=line;
+      out+='\n';
+    };
+    int len=std::snprintf(line,sizeof(line),"%-13s","");
+    for(size_t c=0;c<stats.size();++c)len+=std::snprintf(line+len,sizeof(line)-len,"%10s",("Ch"+std::to_string(c+1)).c_str());
+    out+=line;
+    out+='\n';
+    row("DC offset",[](const ChannelStats& s){return s.dcOffset;},"%10.6f");
+    row("Min level",[](const ChannelStats& s){return static_cast<double>(s.minLevel);},"%10.6f");
+    row("Max level",[](const ChannelStats& s){return static_cast<double>(s.maxLevel);},"%10.6f");
+    row("Pk lev dB",[](const ChannelStats& s){return s.peakDb;},"%10.2f");
+    row("RMS lev dB",[](const ChannelStats& s){return s.rmsDb;},"%10.2f");
+    row("RMS Pk dB",[](const ChannelStats& s){return s.rmsPeakDb;},"%10.2f");
+    row("RMS Tr dB",[](const ChannelStats& s){return s.rmsTroughDb;},"%10.2f");
+    row("Crest factor",[](const ChannelStats& s){return s.crestFactor;},"%10.2f");
+    row("Flat factor",[](const ChannelStats& s){return s.flatFactor;},"%10.2f");
+    row("Pk count",[](const ChannelStats& s){return static_cast<unsigned long long>(s.peakCount);},"%10llu");
+    row("Mean norm",[](const ChannelStats& s){return s.meanNorm;},"%10.6f");
+    row("Max delta",[](const ChannelStats& s){return s.maxDelta;},"%10.6f");
+    row("Mean delta",[](const ChannelStats& s){return s.meanDelta;},"%10.6f");
+    row("RMS delta",[](const ChannelStats& s){return s.rmsDelta;},"%10.6f");
+    row("Num samples",[](const ChannelStats& s){return static_cast<unsigned long long>(s.samples);},"%10llu");
+    row("Window s",[](const ChannelStats& s){return s.windowSeconds;},"%10.3f");
+    return out;
+  }
+
+  static std::string toJSON(const std::vector<ChannelStats>& stats){
+    std::string out="[";
+    char buf[1024];
+    for(size_t c=0;c<stats.size();++c){
+      const ChannelStats& s=stats[c];
+      std::snprintf(buf,sizeof(buf),
+        "%s{\"channel\":%zu,\"dcOffset\":%s,\"minLevel\":%s,\"maxLevel\":%s,\"peakDb\":%s,\"rmsDb\":%s,"
+        "\"rmsPeakDb\":%s,\"rmsTroughDb\":%s,\"crestFactor\":%s,\"flatFactor\":%s,\"peakCount\":%llu,"
+        "\"meanNorm\":%s,\"maxDelta\":%s,\"meanDelta\":%s,\"rmsDelta\":%s,\"samples\":%llu,\"windowSeconds\":%s}",
+        c?",":"",c+1,num(s.dcOffset).c_str(),num(s.minLevel).c_str(),num(s.maxLevel).c_str(),num(s.peakDb).c_str(),num(s.rmsDb).c_str(),
+        num(s.rmsPeakDb).c_str(),num(s.rmsTroughDb).c_str(),num(s.crestFactor).c_str(),num(s.flatFactor).c_str(),static_cast<unsigned long long>(s.peakCount),
+        num(s.meanNorm).c_str(),num(s.maxDelta).c_str(),num(s.meanDelta).c_str(),num(s.rmsDelta).c_str(),static_cast<unsigned long long>(s.samples),num(s.windowSeconds).c_str());
+      out+=buf;
+    }
+    out+="]";
+    return out;
+  }
+
+  static inline double toDb(double linear){return linear>0.0?20.0*std::log10(linear):-std::numeric_limits<double>::infinity();}
+
+  private:
+  // JSON has no infinity: silent channels report null dB values
+  static std::string num(double v){
+    if(!std::isfinite(v))return "null";
+    char buf[32];
+    std::snprintf(buf,sizeof(buf),"%.6g",v);
+    return buf;
+  }
+};
@@ -0,0 +1,473 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "parallel.hpp"
+
+/*
+ * Frame source
+ *
+ * Interleaved frames for the summary structures to scan: a flat buffer, or
+ * any reader (a PagedStore) that copies frames out. Built implicitly from a
+ * vector, so in-memory callers just pass their samples; it keeps a pointer
+ * to the vector, not to its data, so it stays valid when the vector grows.
+*/
+class FrameSource{
+  public:
+  typedef std::function<size_t(uint64_t frame,float *out,size_t count)>Reader;
+
+  private:
+  const std::vector<float>* flat=nullptr;
+  Reader reader;
+
+  public:
+  FrameSource(){}
+  FrameSource(const std::vector<float>& samples):flat(&samples){}
+  explicit FrameSource(Reader fn):reader(std::move(fn)){}
+
+  // Frames [frame,frame+count); copied into scratch unless they already are contiguous in memory
+  const float* get(uint64_t frame,size_t count,int channels,std::vector<float>& scratch)const{
+    if(flat)return flat->data()+frame*channels;
+    scratch.resize(count*channels);
+    const size_t got=reader?reader(frame,scratch.data(),count):0;
+    std::fill(scratch.begin()+got*channels,scratch.end(),0.0f);
+    return scratch.data();
+  }
+};
+
+/*
+ * Block tree
+ *
+ * An implicit treap over variable-length blocks of frames, each holding
+ * `width` values (one per channel, or one for all) and every node the merge
+ * of its subtree. Blocks are found by frame position, not by index, so an
+ * insert or delete only replaces the blocks it touches: the blocks after it
+ * move without being rescanned, and only the O(log n) nodes on the paths
+ * above the splice are recomputed.
+ *
+ * Value needs a default (empty) state and merge().
+*/
+template<typename Value>
+class BlockTree{
+  public:
+  static constexpr uint32_t NIL=UINT32_MAX;
+
+  // Block-aligned cover of an edit: old frames [first,oldEnd) become new frames [first,newEnd)
+  struct Span{
+    uint64_t first=0;
+    uint64_t oldEnd=0;
+    uint64_t newEnd=0;
+  };
+
+  private:
+  struct Node{
+    uint32_t left=NIL,right=NIL;
+    uint32_t priority=0;
+    uint64_t length=0;   // frames in this block
+    uint64_t total=0;    // frames in this subtree
+  };
+
+  int width=1;
+  std::vector<Node>nodes;
+  std::vector<Value>values;   // width per node: the block itself
+  std::vector<Value>sums;     // width per node: the whole subtree
+  std::vector<uint32_t>freeNodes;
+  uint32_t root=NIL;
+  uint32_t seed=0x9e3779b9u;
+
+  public:
+  void reset(int lanes){
+    width=std::max(1,lanes);
+    nodes.clear();
+    values.clear();
+    sums.clear();
+    freeNodes.clear();
+    root=NIL;
+  }
+
+  inline int lanes()const{return width;}
+  inline uint64_t frames()const{return root==NIL?0:nodes[root].total;}
+  inline size_t blocks()const{return nodes.size()-freeNodes.size();}
+  inline const Value& total(int lane)const{static const Value none;return root==NIL?none:sums[static_cast<size_t>(root)*width+lane];}
+
+  // Replace everything with blocks of the given lengths (values: width per block)
+  void assign(const std::vector<uint64_t>& lengths,const std::vector<Value>& blockValues){
+    reset(width);
+    root=buildRun(lengths,blockValues);
+  }
+
+  // Split a span into about equal blocks of at most blockFrames
+  static void chunk(uint64_t span,uint64_t blockFrames,std::vector<uint64_t>& lengths){
+    lengths.clear();
+    if(span==0)return;
+    const uint64_t n=(span+blockFrames-1)/blockFrames;
+    for(uint64_t i=0;i<n;++i)lengths.push_back(span/n+(i<span%n?1:0));
+  }
+
+  // The blocks an edit replacing old frames [start,end) with length frames must
+  // rebuild. A small remainder takes in a neighbour so blocks stay >= minBlock.
+  Span cover(uint64_t start,uint64_t end,uint64_t length,uint64_t minBlock)const{
+    const uint64_t count=frames();
+    start=std::min(start,count);
+    end=std::min(std::max(end,start),count);
+    Span s;
+    s.first=start<count?blockStart(start):count;
+    s.oldEnd=end>s.first?blockEnd(end-1):s.first;
+    s.newEnd=s.oldEnd-(end-start)+length;
+    if(s.newEnd>s.first && s.newEnd-s.first<minBlock){
+      if(s.oldEnd<count){
+        const uint64_t next=blockEnd(s.oldEnd);
+        s.newEnd+=next-s.oldEnd;
+        s.oldEnd=next;
+      }else if(s.first>0)s.first=blockStart(s.first-1);
+    }
+    return s;
+  }
+
+  // Swap the blocks of s.first..s.oldEnd for new ones covering s.first..s.newEnd
+  void splice(const Span& s,const std::vector<uint64_t>& lengths,const std::vector<Value>& blockValues){
+    uint32_t a,b,middle,c;
+    split(root,s.first,a,b);
+    split(b,s.oldEnd-s.first,middle,c);
+    release(middle);
+    root=merge(merge(a,buildRun(lengths,blockValues)),c);
+  }
+
+  // Merge of one lane over [start,end): whole blocks from the tree, the rest
+  // through edge(from,to,out) for blocks only partly inside
+  template<typename Edge>
+  void query(int lane,uint64_t start,uint64_t end,Value& out,Edge&& edge)const{
+    end=std::min(end,frames());
+    if(start<end)fold(root,0,lane,start,end,out,edge);
+  }
+
+  // Start of the block holding frame (frame < frames())
+  uint64_t blockStart(uint64_t frame)const{
+    uint64_t offset=0;
+    for(uint32_t n=root;n!=NIL;){
+      const uint64_t left=totalOf(nodes[n].left);
+      if(frame<left){n=nodes[n].left;continue;}
+      if(frame<left+nodes[n].length)return offset+left;
+      offset+=left+nodes[n].length;
+      frame-=left+nodes[n].length;
+      n=nodes[n].right;
+    }
+    return offset;
+  }
+  uint64_t blockEnd(uint64_t frame)const{
+    uint64_t offset=0;
+    for(uint32_t n=root;n!=NIL;){
+      const uint64_t left=totalOf(nodes[n].left);
+      if(frame<left){n=nodes[n].left;continue;}
+      if(frame<left+nodes[n].length)return offset+left+nodes[n].length;
+      offset+=left+nodes[n].length;
+      frame-=left+nodes[n].length;
+      n=nodes[n].right;
+    }
+    return offset;
+  }
+
+  // Blocks in order, for serializing
+  template<typename Fn>
+  void forEach(Fn&& fn)const{visit(root,fn);}
+
+  private:
+  inline uint64_t totalOf(uint32_t n)const{return n==NIL?0:nodes[n].total;}
+
+  inline uint32_t nextPriority(){
+    seed^=seed<<13;
+    seed^=seed>>17;
+    seed^=seed<<5;
+    return seed;
+  }
+
+  uint32_t allocate(){
+    if(!freeNodes.empty()){
+      const uint32_t n=freeNodes.back();
+      freeNodes.pop_back();
+      nodes[n]=Node{};
+      return n;
+    }
+    nodes.emplace_back();
+    values.resize(values.size()+width);
+    sums.resize(sums.size()+width);
+    return static_cast<uint32_t>(nodes.size()-1);
+  }
+
+  void release(uint32_t n){
+    if(n==NIL)return;
+    release(nodes[n].left);
+    release(nodes[n].right);
+    freeNodes.push_back(n);
+  }
+
+  void pull(uint32_t n){
+    Node& node=nodes[n];
+    node.total=node.length+totalOf(node.left)+totalOf(node.right);
+    for(int k=0;k<width;++k){
+      Value v=node.left==NIL?Value{}:sums[static_cast<size_t>(node.left)*width+k];
+      v.merge(values[static_cast<size_t>(n)*width+k]);
+      if(node.right!=NIL)v.merge(sums[static_cast<size_t>(node.right)*width+k]);
+      sums[static_cast<size_t>(n)*width+k]=v;
+    }
+  }
+
+  // Treap over a run of new blocks in O(blocks): a Cartesian tree on random priorities
+  uint32_t buildRun(const std::vector<uint64_t>& lengths,const std::vector<Value>& blockValues){
+    std::vector<uint32_t>spine;
+    for(size_t i=0;i<lengths.size();++i){
+      const uint32_t n=allocate();
+      nodes[n].priority=nextPriority();
+      nodes[n].length=lengths[i];
+      for(int k=0;k<width;++k)values[static_cast<size_t>(n)*width+k]=blockValues[i*width+k];
+      uint32_t last=NIL;
+      while(!spine.empty() && nodes[spine.back()].priority<nodes[n].priority){
+        last=spine.back();
+        spine.pop_back();
+      }
+      nodes[n].left=last;
+      if(!spine.empty())nodes[spine.back()].right=n;
+      spine.push_back(n);
+    }
+    if(spine.empty())return NIL;
+    pullAll(spine.front());
+    return spine.front();
+  }
+
+  void pullAll(uint32_t n){
+    if(n==NIL)return;
+    pullAll(nodes[n].left);
+    pullAll(nodes[n].right);
+    pull(n);
+  }
+
+  // Split at a block boundary: the first `frames` frames go to a
+  void split(uint32_t n,uint64_t frames,uint32_t& a,uint32_t& b){
+    if(n==NIL){a=b=NIL;return;}
+    const uint64_t left=totalOf(nodes[n].left);
+    if(frames<=left){
+      uint32_t l;
+      split(nodes[n].left,frames,a,l);
+      nodes[n].left=l;
+      pull(n);
+      b=n;
+    }else{
+      uint32_t r;
+      split(nodes[n].right,frames-left-nodes[n].length,r,b);
+      nodes[n].right=r;
+      pull(n);
+      a=n;
+    }
+  }
+
+  uint32_t merge(uint32_t a,uint32_t b){
+    if(a==NIL)return b;
+    if(b==NIL)return a;
+    if(nodes[a].priority>nodes[b].priority){
+      nodes[a].right=merge(nodes[a].right,b);
+      pull(a);
+      return a;
+    }
+    nodes[b].left=merge(a,nodes[b].left);
+    pull(b);
+    return b;
+  }
+
+  template<typename Edge>
+  void fold(uint32_t n,uint64_t offset,int lane,uint64_t start,uint64_t end,Value& out,Edge& edge)const{
+    if(n==NIL)return;
+    const Node& node=nodes[n];
+    if(end<=offset || start>=offset+node.total)return;
+    if(start<=offset && offset+node.total<=end){
+      out.merge(sums[static_cast<size_t>(n)*width+lane]);
+      return;
+    }
+    fold(node.left,offset,lane,start,end,out,edge);
+    const uint64_t b0=offset+totalOf(node.left),b1=b0+node.length;
+    if(start<=b0 && b1<=end)out.merge(values[static_cast<size_t>(n)*width+lane]);
+    else if(start<b1 && end>b0)edge(std::max(start,b0),std::min(end,b1),out);
+    fold(node.right,b1,lane,start,end,out,edge);
+  }
+
+  template<typename Fn>
+  void visit(uint32_t n,Fn& fn)const{
+    if(n==NIL)return;
+    visit(nodes[n].left,fn);
+    fn(nodes[n].length,values.data()+static_cast<size_t>(n)*width);
+    visit(nodes[n].right,fn);
+  }
+};
+
+/*
+ * Block summary tree
+ *
+ * Blocks of about BLOCK_FRAMES frames (all channels) keep min, max, sum of
+ * squares, sample count and clipped-sample count in a BlockTree, so the root
+ * is the whole-file analysis. An edit, in place or changing the length,
+ * rescans only the blocks it touches (plus at most one neighbour) and the
+ * O(log n) nodes above them; a range query merges O(log n) nodes plus the
+ * partial blocks at either end.
+*/
+class SummaryTree{
+  public:
+  static constexpr uint64_t BLOCK_FRAMES=1024;
+  static constexpr float CLIP_LEVEL=0.999f;
+
+  struct Summary{
+    float min=std::numeric_limits<float>::infinity();
+    float max=-std::numeric_limits<float>::infinity();
+    double sumSq=0.0;
+    uint64_t count=0;  // samples, not frames
+    uint64_t clips=0;  // samples at or past CLIP_LEVEL
+
+    inline bool empty()const{return count==0;}
+    inline float rms()const{return count?static_cast<float>(std::sqrt(sumSq/count)):0.0f;}
+    inline float peak()const{return count?std::max(std::fabs(min),std::fabs(max)):0.0f;}
+
+    void merge(const Summary& o){
+      min=std::min(min,o.min);
+      max=std::max(max,o.max);
+      sumSq+=o.sumSq;
+      count+=o.count;
+      clips+=o.clips;
+    }
+  };
+
+  private:
+  int channels=0;
+  BlockTree<Summary>tree;
+  uint64_t scanned=0;       // frames scanned by build/update, for checking edit cost
+
+  // streaming build
+  std::vector<uint64_t>pendingLengths;
+  std::vector<Summary>pendingValues;
+
+  public:
+  void clear(){
+    channels=0;
+    tree.reset(1);
+    scanned=0;
+    pendingLengths.clear();
+    pendingValues.clear();
+  }
+
+  void build(const FrameSource& samples,int numChannels,uint64_t frames){
+    clear();
+    if(numChannels<=0)return;
+    channels=numChannels;
+    std::vector<uint64_t>lengths;
+    BlockTree<Summary>::chunk(frames,BLOCK_FRAMES,lengths);
+    std::vector<uint64_t>starts(lengths.size());
+    for(size_t b=1;b<lengths.size();++b)starts[b]=starts[b-1]+lengths[b-1];
+    std::vector<Summary>values(lengths.size());
+    parallelRanges(lengths.size(),64,[&](size_t begin,size_t end){
+      std::vector<float>scratch;
+      for(size_t b=begin;b<end;++b)scanFrames(samples,starts[b],starts[b]+lengths[b],values[b],scratch);
+    });
+    tree.assign(lengths,values);
+    scanned+=frames;
+  }
+  void build(const std::vector<float>& samples,int numChannels){build(samples,numChannels,numChannels>0?samples.size()/numChannels:0);}
+
+  // Streaming build: begin(), append() consecutive blocks of any size, finish()
+  void begin(int numChannels){
+    clear();
+    channels=numChannels>0?numChannels:0;
+  }
+  void append(const float *interleaved,size_t frames){
+    if(channels<=0)return;
+    while(frames>0){
+      if(pendingLengths.empty() || pendingLengths.back()==BLOCK_FRAMES){
+        pendingLengths.push_back(0);
+        pendingValues.emplace_back();
+      }
+      const size_t n=static_cast<size_t>(std::min<uint64_t>(frames,BLOCK_FRAMES-pendingLengths.back()));
+      scanInterleaved(interleaved,n,pendingValues.back());
+      pendingLengths.back()+=n;
+      scanned+=n;
+      interleaved+=n*channels;
+      frames-=n;
+    }
+  }
+  void finish(){
+    tree.assign(pendingLengths,pendingValues);
+    pendingLengths.clear();
+    pendingValues.clear();
+  }
+
+  // Old frames [startFrame,oldEnd) were replaced by new frames [startFrame,newEnd)
+  void replace(const FrameSource& samples,uint64_t startFrame,uint64_t oldEnd,uint64_t newEnd){
+    if(channels<=0)return;
+    const BlockTree<Summary>::Span s=tree.cover(startFrame,oldEnd,newEnd>startFrame?newEnd-startFrame:0,BLOCK_FRAMES/2);
+    std::vector<uint64_t>lengths;
+    BlockTree<Summary>::chunk(s.newEnd-s.first,BLOCK_FRAMES,lengths);
+    std::vector<Summary>values(lengths.size());
+    std::vector<float>scratch;
+    uint64_t at=s.first;
+    for(size_t b=0;b<lengths.size();++b){
+      scanFrames(samples,at,at+lengths[b],values[b],scratch);
+      at+=lengths[b];
+    }
+    scanned+=s.newEnd-s.first;
+    tree.splice(s,lengths,values);
+  }
+
+  // Frames [startFrame,endFrame) were overwritten in place. If the length
+  // changed without saying where, everything from startFrame on is replaced;
+  // prefer replace().
+  void update(const FrameSource& samples,uint64_t frames,uint64_t startFrame,uint64_t endFrame=UINT64_MAX){
+    const uint64_t old=tree.frames();
+    if(frames!=old)replace(samples,startFrame,old,frames);
+    else replace(samples,startFrame,std::min(endFrame,old),std::min(endFrame,old));
+  }
+  void update(const std::vector<float>& samples,uint64_t startFrame,uint64_t endFrame=UINT64_MAX){
+    if(channels>0)update(samples,samples.size()/channels,startFrame,endFrame);
+  }
+
+  inline const Summary& total()const{return tree.total(0);}
+  inline uint64_t getTotalFrames()const{return tree.frames();}
+  inline int getChannels()const{return channels;}
+  inline size_t getBlocks()const{return tree.blocks();}
+  inline uint64_t getFramesScanned()const{return scanned;}
+
+  // Summary of frames [startFrame,endFrame)
+  Summary query(const FrameSource& samples,uint64_t startFrame,uint64_t endFrame)const{
+    Summary s;
+    if(channels<=0)return s;
+    std::vector<float>scratch;
+    tree.query(0,startFrame,endFrame,s,[&](uint64_t f0,uint64_t f1,Summary& out){scanFrames(samples,f0,f1,out,scratch);});
+    return s;
+  }
+
+  private:
+  void scanFrames(const FrameSource& samples,uint64_t f0,uint64_t f1,Summary& s,std::vector<float>& scratch)const{
+    if(f1<=f0)return;
+    const size_t n=static_cast<size_t>(f1-f0);
+    scanInterleaved(samples.get(f0,n,channels,scratch),n,s);
+  }
+
+  void scanInterleaved(const float *p,size_t frames,Summary& s)const{
+    const size_t n=frames*channels;
+    float mn=s.min,mx=s.max;
+    double sq=0.0;
+    uint64_t clips=0;
+    for(size_t i=0;i<n;++i){
+      const float v=p[i];
+      mn=std::min(mn,v);
+      mx=std::max(mx,v);
+      sq+=static_cast<double>(v)*v;
+      clips+=std::fabs(v)>=CLIP_LEVEL;
+    }
+    s.min=mn;
+    s.max=mx;
+    s.sumSq+=sq;
+    s.count+=n;
+    s.clips+=clips;
+  }
+};
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.hpp"
+#include "parallel.hpp"
+
+/*
+ * PCM -> float kernels
+ *
+ * Samples are converted LANES at a time through small local arrays, so the
+ * compiler sees fixed-size, non-aliasing loops and emits SIMD for them even
+ * at -O2; only the tail runs one by one. Input is little-endian, as in every
+ * WAV file.
+*/
+struct PcmConvert{
+  static constexpr size_t LANES=16;
+
+  static void u8(const uint8_t *in,float *out,size_t n){
+    run<1>(in,out,n,[](const uint8_t *p){return (static_cast<int>(p[0])-128)*(1.0f/128.0f);});
+  }
+  static void s16(const uint8_t *in,float *out,size_t n){
+    run<2>(in,out,n,[](const uint8_t *p){
+      int16_t v;
+      std::memcpy(&v,p,2);
+      return v*(1.0f/32768.0f);
+    });
+  }
+  static void s24(const uint8_t *in,float *out,size_t n){
+    run<3>(in,out,n,[](const uint8_t *p){
+      // assemble in the top 24 bits, the arithmetic shift sign-extends
+      const int32_t v=static_cast<int32_t>(static_cast<uint32_t>(p[0])<<8 | static_cast<uint32_t>(p[1])<<16 | static_cast<uint32_t>(p[2])<<24)>>8;
+      return v*(1.0f/8388608.0f);
+    });
+  }
+  static void s32(const uint8_t *in,float *out,size_t n){
+    run<4>(in,out,n,[](const uint8_t *p){
+      int32_t v;
+      std::memcpy(&v,p,4);
+      return static_cast<float>(v)*(1.0f/2147483648.0f);
+    });
+  }
+  static void f32(const uint8_t *in,float *out,size_t n){std::memcpy(out,in,n*sizeof(float));}
+  static void f64(const uint8_t *in,float *out,size_t n){
+    run<8>(in,out,n,[](const uint8_t *p){
+      double v;
+      std::memcpy(&v,p,8);
+      return static_cast<float>(v);
+    });
+  }
+
+  private:
+  template<size_t BYTES,typename Fn>static void run(const uint8_t *in,float *out,size_t n,Fn sample){
+    size_t i=0;
+    for(;i+LANES<=n;i+=LANES){
+      uint8_t src[LANES*BYTES];
+      float dst[LANES];
+      std::memcpy(src,in+i*BYTES,sizeof(src));
+      for(size_t k=0;k<LANES;++k)dst[k]=sample(src+k*BYTES);
+      std::memcpy(out+i,dst,sizeof(dst));
+    }
+    for(;i<n;++i)out[i]=sample(in+i*BYTES);
+  }
+};
+
+/*
+ * Native WAV / RF64 / BW64 reader
+ *
+ * Parses the RIFF chunk list once (fmt, data, ds64, LIST INFO/adtl, cue,
+ * smpl) and then reads sample data with large pread() calls straight into a
+ * block buffer that the PcmConvert kernels turn into interleaved floats.
+ * readAll() splits the file across threads, each with its own pread offset.
+ * Only uncompressed PCM and IEEE float are handled; open() returns false for
+ * anything else so the caller can fall back to libsndfile.
+*/
+class WavReader{
+  public:
+  static constexpr size_t BLOCK_BYTES=1<<22;
+
+  enum class Encoding{Unsigned8,Int16,Int24,Int32,Float32,Float64};
+
+  struct CuePoint{
+    uint32_t id=0;
+    uint64_t frame=0;
+    std::string label;       // from LIST adtl "labl"
+  };
+  struct Loop{
+    uint32_t cueId=0;
+    uint32_t type=0;         // 0=forward, 1=ping-pong, 2=backward
+    uint64_t start=0;        // frames, end inclusive as stored
+    uint64_t end=0;
+    uint32_t playCount=0;    // 0 => infinite
+  };
+  struct Info{
+    uint16_t formatTag=0;    // 1=PCM, 3=float (resolved through WAVE_FORMAT_EXTENSIBLE)
+    Encoding encoding=Encoding::Int16;
+    uint16_t channels=0;
+    uint32_t sampleRate=0;
+    uint16_t bitsPerSample=0;   // valid bits
+    uint16_t blockAlign=0;
+    uint32_t channelMask=0;
+    uint64_t frames=0;
+    uint64_t dataOffset=0;
+    uint64_t dataBytes=0;
+    bool rf64=false;
+    int unityNote=-1;        // smpl MIDI unity note, -1 if absent
+    std::map<std::string,std::string>tags; // title, artist, album, date, comment, genre, tracknumber, ...
+    std::vector<CuePoint>cues;
+    std::vector<Loop>loops;
+  };
+
+  private:
+  int fd=-1;
+  uint64_t fileSize=0;
+  Info info;
+  size_t sampleBytes=0;      // container bytes per sample
+  std::map<uint32_t,std::string>labels; // cue id -> adtl label, while parsing
+
+  public:
+  WavReader(){}
+  WavReader(const WavReader&)=delete;
+  WavReader& operator=(const WavReader&)=delete;
+  ~WavReader(){close();}
+
+  // false (quietly) when the file is not a WAV this reader can decode
+  bool open(const std::string& path){
+    close();
+    fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0)return false;
+    struct stat st;
+    if(fstat(fd,&st)!=0 || !parse(static_cast<uint64_t>(st.st_size))){
+      close();
+      return false;
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd,static_cast<off_t>(info.dataOffset),static_cast<off_t>(info.dataBytes),POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+  }
+
+  void close(){
+    if(fd>=0)::close(fd);
+    fd=-1;
+    info=Info{};
+    labels.clear();
+  }
+
+  inline bool isOpen()const{return fd>=0;}
+  inline const Info& getInfo()const{return info;}
+  inline uint64_t frames()const{return info.frames;}
+  inline int getChannels()const{return info.channels;}
+
+  // Interleaved floats for [frame,frame+count); returns frames read. Thread-safe.
+  size_t read(uint64_t frame,float *out,size_t count)const{
+    if(fd<0 || frame>=info.frames)return 0;
+    count=static_cast<size_t>(std::min<uint64_t>(count,info.frames-frame));
+    const size_t frameBytes=info.blockAlign;
+    const size_t perBlock=std::max<size_t>(1,BLOCK_BYTES/frameBytes);
+    std::vector<uint8_t>block(std::min(count,perBlock)*frameBytes);
+    size_t done=0;
+    while(done<count){
+      const size_t n=std::min(count-done,perBlock);
+      const size_t got=preadAll(fd,block.data(),n*frameBytes,info.dataOffset+(frame+done)*frameBytes)/frameBytes;
+      convert(block.data(),out+done*info.channels,got*info.channels);
+      done+=got;
+      if(got<n)break;
+    }
+    return done;
+  }
+
+  // Whole file, decoded in parallel ranges
+  bool readAll(std::vector<float>& out,size_t maxThreads=0)const{
+    out.resize(static_cast<size_t>(info.frames*info.channels));
+    std::atomic<bool>shortRead{false};
+    const size_t minFrames=std::max<size_t>(1,(BLOCK_BYTES*4)/std::max<size_t>(1,info.blockAlign));
+    parallelRanges(static_cast<size_t>(info.frames),minFrames,[&](size_t begin,size_t end){
+      if(read(begin,out.data()+begin*info.channels,end-begin)!=end-begin)shortRead.store(true);
+    },maxThreads);
+    if(shortRead.load()){
+      std::cerr << "WAV data ended early" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  private:
+  template<typename T>static T le(const uint8_t *p){
+    T v;
+    std::memcpy(&v,p,sizeof(T));
+    return v;
+  }
+
+  bool readChunk(uint64_t offset,uint64_t size,std::vector<uint8_t>& body)const{
+    if(size>(64u<<20))return false; // metadata only; nothing sane is this big
+    body.resize(static_cast<size_t>(size));
+    return preadAll(fd,body.data(),body.size(),offset)==body.size();
+  }
+
+  void convert(const uint8_t *in,float *out,size_t samples)const{
+    switch(info.encoding){
+      case Encoding::Unsigned8: PcmConvert::u8(in,out,samples);break;
+      case Encoding::Int16:     PcmConvert::s16(in,out,samples);break;
+      case Encoding::Int24:     PcmConvert::s24(in,out,samples);break;
+      case Encoding::Int32:     PcmConvert::s32(in,out,samples);break;
+      case Encoding::Float32:   PcmConvert::f32(in,out,samples);break;
+      case Encoding::Float64:   PcmConvert::f64(in,out,samples);break;
+    }
+  }
+
+  bool parse(uint64_t size){
+    fileSize=size;
+    uint8_t head[12];
+    if(preadAll(fd,head,12,0)!=12 || std::memcmp(head+8,"WAVE",4)!=0)return false;
+    info.rf64=std::memcmp(head,"RF64",4)==0 || std::memcmp(head,"BW64",4)==0;
+    if(!info.rf64 && std::memcmp(head,"RIFF",4)!=0)return false;
+
+    uint64_t ds64Data=0;
+    bool haveFmt=false,haveData=false;
+    std::vector<uint8_t>body;
+    for(uint64_t at=12;at+8<=fileSize;){
+      uint8_t h[8];
+      if(preadAll(fd,h,8,at)!=8)break;
+      const uint64_t bodyAt=at+8;
+      uint64_t chunkSize=le<uint32_t>(h+4);
+
+      if(std::memcmp(h,"ds64",4)==0){
+        if(readChunk(bodyAt,chunkSize,body) && body.size()>=24)ds64Data=le<uint64_t>(body.data()+8);
+      }else if(std::memcmp(h,"fmt ",4)==0){
+        if(!readChunk(bodyAt,chunkSize,body) || !parseFormat(body))return false;
+        haveFmt=true;
+      }else if(std::memcmp(h,"data",4)==0){
+        if(info.rf64 && chunkSize==0xFFFFFFFFu)chunkSize=ds64Data;
+        // streamed/unfinished writers leave 0 or a bogus size: take what is there
+        if(chunkSize==0 || bodyAt+chunkSize>fileSize)chunkSize=fileSize-bodyAt;
+        info.dataOffset=bodyAt;
+        info.dataBytes=chunkSize;
+        haveData=true;
+      }else if(std::memcmp(h,"LIST",4)==0){
+        if(readChunk(bodyAt,chunkSize,body))parseList(body);
+      }else if(std::memcmp(h,"cue ",4)==0){
+        if(readChunk(bodyAt,chunkSize,body))parseCues(body);
+      }else if(std::memcmp(h,"smpl",4)==0){
+        if(readChunk(bodyAt,chunkSize,body))parseSampler(body);
+      }
+      at=bodyAt+chunkSize+(chunkSize&1); // chunks are word aligned
+    }
+    if(!haveFmt || !haveData)return false;
+    info.frames=info.dataBytes/info.blockAlign;
+    info.dataBytes=info.frames*info.blockAlign;
+
+    // cue labels arrive in LIST adtl, possibly before the cue chunk
+    for(CuePoint& c:info.cues){
+      auto it=labels.find(c.id);
+      if(it!=labels.end())c.label=it->second;
+    }
+    labels.clear();
+    return true;
+  }
+
+  bool parseFormat(const std::vector<uint8_t>& b){
+    if(b.size()<16)return false;
+    info.formatTag=le<uint16_t>(b.data());
+    info.channels=le<uint16_t>(b.data()+2);
+    info.sampleRate=le<uint32_t>(b.data()+4);
+    info.blockAlign=le<uint16_t>(b.data()+12);
+    info.bitsPerSample=le<uint16_t>(b.data()+14);
+    if(info.formatTag==0xFFFE){ // WAVE_FORMAT_EXTENSIBLE
+      if(b.size()<40)return false;
+      const uint16_t valid=le<uint16_t>(b.data()+18);
+      if(valid)info.bitsPerSample=valid;
+      info.channelMask=le<uint32_t>(b.data()+20);
+      info.formatTag=le<uint16_t>(b.data()+24); // first two bytes of the sub-format GUID
+    }
+    if(info.channels==0 || info.sampleRate==0 || info.blockAlign%info.channels)return false;
+    sampleBytes=info.blockAlign/info.channels;
+    if(info.formatTag==1){
+      switch(sampleBytes){
+        case 1: info.encoding=Encoding::Unsigned8;break;
+        case 2: info.encoding=Encoding::Int16;break;
+        case 3: info.encoding=Encoding::Int24;break;
+        case 4: info.encoding=Encoding::Int32;break; // also 24-in-32, left justified
+        default: return false;
+      }
+    }else if(info.formatTag==3){
+      if(sampleBytes==4)info.encoding=Encoding::Float32;
+      else if(sampleBytes==8)info.encoding=Encoding::Float64;
+      else return false;
+    }else return false; // ADPCM, A-law, ... are left to libsndfile
+    return true;
+  }
+
+  static std::string zstring(const uint8_t *p,size_t n){
+    return std::string(reinterpret_cast<const char*>(p),strnlen(reinterpret_cast<const char*>(p),n));
+  }
+
+  void parseList(const std::vector<uint8_t>& b){
+    if(b.size()<4)return;
+    static const std::map<std::string,std::string>infoKeys={
+      {"INAM","title"},{"IART","artist"},{"IPRD","album"},{"ICRD","date"},
+      {"ICMT","comment"},{"IGNR","genre"},{"ITRK","tracknumber"},{"IPRT","tracknumber"},
+      {"ISFT","software"},{"ICOP","copyright"},{"IENG","engineer"}
+    };
+    const bool isInfo=std::memcmp(b.data(),"INFO",4)==0;
+    const bool isAdtl=std::memcmp(b.data(),"adtl",4)==0;
+    for(size_t at=4;at+8<=b.size();){
+      const std::string id(reinterpret_cast<const char*>(b.data()+at),4);
+      const size_t n=std::min<size_t>(le<uint32_t>(b.data()+at+4),b.size()-at-8);
+      const uint8_t *p=b.data()+at+8;
+      if(isInfo){
+        auto key=infoKeys.find(id);
+        info.tags[key!=infoKeys.end()?key->second:id]=zstring(p,n);
+      }else if(isAdtl && (id=="labl" || id=="note") && n>=4){
+        if(id=="labl" || !labels.count(le<uint32_t>(p)))labels[le<uint32_t>(p)]=zstring(p+4,n-4);
+      }
+      at+=8+n+(n&1);
+    }
+  }
+
+  void parseCues(const std::vector<uint8_t>& b){
+    if(b.size()<4)return;
+    const size_t count=std::min<size_t>(le<uint32_t>(b.data()),(b.size()-4)/24);
+    for(size_t i=0;i<count;++i){
+      const uint8_t *p=b.data()+4+i*24;
+      CuePoint c;
+      c.id=le<uint32_t>(p);
+      c.frame=le<uint32_t>(p+20); // sample offset within the data chunk
+      info.cues.push_back(c);
+    }
+  }
+
+  void parseSampler(const std::vector<uint8_t>& b){
+    if(b.size()<36)return;
+    info.unityNote=static_cast<int>(le<uint32_t>(b.data()+12));
+    const size_t count=std::min<size_t>(le<uint32_t>(b.data()+28),(b.size()-36)/24);
+    for(size_t i=0;i<count;++i){
+      const uint8_t *p=b.data()+36+i*24;
+      Loop l;
+      l.cueId=le<uint32_t>(p);
+      l.type=le<uint32_t>(p+4);
+      l.start=le<uint32_t>(p+8);
+      l.end=le<uint32_t>(p+12);
+      l.playCount=le<uint32_t>(p+20);
+      info.loops.push_back(l);
+    }
+  }
+};
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "dither.hpp"
+#include "io.hpp"
+
+// Output format for WavWriter
+struct WavWriteOptions{
+  int bits=16;                 // 8, 16, 24, 32
+  bool floatingPoint=false;    // 32-bit IEEE float, no quantization
+  bool dither=true;
+  Quantizer::Shaping shaping=Quantizer::Shaping::None;
+  uint32_t channelMask=0;      // speaker positions, 0 => WavWriter::defaultChannelMask()
+  bool background=false;       // write buffers from a separate thread
+  size_t bufferBytes=4u<<20;
+};
+
+/*
+ * Streaming WAV writer
+ *
+ * Samples are quantized (Quantizer: dither / noise shaping) block by block
+ * straight into a large page-aligned buffer; the file only sees one write()
+ * per full buffer. With a background thread two buffers alternate, so
+ * conversion of the next one overlaps the write of the last and export runs
+ * at disk speed.
+ *
+ * More than 16 bits or more than two channels are written as
+ * WAVE_FORMAT_EXTENSIBLE, with the valid bits, the speaker mask and the PCM
+ * or float sub-format GUID, as the format spec asks for.
+ *
+ * The header reserves a JUNK chunk the size of a ds64 chunk. close() patches
+ * the sizes in place, and when the data outgrew 4 GB turns RIFF into RF64 and
+ * the JUNK into ds64 (EBU Tech 3306), so nothing has to be moved.
+*/
+class WavWriter{
+  public:
+  using Options=WavWriteOptions;
+
+  private:
+  static constexpr size_t ALIGN=4096;
+  static constexpr uint64_t RIFF_LIMIT=0xFFFFFFFFull;
+  static constexpr uint64_t DS64_BYTES=28;
+
+  struct Buffer{
+    std::unique_ptr<uint8_t,decltype(&std::free)>data{nullptr,&std::free};
+    size_t used=0;
+    uint64_t offset=0;           // file position of data[0]
+  };
+
+  int fd=-1;
+  std::string path;
+  int channels=0;
+  uint32_t sampleRate=0;
+  Options options;
+  size_t sampleBytes=0;
+  size_t capacity=0;             // bytes per buffer, whole frames
+  uint64_t dataOffset=0;
+  uint64_t dataBytes=0;
+  uint64_t factOffset=0;         // 0 => no fact chunk (PCM)
+  std::atomic<bool>failed{false};
+
+  Quantizer quantizer;
+  std::vector<int32_t>quantized;
+
+  Buffer buffers[2];
+  int filling=0;
+
+  // background writer
+  std::thread writer;
+  std::mutex lock;
+  std::condition_variable wake;
+  int pending=-1;                // buffer handed to the writer
+  bool quit=false;
+
+  public:
+  WavWriter(){}
+  WavWriter(const WavWriter&)=delete;
+  WavWriter& operator=(const WavWriter&)=delete;
+  ~WavWriter(){close();}
+
+  bool open(const std::string& filePath,int numChannels,uint32_t rate,const Options& opts=Options{}){
+    close();
+    if(numChannels<=0 || rate==0){
+      std::cerr << "Invalid WAV format for: " << filePath << std::endl;
+      return false;
+    }
+    path=filePath;
+    channels=numChannels;
+    sampleRate=rate;
+    options=opts;
+    if(options.floatingPoint)options.bits=32;
+    else options.bits=options.bits<=8?8:options.bits<=16?16:options.bits<=24?24:32;
+    sampleBytes=static_cast<size_t>(options.bits/8);
+    quantizer.configure(options.bits,channels,options.dither,options.shaping);
+
+    const size_t frameBytes=sampleBytes*channels;
+    capacity=std::max(options.bufferBytes,ALIGN)/frameBytes*frameBytes;
+    for(Buffer& b:buffers){
+      b.data.reset(static_cast<uint8_t*>(std::aligned_alloc(ALIGN,(capacity+ALIGN-1)/ALIGN*ALIGN)));
+      b.used=0;
+      if(!b.data){
+        std::cerr << "Out of memory for WAV buffers" << std::endl;
+        return false;
+      }
+    }
+    quantized.resize(std::max<size_t>(1,Quantizer::BLOCK_SIZE*8/channels)*channels);
+
+    fd=::open(path.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if(fd<0){
+      std::cerr << "Error opening file for writing: " << path << std::endl;
+      return false;
+    }
+    failed=false;
+    dataBytes=0;
+    if(!writeHeader()){
+      ::close(fd);
+      fd=-1;
+      return false;
+    }
+    filling=0;
+    buffers[0].offset=dataOffset;
+    if(options.background){
+      quit=false;
+      pending=-1;
+      writer=std::thread([this]{run();});
+    }
+    return true;
+  }
+
+  // Usual speaker layout for a channel count (WAVEFORMATEXTENSIBLE dwChannelMask)
+  static uint32_t defaultChannelMask(int numChannels){
+    switch(numChannels){
+      case 1: return 0x4;     // FC
+      case 2: return 0x3;     // FL FR
+      case 3: return 0x7;     // FL FR FC
+      case 4: return 0x33;    // FL FR BL BR
+      case 5: return 0x37;    // FL FR FC BL BR
+      case 6: return 0x3F;    // 5.1
+      case 7: return 0x13F;   // 6.1
+      case 8: return 0x63F;   // 7.1
+      default: return 0;
+    }
+  }
+
+  inline bool isOpen()const{return fd>=0;}
+  inline uint64_t frames()const{return (dataBytes+buffers[filling].used)/(sampleBytes*channels);}
+  inline const std::string& getPath()const{return path;}
+
+  // Append interleaved frames
+  bool write(const float *in,size_t count){
+    if(fd<0 || failed)return false;
+    const size_t frameBytes=sampleBytes*channels;
+    const size_t blockFrames=quantized.size()/channels;
+    while(count>0){
+      Buffer& b=buffers[filling];
+      const size_t n=std::min({count,blockFrames,(capacity-b.used)/frameBytes});
+      const size_t samples=n*channels;
+      uint8_t *dst=b.data.get()+b.used;
+      if(options.floatingPoint)std::memcpy(dst,in,samples*sizeof(float));
+      else{
+        quantizer.process(in,quantized.data(),samples);
+        Quantizer::packPCM(quantized.data(),dst,samples,options.bits);
+      }
+      b.used+=n*frameBytes;
+      in+=samples;
+      count-=n;
+      if(b.used==capacity && !flush())return false;
+    }
+    return true;
+  }
+  inline bool write(const std::vector<float>& interleaved){return write(interleaved.data(),interleaved.size()/std::max(channels,1));}
+
+  // Write out what is buffered, patch the header and close; false if anything failed
+  bool close(){
+    if(fd<0)return true;
+    bool ok=!failed && flush();
+    if(writer.joinable()){
+      {std::lock_guard<std::mutex>guard(lock);quit=true;}
+      wake.notify_all();
+      writer.join();
+    }
+    ok=ok && !failed && finalize();
+    if(::close(fd)!=0)ok=false;
+    fd=-1;
+    if(!ok)std::cerr << "Error writing WAV file: " << path << std::endl;
+    return ok;
+  }
+
+  private:
+  template<typename T>static void put(std::vector<uint8_t>& out,T v){
+    uint8_t b[sizeof(T)];
+    std::memcpy(b,&v,sizeof(T));
+    out.insert(out.end(),b,b+sizeof(T));
+  }
+  static void tag(std::vector<uint8_t>& out,const char *id){out.insert(out.end(),id,id+4);}
+
+  bool writeHeader(){
+    std::vector<uint8_t>h;
+    tag(h,"RIFF");put<uint32_t>(h,0);tag(h,"WAVE");
+    // placeholder for ds64 in case the file ends up over 4 GB
+    tag(h,"JUNK");put<uint32_t>(h,DS64_BYTES);h.resize(h.size()+DS64_BYTES,0);
+
+    const uint16_t format=options.floatingPoint?3:1;
+    const bool extensible=options.bits>16 || channels>2;
+    tag(h,"fmt ");
+    put<uint32_t>(h,extensible?40:(options.floatingPoint?18:16));
+    put<uint16_t>(h,extensible?0xFFFE:format);
+    put<uint16_t>(h,static_cast<uint16_t>(channels));
+    put<uint32_t>(h,sampleRate);
+    put<uint32_t>(h,static_cast<uint32_t>(sampleRate*sampleBytes*channels));
+    put<uint16_t>(h,static_cast<uint16_t>(sampleBytes*channels));
+    put<uint16_t>(h,static_cast<uint16_t>(sampleBytes*8));
+    if(extensible){
+      put<uint16_t>(h,22); // cbSize
+      put<uint16_t>(h,static_cast<uint16_t>(options.bits)); // valid bits
+      put<uint32_t>(h,options.channelMask?options.channelMask:defaultChannelMask(channels));
+      // sub-format GUID xxxxxxxx-0000-0010-8000-00aa00389b71, format tag in front
+      static const uint8_t guid[14]={0x00,0x00,0x00,0x00,0x10,0x00,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71};
+      put<uint16_t>(h,format);
+      h.insert(h.end(),guid,guid+sizeof(guid));
+    }else if(options.floatingPoint)put<uint16_t>(h,0); // cbSize
+    if(options.floatingPoint){
+      // non-PCM formats carry the frame count in a fact chunk
+      tag(h,"fact");put<uint32_t>(h,4);
+      factOffset=h.size();
+      put<uint32_t>(h,0);
+    }else factOffset=0;
+
+    tag(h,"data");put<uint32_t>(h,0);
+    dataOffset=h.size();
+    return pwriteAll(fd,h.data(),h.size(),0);
+  }
+
+  // Sizes are only known at the end; RF64 when they no longer fit 32 bits
+  bool finalize(){
+    const uint64_t frameCount=dataBytes/(sampleBytes*channels);
+    const uint64_t pad=dataBytes&1;
+    if(pad && !pwriteAll(fd,"\0",1,dataOffset+dataBytes))return false;
+    const uint64_t riffBytes=dataOffset+dataBytes+pad-8;
+    const bool rf64=riffBytes>RIFF_LIMIT;
+
+    std::vector<uint8_t>h;
+    tag(h,rf64?"RF64":"RIFF");
+    put<uint32_t>(h,rf64?0xFFFFFFFFu:static_cast<uint32_t>(riffBytes));
+    if(!pwriteAll(fd,h.data(),h.size(),0))return false;
+    if(rf64){
+      h.clear();
+      tag(h,"ds64");put<uint32_t>(h,DS64_BYTES);
+      put<uint64_t>(h,riffBytes);
+      put<uint64_t>(h,dataBytes);
+      put<uint64_t>(h,frameCount);
+      put<uint32_t>(h,0); // no table entries
+      if(!pwriteAll(fd,h.data(),h.size(),12))return false;
+    }
+    const uint32_t size32=rf64?0xFFFFFFFFu:static_cast<uint32_t>(dataBytes);
+    if(!pwriteAll(fd,&size32,4,dataOffset-4))return false;
+    if(factOffset){
+      const uint32_t frames32=rf64 || frameCount>RIFF_LIMIT?0xFFFFFFFFu:static_cast<uint32_t>(frameCount);
+      if(!pwriteAll(fd,&frames32,4,factOffset))return false;
+    }
+    return true;
+  }
+
+  // Hand the filled buffer over (or write it) and continue in the other one
+  bool flush(){
+    Buffer& b=buffers[filling];
+    if(b.used==0)return !failed;
+    const uint64_t next=b.offset+b.used;
+    dataBytes+=b.used;
+    if(writer.joinable()){
+      // at most one buffer in flight, so once it is done the other one is free
+      std::unique_lock<std::mutex>guard(lock);
+      wake.wait(guard,[this]{return pending<0;});
+      pending=filling;
+      guard.unlock();
+      wake.notify_all();
+      filling=1-filling;
+    }else if(!pwriteAll(fd,b.data.get(),b.used,b.offset))failed=true;
+    buffers[filling].used=0;
+    buffers[filling].offset=next;
+    return !failed;
+  }
+
+  void run(){
+    for(;;){
+      int slot;
+      {
+        std::unique_lock<std::mutex>guard(lock);
+        wake.wait(guard,[this]{return quit || pending>=0;});
+        if(pending<0)return; // quit with nothing left to write
+        slot=pending;
+      }
+      Buffer& b=buffers[slot];
+      const bool ok=pwriteAll(fd,b.data.get(),b.used,b.offset);
+      if(!ok)failed=true;
+      {std::lock_guard<std::mutex>guard(lock);pending=-1;}
+      wake.notify_all();
+    }
+  }
+
+};
@@ -6,6 +6,9 @@
 
 #include "graphics/ui/Button.hpp"
 #include "core/audio.hpp"
+#include "core/project_file.hpp"
+#include "core/autosave.hpp"
+#include "core/convert.hpp"
 #include "math/Math.hpp"
 
 const std::vector<std::string>bannerSmall={
@@ -36,9 +36,148 @@ struct Settings{
 };
 
 static Settings settings;
+static const char *SETTINGS_PATH="sizzlefx.settings";
+static const char *AUTOSAVE_PATH="sizzlefx.autosave";
+static const char *SESSION_PATH="sizzlefx.session";
+
+std::map<std::string,std::string>settingsToMap(const Settings& s){
+  return {
+    {"mainMenu.banner",s.mainMenu.banner},
+    {"mainMenu.playBGM",std::to_string(s.mainMenu.playBGM)},
+    {"keys.up",std::to_string(s.keys.up)},
+    {"keys.down",std::to_string(s.keys.down)},
+    {"keys.left",std::to_string(s.keys.left)},
+    {"keys.right",std::to_string(s.keys.right)},
+    {"keys.select",std::to_string(s.keys.select)},
+    {"keys.quit",std::to_string(s.keys.quit)},
+    {"layout.showStatusBar",std::to_string(s.layout.showStatusBar)},
+    {"layout.showSidePanel",std::to_string(s.layout.showSidePanel)},
+    {"layout.padding",std::to_string(s.layout.padding)},
+    {"theme.colorScheme",std::to_string(s.theme.colorScheme)}
+  };
+}
+
+// Unknown keys are ignored and missing ones keep their defaults
+void settingsFromMap(Settings& s,const std::map<std::string,std::string>& m){
+  auto get=[&m](const char *key,auto& value){
+    auto it=m.find(key);
+    if(it==m.end())return;
+    if constexpr(std::is_same_v<std::decay_t<decltype(value)>,std::string>)value=it->second;
+    else value=static_cast<std::decay_t<decltype(value)>>(std::atoi(it->second.c_str()));
+  };
+  get("mainMenu.banner",s.mainMenu.banner);
+  get("mainMenu.playBGM",s.mainMenu.playBGM);
+  get("keys.up",s.keys.up);
+  get("keys.down",s.keys.down);
+  get("keys.left",s.keys.left);
+  get("keys.right",s.keys.right);
+  get("keys.select",s.keys.select);
+  get("keys.quit",s.keys.quit);
+  get("layout.showStatusBar",s.layout.showStatusBar);
+  get("layout.showSidePanel",s.layout.showSidePanel);
+  get("layout.padding",s.layout.padding);
+  get("theme.colorScheme",s.theme.colorScheme);
+}
+
+bool loadSettings(){
+  ProjectFile file;
+  if(access(SETTINGS_PATH,F_OK)!=0 || !file.open(SETTINGS_PATH))return false;
+  settingsFromMap(settings,file.readSettings());
+  return true;
+}
+
+bool saveSettings(){
+  ProjectFile file;
+  return file.open(SETTINGS_PATH) && file.writeSettings(settingsToMap(settings)) && file.commit();
+}
+
+// ---------------------------- Convert ----------------------------
+ConvertOptions convertOptions(uint32_t rate,int channels,int bits,bool floatingPoint){
+  ConvertOptions o;
+  o.sampleRate=rate;
+  o.channels=channels;
+  o.format.bits=bits;
+  o.format.floatingPoint=floatingPoint;
+  return o;
+}
+
+// Headless batch conversion: sizzlefx --convert [options] <file|folder>...
+int runConvertCli(int argc,char **argv){
+  ConvertOptions o=convertOptions(0,0,16,false);
+  std::vector<std::string>files;
+  for(int i=2;i<argc;i++){
+    const std::string arg=argv[i];
+    auto value=[&](){return i+1<argc?std::string(argv[++i]):std::string();};
+    if(arg=="-o" || arg=="--output"){
+      o.outputDir=value();
+    }else if(arg=="--rate"){
+      o.sampleRate=static_cast<uint32_t>(std::atoi(value().c_str()));
+    }else if(arg=="--channels"){
+      o.channels=std::atoi(value().c_str());
+    }else if(arg=="--bits"){
+      o.format.bits=std::atoi(value().c_str());
+    }else if(arg=="--float"){
+      o.format.floatingPoint=true;
+    }else if(arg=="--no-dither"){
+      o.format.dither=false;
+    }else if(arg=="--shape"){
+      const std::string shape=value();
+      o.format.shaping=shape=="weighted"?Quantizer::Shaping::Weighted:shape=="first"?Quantizer::Shaping::FirstOrder:Quantizer::Shaping::None;
+    }else if(arg=="--jobs"){
+      o.jobs=static_cast<size_t>(std::atoi(value().c_str()));
+    }else if(arg=="--suffix"){
+      o.suffix=value();
+    }else if(arg=="--overwrite"){
+      o.overwrite=true;
+    }else if(arg=="-h" || arg=="--help"){
+      files.clear();
+      break;
+    }else{
+      std::vector<std::string>found=BatchConverter::collect(arg);
+      if(found.empty())std::cerr << "No audio files in: " << arg << std::endl;
+      if(std::filesystem::is_directory(arg) && files.empty())o.inputRoot=arg;
+      files.insert(files.end(),found.begin(),found.end());
+    }
+  }
+  if(files.empty()){
+    std::cout << "usage: " << argv[0] << " --convert [-o dir] [--rate hz] [--channels n] [--bits 8|16|24|32] [--float]\n"
+                 "       [--no-dither] [--shape none|first|weighted] [--jobs n] [--suffix text] [--overwrite]\n"
+                 "       <file|folder>..." << std::endl;
+    return 1;
+  }
+
+  BatchConverter converter;
+  std::atomic<bool>done{false};
+  std::thread worker([&]{converter.run(files,o);done=true;});
+  while(!done.load()){
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::cerr << "\r" << converter.getFilesDone() << "/" << files.size() << " files" << std::flush;
+  }
+  worker.join();
+  std::cerr << std::endl;
+
+  size_t failed=0;
+  for(const BatchConverter::Result& r:converter.getResults()){
+    if(r.ok)continue;
+    failed++;
+    std::cerr << r.input << ": " << r.error << std::endl;
+  }
+  std::cout << "Converted " << files.size()-failed << "/" << files.size() << " files" << std::endl;
+  return failed?1:0;
+}
+
+int main(int argc,char **argv){
+  if(argc>1 && std::string(argv[1])=="--convert")return runConvertCli(argc,argv);
 
-int main(){
   printf("%i",Audio("samples/game_over.wav").audioFile.playbackInfo.sampleRate);
+  loadSettings();
+
+  // Pick up where a crashed session left off, else where the last one ended,
+  // and keep appending to that container
+  Project session;
+  Autosave autosave;
+  if(Autosave::reopen(AUTOSAVE_PATH,SESSION_PATH))autosave.resume(AUTOSAVE_PATH,session);
+  autosave.start(session,AUTOSAVE_PATH,30.0,[]{return settingsToMap(settings);});
 
   setlocale(LC_ALL,"");
   initscr();
@@ -48,6 +187,7 @@ int main(){
   cbreak();
   curs_set(0);
   keypad(stdscr,TRUE);
+  wtimeout(stdscr,250); // let the loop run autosave.tick() while idle
 
   UI::initColor(0,{0},{0});
   UI::initColor(1,{255,0,0},{0});
@@ -82,6 +222,17 @@ int main(){
   Audio bgm_MainMenu("samples/o.wav");
   bgm_MainMenu.setIsLoop(true);
 
+  // Convert screen
+  std::vector<std::string>convertFields={"Source","Output","Format","Sample rate","Channels","Start","Back"};
+  const std::vector<std::string>convertFormats={"16-bit","24-bit","32-bit","32-bit float"};
+  const std::vector<uint32_t>convertRates={0,44100,48000,96000};
+  const std::vector<int>convertChannels={0,1,2};
+  std::string convertSource="samples",convertOutput="converted",convertStatus;
+  int highlight_Convert=0,convertFormat=0,convertRate=0,convertChannel=0;
+  BatchConverter converter;
+  std::thread convertThread;
+  std::atomic<bool>converting{false};
+
   int state=0; // MainMenu=0, setting=1, editor=2, convert=3
   int ch;
 
@@ -115,6 +266,87 @@ int main(){
       case 2:
         running=false;
       break;
+      case 3: // Convert
+        {
+          box(stdscr,0,0);
+          mvwprintw(stdscr,1,2,"Batch convert to WAV");
+
+          if(convertThread.joinable() && !converting.load()){
+            convertThread.join();
+            size_t ok=0;
+            for(const BatchConverter::Result& r:converter.getResults())if(r.ok)ok++;
+            convertStatus="Converted "+std::to_string(ok)+"/"+std::to_string(converter.getFileCount())+" files into "+convertOutput;
+          }
+          if(converting.load())convertStatus="Converting "+std::to_string(converter.getFilesDone())+"/"+std::to_string(converter.getFileCount())+" files...";
+
+          for(size_t i=0;i<convertFields.size();i++){
+            std::string value;
+            switch(i){
+              case 0: value=convertSource;break;
+              case 1: value=convertOutput;break;
+              case 2: value="< "+convertFormats[convertFormat]+" >";break;
+              case 3: value="< "+(convertRates[convertRate]?std::to_string(convertRates[convertRate])+" Hz":std::string("keep"))+" >";break;
+              case 4: value="< "+std::string(convertChannels[convertChannel]==0?"keep":convertChannels[convertChannel]==1?"mono":"stereo")+" >";break;
+            }
+            if((int)i==highlight_Convert)wattron(stdscr,A_REVERSE);
+            mvwprintw(stdscr,3+i,4,"%-12s %s",convertFields[i].c_str(),value.c_str());
+            if((int)i==highlight_Convert)wattroff(stdscr,A_REVERSE);
+          }
+          mvwprintw(stdscr,4+convertFields.size(),4,"%s",convertStatus.c_str());
+
+          ch=wgetch(stdscr);
+          switch(ch){
+            case KEY_UP:
+              highlight_Convert--;
+              if(highlight_Convert<0)highlight_Convert=convertFields.size()-1;
+            break;
+            case KEY_DOWN:
+              highlight_Convert++;
+              if(highlight_Convert>=(int)convertFields.size())highlight_Convert=0;
+            break;
+            case KEY_LEFT:case KEY_RIGHT:
+              {
+                const int step=ch==KEY_LEFT?-1:1;
+                auto cycle=[step](int v,size_t n){return (v+step+(int)n)%(int)n;};
+                if(highlight_Convert==2)convertFormat=cycle(convertFormat,convertFormats.size());
+                if(highlight_Convert==3)convertRate=cycle(convertRate,convertRates.size());
+                if(highlight_Convert==4)convertChannel=cycle(convertChannel,convertChannels.size());
+              }
+            break;
+            case 10: // Enter
+              if(highlight_Convert==0 || highlight_Convert==1){
+                // line edit, blocking while typing
+                char buffer[512]={0};
+                wtimeout(stdscr,-1);
+                echo();
+                curs_set(1);
+                wmove(stdscr,3+highlight_Convert,17);
+                wclrtoeol(stdscr);
+                wgetnstr(stdscr,buffer,sizeof(buffer)-1);
+                noecho();
+                curs_set(0);
+                wtimeout(stdscr,250);
+                if(buffer[0])(highlight_Convert==0?convertSource:convertOutput)=buffer;
+              }else if(convertFields[highlight_Convert]=="Start" && !convertThread.joinable()){
+                std::vector<std::string>files=BatchConverter::collect(convertSource);
+                if(files.empty()){
+                  convertStatus="No audio files in "+convertSource;
+                }else{
+                  const int bits[]={16,24,32,32};
+                  ConvertOptions o=convertOptions(convertRates[convertRate],convertChannels[convertChannel],bits[convertFormat],convertFormat==3);
+                  o.outputDir=convertOutput;
+                  if(std::filesystem::is_directory(convertSource))o.inputRoot=convertSource;
+                  converting=true;
+                  convertThread=std::thread([&converter,&converting,files,o]{converter.run(files,o);converting=false;});
+                }
+              }else if(convertFields[highlight_Convert]=="Back"){
+                clear();
+                state=0;
+              }
+            break;
+          }
+        }
+      break;
       default: // MainMenu
         int btn_height=3;
         int btn_width=20;
@@ -192,6 +424,8 @@ int main(){
                 clear();
                 if(options[highlight_MainMenu]=="Settings"){
                   state=1;
+                }else if(options[highlight_MainMenu]==" Convert"){
+                  state=3;
                 }else state=2;
                 bgm_MainMenu.stop();
                 refresh();
@@ -203,6 +437,7 @@ int main(){
     }
 
     wrefresh(stdscr);
+    autosave.tick();
 
     switch(ch){
       case KEY_RESIZE: // Refresh
@@ -218,7 +453,16 @@ int main(){
     }
   }
 
+  if(convertThread.joinable()){
+    converter.cancel();
+    convertThread.join();
+  }
+
   delwin(stdscr);
   endwin();
+  saveSettings();
+  autosave.finish();
+  // the newest complete save becomes the session; only a failed rename leaves it to be recovered
+  Autosave::promote(AUTOSAVE_PATH,SESSION_PATH);
   return 0;
 }
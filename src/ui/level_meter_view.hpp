@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <ncurses.h>
+
+#include "graphics/UI.hpp"
+#include "graphics/ui/Rectangle.hpp"
+#include "../core/levels.hpp"
+
+/*
+ * Level meter view
+ *
+ * One horizontal bar per channel built from G3DL Rectangles: RMS solid, peak
+ * shaded past it, the top of the scale in the hot color, and a peak hold
+ * marker that sits for holdSeconds before falling. update() only reads the
+ * meter's triple buffer, so the audio thread is never held up by drawing.
+*/
+class LevelMeterView : public UI{
+  private:
+  LevelMeter* meter=nullptr;
+  LevelMeter::Levels levels;
+  float peakDb[LevelMeter::MAX_CHANNELS];
+  float rmsDb[LevelMeter::MAX_CHANNELS];
+  float holdDb[LevelMeter::MAX_CHANNELS];
+  double holdAge[LevelMeter::MAX_CHANNELS]{};
+  bool clipHold[LevelMeter::MAX_CHANNELS]{};
+  std::chrono::steady_clock::time_point last=std::chrono::steady_clock::now();
+
+  float floorDb=-60.0f;
+  float hotDb=-6.0f;            // start of the hot zone
+  float fallDbPerSecond=24.0f;
+  double holdSeconds=1.5;
+  short hotColorPairID=0;
+  short holdColorPairID=0;
+
+  Rectangle bar,hold;
+
+  public:
+  LevelMeterView(){reset();}
+  LevelMeterView(const Vector2i& position,const Vector2i& size){pos_m.set(position);size_m.set(size);reset();}
+
+  void setMeter(LevelMeter& levelMeter){meter=&levelMeter;reset();}
+  void setRange(float lowDb,float hotStartDb){floorDb=std::min(lowDb,-1.0f);hotDb=std::min(0.0f,std::max(floorDb,hotStartDb));}
+  void setBallistics(float fallRate,double holdTime){fallDbPerSecond=std::max(0.0f,fallRate);holdSeconds=std::max(0.0,holdTime);}
+  void setHotColorPairID(short id){hotColorPairID=id;}
+  void setHoldColorPairID(short id){holdColorPairID=id;}
+
+  // Clear peak hold and clip indicators
+  void reset(){
+    std::fill(peakDb,peakDb+LevelMeter::MAX_CHANNELS,-200.0f);
+    std::fill(rmsDb,rmsDb+LevelMeter::MAX_CHANNELS,-200.0f);
+    std::fill(holdDb,holdDb+LevelMeter::MAX_CHANNELS,-200.0f);
+    std::fill(holdAge,holdAge+LevelMeter::MAX_CHANNELS,0.0);
+    std::fill(clipHold,clipHold+LevelMeter::MAX_CHANNELS,false);
+  }
+
+  inline int getChannels()const{return levels.channels;}
+  inline float getHoldDb(int channel)const{return holdDb[channel];}
+
+  // Call once per UI frame before draw()
+  void update(){
+    const auto now=std::chrono::steady_clock::now();
+    const double dt=std::chrono::duration<double>(now-last).count();
+    last=now;
+    const float fall=static_cast<float>(fallDbPerSecond*dt);
+
+    const bool fresh=meter && meter->read(levels);
+    for(int c=0;c<levels.channels;++c){
+      const float p=fresh?LevelMeter::toDB(levels.peak[c]):-200.0f;
+      const float r=fresh?LevelMeter::toDB(levels.rms[c]):-200.0f;
+      // instant attack, linear fall in dB
+      peakDb[c]=std::max(p,peakDb[c]-fall);
+      rmsDb[c]=std::max(r,rmsDb[c]-fall);
+      if(p>=holdDb[c]){holdDb[c]=p;holdAge[c]=0.0;}
+      else if((holdAge[c]+=dt)>holdSeconds)holdDb[c]=std::max(peakDb[c],holdDb[c]-fall);
+      if(fresh && levels.clipped[c])clipHold[c]=true;
+    }
+  }
+
+  void draw(WINDOW* window)override{
+    if(levels.channels<=0 || size_m.x<=2 || size_m.y<=0)return;
+    const int width=size_m.x-1; // last column is the clip light
+    const int rows=std::max(1,size_m.y/levels.channels);
+    const int hotCol=toColumn(hotDb,width);
+
+    for(int c=0;c<levels.channels;++c){
+      const int y=pos_m.y+c*rows;
+      const int peakCols=toColumn(peakDb[c],width);
+      const int rmsCols=std::min(peakCols,toColumn(rmsDb[c],width));
+
+      fill(window,pos_m.x,y,rmsCols,rows,"█",colorPairID_m);
+      fill(window,pos_m.x+rmsCols,y,peakCols-rmsCols,rows,"▒",colorPairID_m);
+      if(rmsCols>hotCol)fill(window,pos_m.x+hotCol,y,rmsCols-hotCol,rows,"█",hotColorPairID);
+      const int shadeStart=std::max(hotCol,rmsCols);
+      if(peakCols>shadeStart)fill(window,pos_m.x+shadeStart,y,peakCols-shadeStart,rows,"▒",hotColorPairID);
+
+      if(holdDb[c]>floorDb){
+        const int h=std::max(0,std::min(width-1,toColumn(holdDb[c],width)-1));
+        hold.setPosition(pos_m.x+h,y);
+        hold.setSize(1,rows);
+        hold.setHasBorder(false);
+        hold.setFillCharacter("▌");
+        hold.setColorPairID(holdDb[c]>=hotDb?hotColorPairID:holdColorPairID);
+        hold.draw(window);
+      }
+      fill(window,pos_m.x+width,y,1,rows,clipHold[c]?"█":"·",clipHold[c]?hotColorPairID:colorPairID_m);
+    }
+  }
+
+  private:
+  int toColumn(float db,int width)const{
+    const float t=(std::min(0.0f,db)-floorDb)/-floorDb;
+    return std::max(0,std::min(width,static_cast<int>(t*width+0.5f)));
+  }
+
+  void fill(WINDOW* window,int x,int y,int w,int h,const char* glyph,short pair){
+    if(w<=0 || h<=0)return;
+    bar.setHasBorder(false);
+    bar.setPosition(x,y);
+    bar.setSize(w,h);
+    bar.setFillCharacter(glyph);
+    bar.setColorPairID(pair);
+    bar.draw(window);
+  }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <ncurses.h>
+
+#include "graphics/UI.hpp"
+#include "../core/spectrogram.hpp"
+
+/*
+ * Spectrogram view
+ *
+ * One terminal cell per (time, frequency band), colored from a heat map of
+ * background color pairs. Tiles that are still being computed are drawn
+ * blank and show up on a later frame; drawing never waits for an FFT.
+*/
+class SpectrogramView : public UI{
+  private:
+  Spectrogram* engine=nullptr;
+  uint64_t viewStart=0;          // first spectrogram column in view
+  double columnsPerCell=1.0;     // horizontal zoom
+  float floorDb=-90.0f;          // bottom of the color range
+  float ceilDb=0.0f;
+  bool logFrequency=true;
+  short basePairID=32;           // first of levels pairs, see initColorMap
+  int levels=0;
+
+  public:
+  SpectrogramView(){}
+  SpectrogramView(const Vector2i& position,const Vector2i& size){pos_m.set(position);size_m.set(size);}
+
+  void setEngine(Spectrogram& spectrogram){engine=&spectrogram;}
+  void setView(uint64_t startColumn,double columnsPerCell_){viewStart=startColumn;columnsPerCell=std::max(1.0/16.0,columnsPerCell_);}
+  void setRange(float lowDb,float highDb){floorDb=lowDb;ceilDb=std::max(highDb,lowDb+1.0f);}
+  void setLogFrequency(bool enable){logFrequency=enable;}
+
+  inline uint64_t getViewStart()const{return viewStart;}
+  inline double getColumnsPerCell()const{return columnsPerCell;}
+
+  // Black -> purple -> red -> yellow -> white, as background colors
+  void initColorMap(short firstPairID=32,int count=16,UI::ColorMode mode=UI::ColorMode::EXTENDED){
+    basePairID=firstPairID;
+    levels=std::max(2,count);
+    static const Vector3i stops[]={{0,0,0},{80,0,120},{220,30,40},{255,200,0},{255,255,255}};
+    const int segments=4;
+    for(int i=0;i<levels;++i){
+      const float t=static_cast<float>(i)/(levels-1)*segments;
+      const int s=std::min(segments-1,static_cast<int>(t));
+      const float f=t-s;
+      const Vector3i& a=stops[s];
+      const Vector3i& b=stops[s+1];
+      const Vector3i c(static_cast<int>(a.x+(b.x-a.x)*f),static_cast<int>(a.y+(b.y-a.y)*f),static_cast<int>(a.z+(b.z-a.z)*f));
+      UI::initColor(basePairID+i,c,c,mode);
+    }
+  }
+
+  void zoom(double factor,int anchorColumn){
+    const double anchor=viewStart+anchorColumn*columnsPerCell;
+    columnsPerCell=std::max(1.0/16.0,columnsPerCell*factor);
+    const double start=anchor-anchorColumn*columnsPerCell;
+    viewStart=start>0.0?static_cast<uint64_t>(start):0;
+  }
+
+  void scrollBy(int cells){
+    const double start=static_cast<double>(viewStart)+cells*columnsPerCell;
+    viewStart=start>0.0?static_cast<uint64_t>(start):0;
+  }
+
+  void draw(WINDOW* window)override{
+    if(!engine || levels==0 || size_m.x<=0 || size_m.y<=0)return;
+    const uint64_t total=engine->getTotalColumns();
+    const size_t bins=engine->getBins();
+    if(total==0 || bins<2)return;
+
+    // Request every visible tile plus one screen either side
+    const uint64_t lastColumn=std::min<uint64_t>(total-1,viewStart+static_cast<uint64_t>(size_m.x*columnsPerCell));
+    const uint64_t span=lastColumn-viewStart+1;
+    engine->prefetch(Spectrogram::tileOf(viewStart>span?viewStart-span:0),Spectrogram::tileOf(std::min(total-1,lastColumn+span)));
+
+    std::vector<std::pair<size_t,size_t>>bands(size_m.y);
+    for(int y=0;y<size_m.y;++y)bands[y]=bandForRow(y,bins);
+
+    std::shared_ptr<const Spectrogram::Tile>tile;
+    for(int x=0;x<size_m.x;++x){
+      const uint64_t column=viewStart+static_cast<uint64_t>(x*columnsPerCell);
+      if(column>=total)break;
+      const uint64_t t=Spectrogram::tileOf(column);
+      if(!tile || tile->index!=t)tile=engine->getTile(t);
+      if(!tile)continue;
+      const size_t c=static_cast<size_t>(column-t*Spectrogram::TILE_COLUMNS);
+      if(c>=tile->columns)continue;
+      const float *db=tile->column(c);
+
+      for(int y=0;y<size_m.y;++y){
+        float v=floorDb;
+        for(size_t b=bands[y].first;b<bands[y].second;++b)v=std::max(v,db[b]);
+        const float norm=(std::min(ceilDb,v)-floorDb)/(ceilDb-floorDb);
+        const short pair=basePairID+static_cast<short>(norm*(levels-1)+0.5f);
+        wattron(window,COLOR_PAIR(pair));
+        mvwaddch(window,pos_m.y+y,pos_m.x+x,' ');
+        wattroff(window,COLOR_PAIR(pair));
+      }
+    }
+  }
+
+  private:
+  // Bin range [first,second) shown by a row; row 0 is the top (highest frequency)
+  std::pair<size_t,size_t>bandForRow(int row,size_t bins)const{
+    const int rows=size_m.y;
+    const double lo=static_cast<double>(rows-1-row)/rows,hi=static_cast<double>(rows-row)/rows;
+    auto toBin=[&](double t){
+      if(!logFrequency)return t*(bins-1);
+      // log scale from bin 1 to the last bin
+      return std::pow(static_cast<double>(bins-1),t);
+    };
+    size_t a=static_cast<size_t>(toBin(lo)),b=static_cast<size_t>(std::ceil(toBin(hi)));
+    a=std::min(a,bins-1);
+    b=std::min(std::max(b,a+1),bins);
+    return {a,b};
+  }
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <ncurses.h>
+
+#include "graphics/UI.hpp"
+#include "../core/peaks.hpp"
+#include "../core/paged_store.hpp"
+
+/*
+ * Waveform view
+ *
+ * Draws one lane per channel from a PeakPyramid: the min..max span of each
+ * column as a light shade with the RMS band solid on top. Every redraw asks
+ * the pyramid for exactly one bucket per column, whatever the zoom. With a
+ * PagedStore behind the samples every redraw also tells it the visible range,
+ * so the pages for the ragged column edges are prefetched.
+*/
+class Waveform : public UI{
+  private:
+  FrameSource samples;
+  const PeakPyramid* peaks=nullptr;
+  PagedStore* store=nullptr;
+  uint64_t viewStart=0;         // first frame in view
+  double framesPerColumn=256.0; // zoom
+  short rmsColorPairID=0;
+  std::vector<PeakPyramid::Bucket>buckets;
+
+  public:
+  Waveform(){}
+  Waveform(const Vector2i& position,const Vector2i& size){pos_m.set(position);size_m.set(size);}
+
+  // e.g. setSource(audio.getFrameSource(),audio.getPeaks(),audio.getPagedStore())
+  void setSource(FrameSource source,const PeakPyramid& pyramid,PagedStore* paged=nullptr){
+    samples=std::move(source);
+    peaks=&pyramid;
+    store=paged;
+    clampView();
+  }
+
+  void setRmsColorPairID(short id){rmsColorPairID=id;}
+  void setView(uint64_t startFrame,double frames){viewStart=startFrame;framesPerColumn=std::max(1.0,frames);clampView();}
+
+  // Whole file across the width
+  void fitAll(){
+    if(!peaks || size_m.x<=0)return;
+    viewStart=0;
+    framesPerColumn=std::max(1.0,static_cast<double>(peaks->getTotalFrames())/size_m.x);
+  }
+
+  // factor<1 zooms in; the frame under anchorColumn stays put
+  void zoom(double factor,int anchorColumn){
+    const double anchor=viewStart+anchorColumn*framesPerColumn;
+    framesPerColumn=std::max(1.0,framesPerColumn*factor);
+    const double start=anchor-anchorColumn*framesPerColumn;
+    viewStart=start>0.0?static_cast<uint64_t>(start):0;
+    clampView();
+  }
+
+  void scrollBy(int columns){
+    const double start=static_cast<double>(viewStart)+columns*framesPerColumn;
+    viewStart=start>0.0?static_cast<uint64_t>(start):0;
+    clampView();
+  }
+
+  inline uint64_t getViewStart()const{return viewStart;}
+  inline double getFramesPerColumn()const{return framesPerColumn;}
+  inline uint64_t frameAtColumn(int column)const{return viewStart+static_cast<uint64_t>(column*framesPerColumn);}
+
+  void draw(WINDOW* window)override{
+    if(!peaks || peaks->empty() || size_m.x<=0 || size_m.y<=0)return;
+    if(store)store->setView(viewStart,viewStart+static_cast<uint64_t>(framesPerColumn*size_m.x));
+    const int channels=peaks->getChannels();
+    const int laneHeight=std::max(1,size_m.y/channels);
+
+    for(int c=0;c<channels;++c){
+      peaks->columns(samples,c,viewStart,framesPerColumn,size_m.x,buckets);
+      const int top=pos_m.y+c*laneHeight;
+      const float half=(laneHeight-1)*0.5f;
+      const float mid=top+half;
+
+      for(int x=0;x<size_m.x;++x){
+        const PeakPyramid::Bucket& b=buckets[x];
+        if(b.count==0){
+          wattron(window,COLOR_PAIR(colorPairID_m));
+          mvwaddstr(window,static_cast<int>(mid+0.5f),pos_m.x+x,"─");
+          wattroff(window,COLOR_PAIR(colorPairID_m));
+          continue;
+        }
+        const int y0=toRow(b.max,mid,half,top,laneHeight),y1=toRow(b.min,mid,half,top,laneHeight);
+        const float rms=b.rms();
+        const int r0=toRow(rms,mid,half,top,laneHeight),r1=toRow(-rms,mid,half,top,laneHeight);
+        for(int y=y0;y<=y1;++y){
+          const bool inRms=y>=r0 && y<=r1;
+          const short pair=inRms?rmsColorPairID:colorPairID_m;
+          wattron(window,COLOR_PAIR(pair)|(highlighted_m?A_BOLD:0));
+          mvwaddstr(window,y,pos_m.x+x,inRms?"█":"▒");
+          wattroff(window,COLOR_PAIR(pair)|(highlighted_m?A_BOLD:0));
+        }
+      }
+    }
+  }
+
+  private:
+  static int toRow(float v,float mid,float half,int top,int laneHeight){
+    v=std::min(1.0f,std::max(-1.0f,v));
+    const int row=static_cast<int>(mid-v*half+0.5f);
+    return std::min(top+laneHeight-1,std::max(top,row));
+  }
+
+  void clampView(){
+    if(!peaks)return;
+    const uint64_t total=peaks->getTotalFrames();
+    if(viewStart>=total)viewStart=total?total-1:0;
+  }
+};
@@ -6,7 +6,7 @@
 #include <ncurses.h>
 #include <string>
 #include <sstream>
-#include "core/audio.cpp"
+#include "../src/core/audio.hpp"
 
 /*
 void printHeader(HeaderWAV &header){
@@ -118,6 +118,10 @@ int main(){
       if(word[0]=="setpos")audio.setPositionInSeconds(std::stod(word[1]));
       // if(word[0]=="header")printHeader(audio.header);
       // if(word[0]=="metadata")printMetadata(audio);
+      if(word[0]=="stats"){
+        const std::vector<ChannelStats>& stats=audio.audioFile.analysis.channelStats;
+        std::cout << (word.size()>1 && word[1]=="json"?Statistics::toJSON(stats)+"\n":Statistics::toText(stats));
+      }
       if(word[0]=="status"){
         printf("Status: %s\n",audio.getState()==Audio::PlaybackState::Playing?(audio.getIsLoop()?"Playing (Looping)":"Playing"):(audio.getIsLoop()?"Loop Ready":"Stopped"));
         printf("Position: %.2lf / %.2f sec\n",audio.getPositionInSeconds(),audio.getDuration());
@@ -3,7 +3,8 @@
 #include <cstddef>
 #include <ncurses.h>
 #include <string>
-#include "core/audio.cpp"
+#include "../src/core/audio.hpp"
+#include "../src/ui/level_meter_view.hpp"
 
 int main(int argc,char *argv[]){
   // if(argc<2)return 1;
@@ -19,7 +20,17 @@ int main(int argc,char *argv[]){
   cbreak();
   curs_set(0);
   keypad(stdscr,TRUE);
-  timeout(100);
+  timeout(50);
+
+  UI::initColor(1,{0,255,0},{0});
+  UI::initColor(2,{255,0,0},{0});
+  UI::initColor(3,{255,255,0},{0});
+
+  LevelMeterView meter({0,6},{60,2});
+  meter.setMeter(audio.getLevelMeter());
+  meter.setColorPairID(1);
+  meter.setHotColorPairID(2);
+  meter.setHoldColorPairID(3);
 
   bool running=true;
   std::string status="Press 'q' to quit.";
@@ -33,6 +44,10 @@ int main(int argc,char *argv[]){
 
     mvprintw(4,0,"Position: %.2lf / %.2f sec",audio.getPositionInSeconds(),audio.getDuration());
 
+    meter.update();
+    meter.draw(stdscr);
+    for(int c=0;c<meter.getChannels();++c)mvprintw(6+c,61,"%6.1f dB",meter.getHoldDb(c));
+
     refresh();
 
     int ch=getch();
@@ -0,0 +1,96 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../src/core/fingerprint.hpp"
+
+// Robustness of Fingerprint against re-encoding style damage. The takes are
+// synthesized analytically, so the same music can be rendered at any rate.
+
+const int seconds=30;
+
+// Chord changes every 0.5 s: decaying notes with harmonics, plus faint noise
+std::vector<float>render(uint32_t seed,uint32_t rate,double delay=0.0){
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int>note(40,84);
+  std::vector<std::vector<double>>chords(seconds*2+2);
+  for(auto& chord:chords)for(int k=0;k<3;++k)chord.push_back(440.0*std::pow(2.0,(note(rng)-69)/12.0));
+  std::vector<float>out(static_cast<size_t>(seconds)*rate*2);
+  std::normal_distribution<float>noise(0.0f,0.001f);
+  for(size_t f=0;f<out.size()/2;++f){
+    const double t=static_cast<double>(f)/rate-delay;
+    float v=0.0f;
+    if(t>=0.0){
+      const size_t c=static_cast<size_t>(t*2.0);
+      const double local=t-c*0.5;
+      for(double hz:chords[c])for(int h=1;h<=6;++h)v+=static_cast<float>(0.1/h*std::exp(-4.0*local)*std::sin(2.0*M_PI*hz*h*t));
+    }
+    v+=noise(rng);
+    out[f*2]=v;
+    out[f*2+1]=v*0.8f;
+  }
+  return out;
+}
+
+void quantize(std::vector<float>& x,int bits){
+  const float scale=static_cast<float>(1<<(bits-1));
+  for(float& v:x)v=std::round(v*scale)/scale;
+}
+
+int failures=0;
+void check(bool ok,const char *what,double value){
+  printf("%-44s %8.4f  %s\n",what,value,ok?"ok":"FAIL");
+  if(!ok)++failures;
+}
+
+int main(){
+  const std::vector<float>original=render(1,44100);
+  const Fingerprint a=Fingerprint::compute(original.data(),original.size()/2,2,44100);
+
+  // Incremental build must be bit-identical to the one-shot one
+  Fingerprint::Builder builder(2,44100);
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<size_t>block(1,20000);
+  for(size_t f=0;f<original.size()/2;){
+    const size_t n=std::min(block(rng),original.size()/2-f);
+    builder.push(original.data()+f*2,n);
+    f+=n;
+  }
+  const Fingerprint streamed=builder.finish();
+  check(streamed.bits==a.bits,"builder matches compute()",static_cast<double>(streamed.bits.size()));
+
+  // Same take at 48 kHz, 8-bit, 25 ms late: best offset is searched like a query would
+  std::vector<float>copy=render(1,48000,0.025);
+  quantize(copy,8);
+  const Fingerprint b=Fingerprint::compute(copy.data(),copy.size()/2,2,48000);
+  float best=1.0f;
+  for(int64_t offset=-16;offset<=16;++offset)best=std::min(best,Fingerprint::bitErrorRate(a,b,offset));
+  check(best<0.15f,"48 kHz / 8-bit / 25 ms copy, BER",best);
+
+  std::vector<float>quiet=original;
+  for(float& v:quiet)v*=0.25f;
+  const Fingerprint c=Fingerprint::compute(quiet.data(),quiet.size()/2,2,44100);
+  const float gainBer=Fingerprint::bitErrorRate(a,c);
+  check(gainBer<0.02f,"-12 dB gain, BER",gainBer);
+
+  const std::vector<float>other=render(2,44100);
+  const Fingerprint d=Fingerprint::compute(other.data(),other.size()/2,2,44100);
+  const float unrelated=Fingerprint::bitErrorRate(a,d);
+  check(unrelated>0.3f,"unrelated take, BER",unrelated);
+
+  // The library finds the copy and its offset among unrelated takes
+  FingerprintLibrary library;
+  library.add("original",a);
+  library.add("other",d);
+  for(uint32_t seed=3;seed<8;++seed){
+    const std::vector<float>x=render(seed,22050);
+    library.add("take"+std::to_string(seed),Fingerprint::compute(x.data(),x.size()/2,2,22050));
+  }
+  const std::vector<FingerprintLibrary::Match>matches=library.query(b);
+  const bool found=!matches.empty() && library.at(matches[0].file).path=="original";
+  check(found,"library query finds the copy",found?matches[0].ber:1.0);
+
+  printf(failures?"%d check(s) failed\n":"all checks passed\n",failures);
+  return failures?1:0;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "../src/core/graph.hpp"
+#include "../src/core/oscillator.hpp"
+
+// Synthetic 64-track session: source -> 4 filter stages -> 8 buses -> master
+
+const int sampleRate=48000;
+const int channels=2;
+const size_t blockFrames=256;
+const int tracks=64;
+const int buses=8;
+const int blocks=500;
+
+struct Biquad{
+  float b0=0.2f,b1=0.4f,b2=0.2f,a1=-0.5f,a2=0.3f;
+  float z1[channels]{},z2[channels]{};
+  void process(float *buf,size_t frames){
+    for(size_t f=0;f<frames;++f)for(int c=0;c<channels;++c){
+      float x=buf[f*channels+c];
+      float y=b0*x+z1[c];
+      z1[c]=b1*x-a1*y+z2[c];
+      z2[c]=b2*x-a2*y;
+      buf[f*channels+c]=y;
+    }
+  }
+};
+
+struct Session{
+  ProcessingGraph graph;
+  std::vector<Oscillator>oscillators;
+  std::vector<Biquad>filters;
+
+  Session(){
+    oscillators.reserve(tracks);
+    filters.resize(tracks*4);
+    int master=graph.addNode(ProcessingGraph::NodeType::Master,[](float* buf,size_t frames,int ch){
+      for(size_t i=0;i<frames*ch;++i)buf[i]*=0.1f;
+    });
+    std::vector<int>busIds;
+    for(int b=0;b<buses;++b){
+      busIds.push_back(graph.addNode(ProcessingGraph::NodeType::Bus,[](float* buf,size_t frames,int ch){
+        for(size_t i=0;i<frames*ch;++i)buf[i]=std::tanh(buf[i]);
+      }));
+      graph.connect(busIds.back(),master);
+    }
+    for(int t=0;t<tracks;++t){
+      oscillators.emplace_back(static_cast<Oscillator::Wave>(t%3),110.0f+t*7.0f,0.5f,static_cast<float>(sampleRate));
+      Oscillator *osc=&oscillators.back();
+      int prev=graph.addNode(ProcessingGraph::NodeType::Source,[osc](float* buf,size_t frames,int ch){osc->process(buf,frames,ch);});
+      for(int s=0;s<4;++s){
+        Biquad *bq=&filters[t*4+s];
+        int fx=graph.addNode(ProcessingGraph::NodeType::Effect,[bq](float* buf,size_t frames,int){for(int k=0;k<8;++k)bq->process(buf,frames);});
+        graph.connect(prev,fx);
+        prev=fx;
+      }
+      graph.connect(prev,busIds[t%buses]);
+    }
+  }
+};
+
+int main(int argc,char *argv[]){
+  unsigned maxThreads=argc>1?static_cast<unsigned>(std::atoi(argv[1])):std::thread::hardware_concurrency();
+  if(maxThreads==0)maxThreads=1;
+
+  std::vector<float>reference;
+  double baseline=0.0;
+  printf("%d tracks, %zu-frame blocks, %d blocks\n",tracks,blockFrames,blocks);
+  std::vector<unsigned>counts;
+  for(unsigned n=1;n<maxThreads;n*=2)counts.push_back(n);
+  counts.push_back(maxThreads);
+
+  for(unsigned threads:counts){
+    Session session;
+    session.graph.compile(blockFrames,channels);
+    session.graph.setThreadCount(threads-1);
+
+    std::vector<float>out(blockFrames*channels),all;
+    all.reserve(blockFrames*channels*blocks);
+    auto start=std::chrono::steady_clock::now();
+    for(int b=0;b<blocks;++b){
+      session.graph.process(out.data(),blockFrames);
+      all.insert(all.end(),out.begin(),out.end());
+    }
+    double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+
+    if(reference.empty()){reference=all;baseline=ms;}
+    bool identical=all==reference;
+    double budget=1000.0*blockFrames/sampleRate;
+    printf("threads %2u: %8.2f ms total, %6.3f ms/block (%5.1f%% of budget), speedup %.2fx, output %s\n",
+      threads,ms,ms/blocks,100.0*(ms/blocks)/budget,baseline/ms,identical?"identical":"DIFFERS");
+  }
+  return 0;
+}
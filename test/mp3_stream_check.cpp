@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sndfile.hh>
+#include "../src/core/mp3_index.hpp"
+
+// Mp3Stream::seek()+read() against a full sf_readf_float decode of the same
+// file, at offsets around frame edges, far jumps back and forth, and the end.
+// With no argument, a CBR and a VBR (Xing/LAME tag) file are encoded through
+// libsndfile into /tmp, plus a copy of the CBR one with its ID3 and
+// Xing/Info frame stripped.
+
+const int seconds=20;
+const size_t span=44100;        // frames compared after each seek
+const float limit=1e-4f;        // past the preroll the decoder has converged
+
+std::vector<float>decodeAll(const std::string& path,SF_INFO& info){
+  info={};
+  std::vector<float>out;
+  SNDFILE *file=sf_open(path.c_str(),SFM_READ,&info);
+  if(!file)return out;
+  out.resize(static_cast<size_t>(info.frames*info.channels));
+  out.resize(static_cast<size_t>(std::max<sf_count_t>(0,sf_readf_float(file,out.data(),info.frames))*info.channels));
+  sf_close(file);
+  return out;
+}
+
+bool compare(const std::string& path){
+  SF_INFO info;
+  const std::vector<float>reference=decodeAll(path,info);
+  if(reference.empty()){
+    printf("%s: libsndfile could not decode it\n",path.c_str());
+    return false;
+  }
+  const size_t channels=static_cast<size_t>(info.channels);
+  const uint64_t total=reference.size()/channels;
+
+  Mp3Stream stream;
+  if(!stream.open(path)){
+    printf("%s: Mp3Stream could not open it\n",path.c_str());
+    return false;
+  }
+  const uint64_t spf=static_cast<uint64_t>(stream.getIndex().getSamplesPerFrame());
+  const std::vector<uint64_t>offsets={0,1,spf-1,spf,spf+1,12345,total/2,total/3,total/2+spf*3,total/2+7,total-span/2,total-1,spf*7/2,total};
+
+  bool ok=stream.frames()==total && static_cast<size_t>(stream.getChannels())==channels;
+  if(!ok)printf("%s: %llu frames, libsndfile %llu\n",path.c_str(),static_cast<unsigned long long>(stream.frames()),static_cast<unsigned long long>(total));
+  float worst=0.0f;
+  std::vector<float>got(span*channels);
+  for(uint64_t at:offsets){
+    if(!stream.seek(at)){
+      printf("%s: seek to %llu failed\n",path.c_str(),static_cast<unsigned long long>(at));
+      ok=false;
+      continue;
+    }
+    const size_t want=static_cast<size_t>(std::min<uint64_t>(span,total-std::min(at,total)));
+    size_t n=0,r;
+    while(n<want && (r=stream.read(got.data()+n*channels,want-n))>0)n+=r;
+    if(n!=want || stream.tell()!=at+want){
+      printf("%s: read %zu of %zu frames at %llu\n",path.c_str(),n,want,static_cast<unsigned long long>(at));
+      ok=false;
+    }
+    for(size_t i=0;i<n*channels;++i)worst=std::max(worst,std::fabs(got[i]-reference[at*channels+i]));
+  }
+  printf("%-36s %llu frames, %zu seeks, max diff %g\n",path.c_str(),static_cast<unsigned long long>(total),offsets.size(),worst);
+  return ok && worst<=limit;
+}
+
+std::string encode(const std::string& name,int mode){
+  const std::string path="/tmp/sizzlefx-mp3-"+name+".mp3";
+  SF_INFO info{};
+  info.samplerate=44100;
+  info.channels=2;
+  info.format=SF_FORMAT_MPEG|SF_FORMAT_MPEG_LAYER_III;
+  SNDFILE *file=sf_open(path.c_str(),SFM_WRITE,&info);
+  if(!file){
+    printf("%s: libsndfile could not encode it: %s\n",path.c_str(),sf_strerror(NULL));
+    return "";
+  }
+  double level=0.5;
+  sf_command(file,SFC_SET_BITRATE_MODE,&mode,sizeof(mode));
+  sf_command(file,SFC_SET_COMPRESSION_LEVEL,&level,sizeof(level));
+  std::vector<float>block(44100*2);
+  uint32_t noise=1;
+  for(int s=0;s<seconds;++s){
+    for(size_t f=0;f<block.size()/2;++f){
+      const double t=s+f/44100.0;
+      noise=noise*1664525u+1013904223u;
+      // a sweep and bursts of noise so VBR frame sizes vary
+      const float hiss=(s%3==1?0.2f:0.01f)*(static_cast<float>(noise>>8)/(1<<24)-0.5f);
+      block[f*2]=static_cast<float>(0.4*std::sin(2.0*M_PI*(200.0+100.0*t)*t))+hiss;
+      block[f*2+1]=static_cast<float>(0.3*std::sin(2.0*M_PI*660.0*t))-hiss;
+    }
+    sf_writef_float(file,block.data(),44100);
+  }
+  sf_close(file);
+  return path;
+}
+
+// Copy without the ID3v2 tag and the Xing/Info frame, so the index has to count frames
+std::string stripTags(const std::string& from){
+  std::ifstream in(from,std::ios::binary);
+  std::vector<uint8_t>data((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+  size_t at=0;
+  while(data.size()>=at+10 && std::memcmp(data.data()+at,"ID3",3)==0){
+    at+=10+(static_cast<size_t>(data[at+6]&0x7F)<<21|(data[at+7]&0x7F)<<14|(data[at+8]&0x7F)<<7|(data[at+9]&0x7F))+(data[at+5]&0x10?10:0);
+  }
+  Mp3Index::Header h;
+  if(data.size()<at+4 || !Mp3Index::parseHeader(data.data()+at,h))return "";
+  const size_t scan=std::min(data.size(),at+64);
+  for(size_t i=at+4;i+4<=scan;++i){
+    if(std::memcmp(data.data()+i,"Xing",4)==0 || std::memcmp(data.data()+i,"Info",4)==0){
+      at+=h.frameBytes;
+      break;
+    }
+  }
+  const std::string path="/tmp/sizzlefx-mp3-untagged.mp3";
+  std::ofstream out(path,std::ios::binary | std::ios::trunc);
+  return out.write(reinterpret_cast<const char*>(data.data()+at),static_cast<std::streamsize>(data.size()-at))?path:"";
+}
+
+int main(int argc,char *argv[]){
+  std::vector<std::string>paths;
+  std::vector<std::string>written;
+  for(int i=1;i<argc;++i)paths.push_back(argv[i]);
+  if(paths.empty()){
+    written.push_back(encode("cbr",SF_BITRATE_MODE_CONSTANT));
+    written.push_back(encode("vbr",SF_BITRATE_MODE_VARIABLE));
+    written.push_back(written[0].empty()?"":stripTags(written[0]));
+    paths=written;
+  }
+  int failures=0;
+  for(const std::string& path:paths)if(path.empty() || !compare(path))++failures;
+  for(const std::string& path:written){
+    if(path.empty())continue;
+    std::remove(path.c_str());
+    std::remove(Mp3Index::cachePath(path).c_str());
+  }
+  printf(failures?"%d file(s) differ\n":"all outputs identical\n",failures);
+  return failures?1:0;
+}
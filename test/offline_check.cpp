@@ -0,0 +1,186 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/core/offline.hpp"
+#include "../src/core/silence.hpp"
+#include "../src/core/onset.hpp"
+
+// Offline processing split across threads must give exactly the samples of a
+// serial pass: every operation runs with one thread and with several, and
+// the stateful filters are also checked against a plain loop. Auto-trim and
+// split on silence are checked on bursts placed off the index block grid,
+// onsets and slices on a click train.
+
+const int channels=2;
+const size_t frames=1000003;   // several BLOCK_FRAMES per thread, ragged end
+const size_t threads=7;
+
+int failures=0;
+void fail(const std::string& what){
+  if(failures++<10)printf("%s\n",what.c_str());
+}
+
+bool same(const std::vector<float>& a,const std::vector<float>& b){
+  return a.size()==b.size() && std::memcmp(a.data(),b.data(),a.size()*sizeof(float))==0;
+}
+
+DecodedAudio noise(){
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float>sample(-0.8f,0.8f);
+  DecodedAudio audio;
+  audio.samples.resize(frames*channels);
+  for(size_t i=0;i<audio.samples.size();++i)audio.samples[i]=sample(rng)+(i%channels?0.1f:-0.05f);
+  audio.totalFrames=frames;
+  return audio;
+}
+
+// op on one thread and on several must agree bit for bit
+template<typename Op>
+std::vector<float>both(const char *name,Op op){
+  const DecodedAudio input=noise();
+  DecodedAudio serial=input,split=input;
+  OfflineProcessor::maxThreads=1;
+  op(serial);
+  OfflineProcessor::maxThreads=threads;
+  op(split);
+  OfflineProcessor::maxThreads=0;
+  if(!same(serial.samples,split.samples))fail(std::string(name)+": threads change the result");
+  return split.samples;
+}
+
+// Bursts over a -80 dB floor at 48 kHz: two close ones that merge, one apart, and a blip too short to keep
+void checkSilence(){
+  const uint32_t rate=48000;
+  const uint64_t bursts[][2]={{10000,30000},{40000,60000},{100000,110000},{150000,150200}};
+  DecodedAudio audio;
+  audio.totalFrames=200000;
+  audio.samples.resize(audio.totalFrames*channels);
+  for(size_t i=0;i<audio.samples.size();++i)audio.samples[i]=(i%3?1e-4f:-1e-4f);
+  for(const auto& b:bursts){
+    for(uint64_t f=b[0];f<b[1];++f)audio.samples[f*channels+f%channels]=(f%2?0.5f:-0.5f);
+  }
+
+  DecodedAudio trimmed=audio;
+  const SilenceIndex::Region kept=SilenceIndex::autoTrim(trimmed,channels,rate,-60.0f,0.0);
+  const std::vector<float>middle(audio.samples.begin()+10000*channels,audio.samples.begin()+150200*channels);
+  if(kept.start!=10000 || kept.end!=150200 || trimmed.totalFrames!=140200 || !same(trimmed.samples,middle))fail("autoTrim");
+
+  const SilenceSettings settings;  // 0.25 s gap, 0.02 s sound, 0.01 s padding
+  const uint64_t pad=480,expect[][2]={{10000-pad,60000+pad},{100000-pad,110000+pad}};
+  const std::vector<DecodedAudio>parts=SilenceIndex::splitOnSilence(audio,channels,rate,settings);
+  if(parts.size()!=2){fail("splitOnSilence: "+std::to_string(parts.size())+" parts");return;}
+  for(size_t i=0;i<parts.size();++i){
+    const std::vector<float>part(audio.samples.begin()+expect[i][0]*channels,audio.samples.begin()+expect[i][1]*channels);
+    if(parts[i].totalFrames!=expect[i][1]-expect[i][0] || !same(parts[i].samples,part))fail("splitOnSilence: part "+std::to_string(i));
+  }
+  printf("silence: trimmed to [%llu,%llu), %zu parts\n",static_cast<unsigned long long>(kept.start),static_cast<unsigned long long>(kept.end),parts.size());
+}
+
+// Decaying clicks every 0.25 s over quiet noise; each must be found once, within half an FFT frame
+void checkOnsets(){
+  const uint32_t rate=44100;
+  const uint64_t total=rate*3,first=rate/10,every=rate/4,tolerance=OnsetConfig{}.fftSize/2;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float>noise(-1e-3f,1e-3f);
+  std::vector<float>samples(total*channels);
+  for(float& v:samples)v=noise(rng);
+  std::vector<uint64_t>clicks;
+  for(uint64_t at=first;at+every<total;at+=every){
+    clicks.push_back(at);
+    for(uint64_t k=0;k<400;++k){
+      const float v=static_cast<float>(0.8*std::exp(-static_cast<double>(k)/60.0)*std::sin(0.7*k));
+      for(int c=0;c<channels;++c)samples[(at+k)*channels+c]+=v;
+    }
+  }
+
+  const std::vector<uint64_t>onsets=OnsetDetector::detect(samples,channels,rate);
+  bool found=onsets.size()==clicks.size();
+  for(size_t i=0;found && i<clicks.size();++i)found=(onsets[i]>clicks[i]?onsets[i]-clicks[i]:clicks[i]-onsets[i])<=tolerance;
+  if(!found)fail("onsets: "+std::to_string(onsets.size())+" found for "+std::to_string(clicks.size())+" clicks");
+
+  // streaming in odd blocks finds the same frames
+  OnsetDetector detector(rate,channels);
+  for(uint64_t f=0,n=1;f<total;f+=n,n=n*5%3001+1){
+    n=std::min(n,total-f);
+    detector.process(samples.data()+f*channels,n);
+  }
+  detector.finish();
+  std::vector<uint64_t>streamed=detector.takeOnsets();
+  streamed.erase(std::remove_if(streamed.begin(),streamed.end(),[total](uint64_t o){return o>=total;}),streamed.end());
+  if(streamed!=onsets)fail("onsets: streaming in blocks changes the result");
+
+  // slices tile the file and start on the onsets
+  const std::vector<OnsetDetector::Slice>parts=OnsetDetector::slices(onsets,total);
+  bool tiled=parts.size()==onsets.size()+1 && parts.front().start==0 && parts.back().end==total;
+  for(size_t i=1;tiled && i<parts.size();++i)tiled=parts[i].start==parts[i-1].end && parts[i].start==onsets[i-1];
+  if(!tiled)fail("slices");
+  printf("onsets: %zu clicks, %zu onsets, %zu slices\n",clicks.size(),onsets.size(),parts.size());
+}
+
+int main(){
+  const DecodedAudio input=noise();
+
+  std::vector<float>expect=input.samples;
+  for(size_t i=1000*channels;i<500000*channels;++i)expect[i]*=0.5f;
+  if(!same(both("gain",[](DecodedAudio& a){OfflineProcessor::gain(a,channels,0.5f,1000,500000);}),expect))fail("gain");
+
+  expect=input.samples;
+  for(size_t f=0;f<frames/2;++f)for(int c=0;c<channels;++c)std::swap(expect[f*channels+c],expect[(frames-1-f)*channels+c]);
+  if(!same(both("reverse",[](DecodedAudio& a){OfflineProcessor::reverse(a,channels);}),expect))fail("reverse");
+
+  both("fades",[](DecodedAudio& a){
+    OfflineProcessor::fadeIn(a,channels,300000,OfflineProcessor::FadeCurve::EqualPower);
+    OfflineProcessor::fadeOut(a,channels,400000);
+  });
+  both("normalize",[](DecodedAudio& a){OfflineProcessor::normalize(a,channels,0.9f);});
+  both("removeDC",[](DecodedAudio& a){OfflineProcessor::removeDC(a,channels);});
+
+  // reductions
+  float peak=0.0f;
+  for(float v:input.samples)peak=std::max(peak,std::fabs(v));
+  OfflineProcessor::maxThreads=1;
+  const std::vector<double>meanSerial=OfflineProcessor::channelMeans(input,channels);
+  const float peakSerial=OfflineProcessor::peak(input);
+  OfflineProcessor::maxThreads=threads;
+  const std::vector<double>meanSplit=OfflineProcessor::channelMeans(input,channels);
+  const float peakSplit=OfflineProcessor::peak(input);
+  OfflineProcessor::maxThreads=0;
+  if(peakSerial!=peak || peakSplit!=peak)fail("peak");
+  if(meanSerial!=meanSplit || std::fabs(meanSplit[0]+0.05)>1e-3 || std::fabs(meanSplit[1]-0.1)>1e-3)fail("channelMeans");
+
+  // FIR against a plain forward loop
+  std::vector<float>taps(31);
+  for(size_t k=0;k<taps.size();++k)taps[k]=static_cast<float>(std::sin(0.3*(k+1))/(k+1));
+  expect.assign(input.samples.size(),0.0f);
+  for(size_t f=0;f<frames;++f)for(int c=0;c<channels;++c){
+    float acc=0.0f;
+    for(size_t k=0;k<taps.size() && k<=f;++k)acc+=taps[k]*input.samples[(f-k)*channels+c];
+    expect[f*channels+c]=acc;
+  }
+  if(!same(both("applyFIR",[&](DecodedAudio& a){OfflineProcessor::applyFIR(a,channels,taps);}),expect))fail("applyFIR differs from a serial pass");
+
+  // biquad against a plain loop
+  const OfflineProcessor::Biquad q{0.2,0.4,0.2,-0.5,0.3};
+  expect=input.samples;
+  for(int c=0;c<channels;++c){
+    double x1=0.0,x2=0.0,y1=0.0,y2=0.0;
+    for(size_t f=0;f<frames;++f){
+      const double x=expect[f*channels+c];
+      const double y=q.b0*x+q.b1*x1+q.b2*x2-q.a1*y1-q.a2*y2;
+      x2=x1;x1=x;y2=y1;y1=y;
+      expect[f*channels+c]=static_cast<float>(y);
+    }
+  }
+  if(!same(both("applyBiquad",[&](DecodedAudio& a){OfflineProcessor::applyBiquad(a,channels,q);}),expect))fail("applyBiquad differs from a serial pass");
+
+  printf("offline: %zu frames, 1 vs %zu threads\n",frames,threads);
+
+  checkSilence();
+  checkOnsets();
+  printf(failures?"%d check(s) failed\n":"all checks passed\n",failures);
+  return failures?1:0;
+}
@@ -0,0 +1,144 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../src/core/resampler.hpp"
+#include "../src/core/convert.hpp"
+#include "../src/core/project.hpp"
+
+// Resampler accuracy on a 1 kHz sine against the exact sine at the new rate,
+// the same through SourcePool, alias rejection of tones above the output
+// Nyquist, and the batch converter's 5.1 -> stereo/mono downmix through real
+// files, which a 5.1 clip in a stereo/mono project must match.
+
+const double tone=1000.0;
+const double amplitude=0.5;
+const double limit=5e-5;
+const double aliasLimit=-70.0;  // dB below the input tone
+const int seconds=2;
+
+int failures=0;
+void fail(const std::string& what){
+  if(failures++<10)printf("%s\n",what.c_str());
+}
+
+std::vector<float>sine(uint32_t rate,int channels,double frequency=tone){
+  std::vector<float>x(static_cast<size_t>(rate)*seconds*channels);
+  for(size_t f=0;f<x.size()/channels;++f){
+    for(int c=0;c<channels;++c)x[f*channels+c]=static_cast<float>(amplitude*std::sin(2.0*M_PI*frequency*f/rate+c));
+  }
+  return x;
+}
+
+// Worst error away from the edges, where the filter still sees the silence around the input
+double worstError(const std::vector<float>& y,uint32_t rate,int channels){
+  const size_t frames=y.size()/channels,edge=rate/100;
+  double worst=0.0;
+  for(size_t f=edge;f+edge<frames;++f){
+    for(int c=0;c<channels;++c)worst=std::max(worst,std::fabs(y[f*channels+c]-amplitude*std::sin(2.0*M_PI*tone*f/rate+c)));
+  }
+  return worst;
+}
+
+void checkRates(uint32_t from,uint32_t to){
+  const int channels=2;
+  const std::vector<float>x=sine(from,channels);
+  const uint64_t expected=(static_cast<uint64_t>(x.size()/channels)*to+from/2)/from;
+
+  // streamed in odd block sizes
+  Resampler resampler;
+  resampler.configure(channels,from,to);
+  std::vector<float>y;
+  for(size_t f=0,n=1;f<x.size()/channels;f+=n,n=n*3%4999+1){
+    n=std::min(n,x.size()/channels-f);
+    resampler.process(x.data()+f*channels,n,y);
+  }
+  resampler.flush(y);
+  const double streamed=worstError(y,to,channels);
+  if(y.size()/channels!=expected)fail(std::to_string(from)+" -> "+std::to_string(to)+": length");
+  if(streamed>limit)fail(std::to_string(from)+" -> "+std::to_string(to)+": error above limit");
+
+  auto source=SourcePool::make(x,channels,from,to);
+  const double pooled=source?worstError(source->samples,to,channels):INFINITY;
+  if(!source || source->frames!=expected || pooled>limit)fail(std::to_string(from)+" -> "+std::to_string(to)+": SourcePool");
+  printf("%6u -> %6u: worst error %.2e streamed, %.2e through SourcePool\n",from,to,streamed,pooled);
+}
+
+// Frame 0 of every channel of a converted 5.1 file with one speaker per channel sounding
+std::vector<float>downmix(int outChannels){
+  const std::string in="/tmp/sizzlefx-downmix-51.wav";
+  WavWriteOptions format;
+  format.bits=32;
+  format.floatingPoint=true;
+  WavWriter writer;
+  std::vector<float>frame={0.1f,0.2f,0.3f,0.4f,0.05f,0.06f}; // FL FR FC LFE BL BR
+  if(!writer.open(in,6,48000,format) || !writer.write(frame) || !writer.close())return {};
+
+  ConvertOptions options;
+  options.channels=outChannels;
+  options.format=format;
+  options.suffix="-"+std::to_string(outChannels);
+  options.overwrite=true;
+  BatchConverter converter;
+  const BatchConverter::Result result=converter.run({in},options).front();
+  std::vector<float>out;
+  WavReader reader;
+  if(result.ok && reader.open(result.output))reader.readAll(out);
+  std::remove(in.c_str());
+  std::remove(result.output.c_str());
+  return out;
+}
+
+// Frame 0 of a 5.1 clip rendered into a project with outChannels
+std::vector<float>clipMix(int outChannels){
+  std::vector<Clip>clips(1);
+  clips[0].source=SourcePool::make({0.1f,0.2f,0.3f,0.4f,0.05f,0.06f},6,48000,48000);
+  clips[0].length=1;
+  const Arrangement arrangement(std::vector<Track>(1),clips,48000,outChannels);
+  std::vector<float>out(outChannels,0.0f);
+  arrangement.render(0,out.data(),1);
+  return out;
+}
+
+// A tone above the output Nyquist must not come back as an alias
+void checkAlias(uint32_t from,uint32_t to,double frequency){
+  const std::vector<float>x=sine(from,1,frequency);
+  Resampler resampler;
+  resampler.configure(1,from,to);
+  std::vector<float>y;
+  resampler.process(x.data(),x.size(),y);
+  resampler.flush(y);
+  const size_t edge=to/100;
+  double sq=0.0;
+  for(size_t f=edge;f+edge<y.size();++f)sq+=static_cast<double>(y[f])*y[f];
+  const double rms=std::sqrt(sq/std::max<size_t>(1,y.size()-2*edge));
+  const double db=20.0*std::log10(std::max(rms,1e-12)/(amplitude/std::sqrt(2.0)));
+  if(db>aliasLimit)fail(std::to_string(from)+" -> "+std::to_string(to)+": "+std::to_string(static_cast<int>(frequency))+" Hz aliases");
+  printf("%6u -> %6u: %5.0f Hz tone comes back at %6.1f dB\n",from,to,frequency,db);
+}
+
+int main(){
+  checkRates(44100,48000);
+  checkRates(48000,44100);
+  checkRates(96000,44100);
+  checkRates(44100,96000);
+  checkRates(48000,8000);
+  checkRates(192000,22050);
+
+  checkAlias(48000,8000,5000.0);
+  checkAlias(48000,8000,6000.0);
+  checkAlias(96000,44100,25000.0);
+  checkAlias(48000,44100,23000.0);
+
+  const float g=0.70710678f;
+  const float left=0.1f+g*0.3f+g*0.05f,right=0.2f+g*0.3f+g*0.06f;
+  const std::vector<float>stereo=downmix(2),mono=downmix(1);
+  if(stereo.size()!=2 || std::fabs(stereo[0]-left)>1e-6f || std::fabs(stereo[1]-right)>1e-6f)fail("5.1 -> stereo downmix");
+  if(mono.size()!=1 || std::fabs(mono[0]-0.5f*(left+right))>1e-6f)fail("5.1 -> mono downmix");
+  if(clipMix(2)!=stereo || clipMix(1)!=mono)fail("5.1 clip mixes differently from the converter");
+  printf("5.1 -> stereo %s, -> mono %s\n",stereo.size()==2?"L+0.707C+0.707Ls / R+0.707C+0.707Rs":"failed",mono.size()==1?"(L+R)/2":"failed");
+
+  printf(failures?"%d check(s) failed\n":"all checks passed\n",failures);
+  return failures?1:0;
+}
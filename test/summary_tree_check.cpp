@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../src/core/summary_tree.hpp"
+#include "../src/core/peaks.hpp"
+
+// Random overwrite / insert / delete edits against brute-force scans. Every
+// edit must rescan only the frames it wrote plus a few blocks, never the tail.
+
+const int channels=2;
+const int edits=2000;
+
+int failures=0;
+void fail(int edit,const char *what){
+  if(failures++<10)printf("edit %d: %s\n",edit,what);
+}
+
+bool nearlyEqual(double a,double b){return std::fabs(a-b)<=1e-9*std::max(1.0,std::fabs(b));}
+
+SummaryTree::Summary brute(const std::vector<float>& x,uint64_t f0,uint64_t f1){
+  SummaryTree::Summary s;
+  for(uint64_t i=f0*channels;i<f1*channels;++i){
+    const float v=x[i];
+    s.min=std::min(s.min,v);
+    s.max=std::max(s.max,v);
+    s.sumSq+=static_cast<double>(v)*v;
+    ++s.count;
+    s.clips+=std::fabs(v)>=SummaryTree::CLIP_LEVEL;
+  }
+  return s;
+}
+
+bool same(const SummaryTree::Summary& a,const SummaryTree::Summary& b){
+  return a.count==b.count && a.clips==b.clips && (a.count==0 || (a.min==b.min && a.max==b.max && nearlyEqual(a.sumSq,b.sumSq)));
+}
+
+bool sameBucket(const PeakPyramid::Bucket& a,const std::vector<float>& x,int c,uint64_t f0,uint64_t f1){
+  if(a.count!=f1-f0)return false;
+  if(a.count==0)return true;
+  float mn=x[f0*channels+c],mx=mn;
+  double sq=0.0;
+  for(uint64_t f=f0;f<f1;++f){
+    const float v=x[f*channels+c];
+    mn=std::min(mn,v);
+    mx=std::max(mx,v);
+    sq+=static_cast<double>(v)*v;
+  }
+  return a.min==mn && a.max==mx && nearlyEqual(a.sumSq,sq);
+}
+
+int main(){
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<float>sample(-1.05f,1.05f);
+  auto randomFrames=[&](uint64_t n){
+    std::vector<float>v(n*channels);
+    for(float& s:v)s=sample(rng);
+    return v;
+  };
+
+  std::vector<float>x=randomFrames(2000000);
+  SummaryTree tree;
+  PeakPyramid peaks;
+  tree.build(x,channels);
+  peaks.build(x,channels);
+
+  // streaming build gives the same totals
+  SummaryTree streamed;
+  streamed.begin(channels);
+  for(uint64_t f=0;f<x.size()/channels;f+=77777)streamed.append(x.data()+f*channels,std::min<uint64_t>(77777,x.size()/channels-f));
+  streamed.finish();
+  if(!same(streamed.total(),tree.total()))fail(-1,"streamed build total");
+
+  uint64_t worst=0;
+  for(int e=0;e<edits;++e){
+    const uint64_t frames=x.size()/channels;
+    const int kind=static_cast<int>(rng()%3);
+    const uint64_t start=rng()%(frames+1);
+    const uint64_t span=rng()%(kind==0?5000:20000)+1;
+    uint64_t oldEnd=std::min(frames,start+span),newEnd=oldEnd;
+    if(kind==0){         // overwrite in place
+      const std::vector<float>v=randomFrames(oldEnd-start);
+      std::copy(v.begin(),v.end(),x.begin()+start*channels);
+    }else if(kind==1){   // insert
+      const std::vector<float>v=randomFrames(span);
+      x.insert(x.begin()+start*channels,v.begin(),v.end());
+      oldEnd=start;
+      newEnd=start+span;
+    }else{               // delete
+      x.erase(x.begin()+start*channels,x.begin()+oldEnd*channels);
+      newEnd=start;
+    }
+
+    const uint64_t before=tree.getFramesScanned();
+    tree.replace(x,start,oldEnd,newEnd);
+    peaks.replace(x,start,oldEnd,newEnd);
+    const uint64_t cost=tree.getFramesScanned()-before;
+    const uint64_t written=newEnd-start;
+    worst=std::max(worst,cost>written?cost-written:0);
+    if(cost>written+3*SummaryTree::BLOCK_FRAMES)fail(e,"edit rescanned more than its blocks");
+
+    const uint64_t now=x.size()/channels;
+    if(tree.getTotalFrames()!=now || peaks.getTotalFrames()!=now)fail(e,"length");
+    if(tree.getBlocks()>2*now/SummaryTree::BLOCK_FRAMES+2)fail(e,"blocks fragmented");
+    if(e%50==0 && !same(tree.total(),brute(x,0,now)))fail(e,"total");
+
+    for(int q=0;q<4;++q){
+      const uint64_t a=rng()%(now+1),b=a+rng()%std::min<uint64_t>(now-a+1,q<2?3000:400000);
+      if(!same(tree.query(x,a,b),brute(x,a,b)))fail(e,"range query");
+      const int c=static_cast<int>(rng()%channels);
+      if(!sameBucket(peaks.query(x,c,a,b),x,c,a,b))fail(e,"peak query");
+    }
+  }
+
+  // zoomed out, view columns merge whole buckets and never read samples
+  uint64_t reads=0;
+  const FrameSource counted([&](uint64_t frame,float *out,size_t count){
+    reads+=count;
+    std::copy(x.begin()+frame*channels,x.begin()+(frame+count)*channels,out);
+    return count;
+  });
+  const uint64_t length=x.size()/channels;
+  for(double perColumn:{1024.0,3000.5,length/200.0}){
+    std::vector<PeakPyramid::Bucket>cols;
+    const int count=static_cast<int>(length/perColumn)+2;
+    peaks.columns(counted,0,0,perColumn,count,cols);
+    PeakPyramid::Bucket all;
+    for(const PeakPyramid::Bucket& b:cols)all.merge(b);
+    if(reads || !sameBucket(all,x,0,0,length))fail(edits,"zoomed-out columns");
+  }
+  {
+    std::vector<PeakPyramid::Bucket>cols;
+    peaks.columns(counted,1,12345,100.0,50,cols);
+    for(int c=0;c<50;++c)if(!sameBucket(cols[c],x,1,12345+c*100,12345+(c+1)*100))fail(edits,"zoomed-in columns");
+  }
+
+  // cached peaks come back identical
+  std::vector<uint8_t>bytes;
+  peaks.serialize(bytes);
+  PeakPyramid loaded;
+  const uint64_t now=x.size()/channels;
+  if(!loaded.deserialize(bytes.data(),bytes.size()) || loaded.getTotalFrames()!=now)fail(edits,"peak cache round trip");
+  else for(int c=0;c<channels;++c)if(!sameBucket(loaded.query(x,c,0,now),x,c,0,now))fail(edits,"peak cache contents");
+
+  printf("%d edits on %llu frames, %zu blocks, worst rescan beyond the written frames %llu frames\n",edits,
+    static_cast<unsigned long long>(now),tree.getBlocks(),static_cast<unsigned long long>(worst));
+  printf(failures?"%d check(s) failed\n":"all checks passed\n",failures);
+  return failures?1:0;
+}
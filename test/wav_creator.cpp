@@ -1,69 +1,31 @@
 #include <iostream>
-#include <cmath>
-#include <fstream>
+#include <vector>
+#include "../src/core/oscillator.hpp"
+#include "../src/core/wav_writer.hpp"
 using namespace std;
 
 const int sampleRate=44100;
 const int bitDepth=16;
 
-class SineOscillator{
-  float frequency,amplitude,angle=0.0f,offset=0.0f;
-  public:
-  SineOscillator(float freq,float amp):frequency(freq),amplitude(amp){
-    offset=2 * M_PI * frequency / sampleRate;
-  }
-  float process(){
-    auto sample=amplitude * sin(angle);
-    angle+=offset;
-    return sample;
-  }
-};
-
-void writeToFile(ofstream &file,int value,int size){
-  file.write(reinterpret_cast<const char*>(&value),size);
-}
-
 int main(){
   int duration=2;
-  ofstream audioFile;
-  audioFile.open("waveform.wav",ios::binary);
-  SineOscillator sineOscillator(440,0.5);
-
-  //Header chunk
-  audioFile << "RIFF";
-  audioFile << "----";
-  audioFile << "WAVE";
-
-  // Format chunk
-  audioFile << "fmt ";
-  writeToFile(audioFile,16,4); // Size
-  writeToFile(audioFile,1,2); // Compression code
-  writeToFile(audioFile,1,2); // Number of channels
-  writeToFile(audioFile,sampleRate,4); // Sample rate
-  writeToFile(audioFile,sampleRate * bitDepth / 8,4); // Byte rate
-  writeToFile(audioFile,bitDepth / 8,2); // Block align
-  writeToFile(audioFile,bitDepth,2); // Bit depth
-
-  //Data chunk
-  audioFile << "data";
-  audioFile << "----";
-
-  int preAudioPosition=audioFile.tellp();
-
-  auto maxAmplitude=pow(2,bitDepth-1)-1;
-  for(int i=0;i<sampleRate * duration;i++){
-    auto sample=sineOscillator.process();
-    int intSample=static_cast<int>(sample*maxAmplitude);
-    writeToFile(audioFile,intSample,2);
+  Oscillator sineOscillator(Oscillator::SINE_WAVE,440,0.5,sampleRate);
+
+  // TPDF-dithered 16-bit PCM, header sizes are patched on close
+  WavWriter audioFile;
+  WavWriter::Options options;
+  options.bits=bitDepth;
+  if(!audioFile.open("waveform.wav",1,sampleRate,options))return 1;
+
+  vector<float>block(Oscillator::BLOCK_SIZE);
+  for(size_t frames=sampleRate * duration;frames>0;){
+    const size_t n=min(frames,block.size());
+    sineOscillator.process(block.data(),n);
+    audioFile.write(block.data(),n);
+    frames-=n;
   }
-  int postAudioPosition=audioFile.tellp();
-
-  audioFile.seekp(preAudioPosition-4);
-  writeToFile(audioFile,postAudioPosition-preAudioPosition,4);
-
-  audioFile.seekp(4,ios::beg);
-  writeToFile(audioFile,postAudioPosition-8,4);
 
-  audioFile.close();
+  if(!audioFile.close())return 1;
+  cout << "Wrote " << audioFile.getPath() << endl;
   return 0;
 }
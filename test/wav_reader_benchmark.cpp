@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sndfile.hh>
+#include "../src/core/wav_reader.hpp"
+#include "../src/core/wav_writer.hpp"
+
+// WavReader::readAll against sf_readf_float on the same file. With no
+// argument, 16-bit, 24-bit and float takes are written to /tmp first.
+
+const int runs=5;
+const int seconds=300;
+
+// Best of runs, so the page cache is warm for both readers
+template<typename Fn>
+double bestMs(Fn fn){
+  double best=1e30;
+  for(int r=0;r<runs;++r){
+    auto start=std::chrono::steady_clock::now();
+    fn();
+    best=std::min(best,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+  }
+  return best;
+}
+
+bool compare(const std::string& path){
+  WavReader wav;
+  if(!wav.open(path)){
+    printf("%s: not a WAV the native reader handles\n",path.c_str());
+    return false;
+  }
+  const WavReader::Info& info=wav.getInfo();
+  std::vector<float>native,reference;
+  bool opened=false;
+  const double singleMs=bestMs([&]{wav.readAll(native,1);});
+  const double nativeMs=bestMs([&]{wav.readAll(native);});
+  const double sndfileMs=bestMs([&]{
+    SF_INFO sf{};
+    SNDFILE *file=sf_open(path.c_str(),SFM_READ,&sf);
+    if(!(opened=file!=nullptr))return;
+    reference.resize(static_cast<size_t>(sf.frames*sf.channels));
+    reference.resize(static_cast<size_t>(std::max<sf_count_t>(0,sf_readf_float(file,reference.data(),sf.frames))*sf.channels));
+    sf_close(file);
+  });
+  if(!opened){
+    printf("%s: libsndfile could not open it\n",path.c_str());
+    return false;
+  }
+
+  float worst=native.size()==reference.size()?0.0f:INFINITY;
+  for(size_t i=0;i<native.size() && i<reference.size();++i)worst=std::max(worst,std::fabs(native[i]-reference[i]));
+  const double mb=static_cast<double>(info.frames*info.blockAlign)/(1<<20);
+  printf("%-36s %2d-bit %s, %7.1f MB: native %8.2f ms (%6.0f MB/s, 1 thread %8.2f ms), libsndfile %8.2f ms (%6.0f MB/s), %.2fx, max diff %g\n",
+    path.c_str(),info.bitsPerSample,info.formatTag==3?"float":"PCM  ",mb,nativeMs,mb*1000.0/nativeMs,singleMs,sndfileMs,mb*1000.0/sndfileMs,sndfileMs/nativeMs,worst);
+  return worst<=1e-6f;
+}
+
+std::string writeTake(int bits,bool floatingPoint){
+  const std::string path="/tmp/sizzlefx-bench-"+std::to_string(bits)+(floatingPoint?"f":"")+".wav";
+  WavWriteOptions options;
+  options.bits=bits;
+  options.floatingPoint=floatingPoint;
+  options.dither=false;
+  WavWriter writer;
+  if(!writer.open(path,2,48000,options))return "";
+  std::vector<float>block(48000*2);
+  for(int s=0;s<seconds;++s){
+    for(size_t f=0;f<block.size()/2;++f){
+      const double t=s+f/48000.0;
+      block[f*2]=static_cast<float>(0.5*std::sin(2.0*M_PI*440.0*t));
+      block[f*2+1]=static_cast<float>(0.25*std::sin(2.0*M_PI*660.0*t));
+    }
+    writer.write(block);
+  }
+  return writer.close()?path:"";
+}
+
+int main(int argc,char *argv[]){
+  std::vector<std::string>paths;
+  std::vector<std::string>written;
+  for(int i=1;i<argc;++i)paths.push_back(argv[i]);
+  if(paths.empty()){
+    for(int bits:{16,24})written.push_back(writeTake(bits,false));
+    written.push_back(writeTake(32,true));
+    paths=written;
+  }
+  int failures=0;
+  for(const std::string& path:paths)if(path.empty() || !compare(path))++failures;
+  for(const std::string& path:written)if(!path.empty())std::remove(path.c_str());
+  printf(failures?"%d file(s) differ\n":"all outputs identical\n",failures);
+  return failures?1:0;
+}